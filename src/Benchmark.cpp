@@ -0,0 +1,929 @@
+#include "Benchmark.h"
+#include "Bvh.h"
+#include "Culling.h"
+#include "LightClusters.h"
+#include "ModelLoader.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjectStore.h"
+#include "RenderQueue.h"
+#include "ThreadPool.h"
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double ElapsedMs(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    const char *BUNDLED_MODELS[] = {"models/Car.obj", "models/Porsche_911_GT2.obj"};
+
+    // Set by failed checks; RunBenchmarks then exits with an error
+    bool checkFailed = false;
+
+    void Check(bool condition, const char *what)
+    {
+        std::cout << "  " << (condition ? "ok: " : "FAILED: ") << what << std::endl;
+        checkFailed |= !condition;
+    }
+
+    // OBJ parse throughput on the bundled models (best of several runs, warm file cache)
+    void BenchObjLoad()
+    {
+        const int runs = 10;
+        for (const char *path : BUNDLED_MODELS)
+        {
+            MappedFile file;
+            if (!file.Open(path))
+            {
+                std::cout << "  " << path << ": not found, skipped" << std::endl;
+                continue;
+            }
+            double megabytes = file.Size() / (1024.0 * 1024.0);
+            file.Close();
+
+            double best = 1e30;
+            MeshData mesh;
+            for (int i = 0; i < runs; ++i)
+            {
+                auto start = Clock::now();
+                ModelLoader::ParseObj(path, mesh);
+                best = std::min(best, ElapsedMs(start));
+            }
+
+            std::cout << "  " << std::left << std::setw(28) << path << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(8) << megabytes << " MB " << std::setw(9) << best << " ms " << std::setw(9)
+                      << megabytes / (best / 1000.0) << " MB/s  (" << mesh.vertices.size() << " verts, "
+                      << mesh.indices.size() / 3 << " tris)" << std::endl;
+        }
+    }
+
+    bool SameMesh(const MeshData &a, const MeshData &b)
+    {
+        return a.vertices.size() == b.vertices.size() && a.indices.size() == b.indices.size() &&
+               std::memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(Vertex)) == 0 &&
+               std::memcmp(a.indices.data(), b.indices.data(), a.indices.size() * sizeof(unsigned int)) == 0;
+    }
+
+    // Parallel OBJ parse scaling from 1 to N threads; every result is checked against the serial one
+    void BenchObjThreads()
+    {
+        const int runs = 10;
+        unsigned int maxThreads = ThreadPool::Shared().Size();
+        for (const char *path : BUNDLED_MODELS)
+        {
+            MeshData serial;
+            LoadOptions options;
+            options.threads = 1;
+            if (!ModelLoader::ParseObj(path, serial, options))
+                continue;
+
+            std::cout << "  " << path << std::endl;
+            double serialMs = 0.0;
+            for (unsigned int threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(threads * 2, maxThreads) : threads + 1)
+            {
+                options.threads = threads;
+                MeshData mesh;
+                double best = 1e30;
+                for (int i = 0; i < runs; ++i)
+                {
+                    auto start = Clock::now();
+                    ModelLoader::ParseObj(path, mesh, options);
+                    best = std::min(best, ElapsedMs(start));
+                }
+                if (threads == 1)
+                    serialMs = best;
+
+                std::cout << "    " << std::setw(3) << threads << " threads " << std::fixed << std::setprecision(2)
+                          << std::setw(9) << best << " ms  x" << serialMs / best << std::endl;
+                Check(SameMesh(serial, mesh), "parallel parse matches the serial one");
+            }
+        }
+    }
+
+    // Full parse vs. mapping and validating the .meshbin entry written after the first load
+    void BenchMeshCache()
+    {
+        const int runs = 10;
+        for (const char *path : BUNDLED_MODELS)
+        {
+            MeshData mesh;
+            double parseMs = 1e30;
+            for (int i = 0; i < runs; ++i)
+            {
+                auto start = Clock::now();
+                if (!ModelLoader::ParseObj(path, mesh))
+                    break;
+                parseMs = std::min(parseMs, ElapsedMs(start));
+            }
+            if (mesh.vertices.empty() || !MeshCache::Store(path, LoadOptions().ProcessingFlags(), mesh))
+                continue;
+
+            double cacheMs = 1e30;
+            bool valid = true;
+            for (int i = 0; i < runs; ++i)
+            {
+                auto start = Clock::now();
+                MappedMesh cached;
+                valid &= MeshCache::Load(path, LoadOptions().ProcessingFlags(), cached);
+                cacheMs = std::min(cacheMs, ElapsedMs(start));
+                valid &= cached.vertexCount == mesh.vertices.size() &&
+                         std::memcmp(cached.vertices, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex)) == 0;
+            }
+
+            std::cout << "  " << std::left << std::setw(28) << path << std::right << std::fixed << std::setprecision(3)
+                      << " parse " << std::setw(9) << parseMs << " ms  cache " << std::setw(7) << cacheMs << " ms  x"
+                      << std::setprecision(1) << parseMs / cacheMs << std::endl;
+            Check(valid, "cache entry loads and matches the parsed mesh");
+        }
+    }
+
+    // Vertex cache efficiency of the raw fan-triangulated order vs. the optimized order
+    void BenchMeshOptimize()
+    {
+        for (const char *path : BUNDLED_MODELS)
+        {
+            MeshData mesh;
+            if (!ModelLoader::ParseObj(path, mesh))
+                continue;
+
+            std::cout << "  " << path << std::endl;
+            std::cout << std::fixed << std::setprecision(3);
+            for (unsigned int cacheSize : {16u, 32u})
+            {
+                VertexCacheStats s = MeshOptimizer::AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(), cacheSize);
+                std::cout << "    raw        cache " << std::setw(2) << cacheSize << "  ACMR " << s.acmr << "  ATVR " << s.atvr << std::endl;
+            }
+
+            MeshData optimized = mesh;
+            auto start = Clock::now();
+            MeshOptimizer::OptimizeMesh(optimized, false);
+            double ms = ElapsedMs(start);
+
+            for (unsigned int cacheSize : {16u, 32u})
+            {
+                VertexCacheStats s = MeshOptimizer::AnalyzeVertexCache(optimized.indices.data(), optimized.indices.size(), optimized.vertices.size(), cacheSize);
+                std::cout << "    optimized  cache " << std::setw(2) << cacheSize << "  ACMR " << s.acmr << "  ATVR " << s.atvr << std::endl;
+            }
+            std::cout << "    optimize time " << std::setprecision(2) << ms << " ms" << std::endl;
+        }
+    }
+
+    // LOD chain generation: triangles and object-space error per level
+    void BenchMeshLod()
+    {
+        for (const char *path : BUNDLED_MODELS)
+        {
+            MeshData mesh;
+            if (!ModelLoader::ParseObj(path, mesh))
+                continue;
+
+            auto start = Clock::now();
+            MeshSimplifier::GenerateLods(mesh, 4, true);
+            double ms = ElapsedMs(start);
+
+            std::cout << "  " << path << " (" << std::fixed << std::setprecision(2) << ms << " ms)" << std::endl;
+            for (size_t i = 0; i < mesh.lods.size(); ++i)
+            {
+                const MeshLod &lod = mesh.lods[i];
+                std::cout << "    LOD " << i << "  " << std::setw(7) << lod.indexCount / 3 << " triangles  error "
+                          << std::setprecision(4) << lod.error << std::endl;
+            }
+        }
+    }
+
+    // Closest distance from 'p' to the triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+    float PointTriangleDistance(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+    {
+        glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return glm::length(p - a);
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3)
+            return glm::length(p - b);
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6)
+            return glm::length(p - c);
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+            return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+        float denom = 1.0f / (va + vb + vc);
+        return glm::length(p - (a + ab * (vb * denom) + ac * (vc * denom)));
+    }
+
+    // The error Simplify reports is an object-space distance: it scales with the mesh and is close to
+    // the largest distance of the original vertices from the simplified surface
+    void BenchLodError()
+    {
+        // Bumpy height field; random heights avoid ties between collapse costs
+        const int gridSize = 64;
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> jitter(-0.01f, 0.01f);
+        std::vector<Vertex> baseVertices;
+        std::vector<unsigned int> indices;
+        for (int y = 0; y <= gridSize; ++y)
+        {
+            for (int x = 0; x <= gridSize; ++x)
+            {
+                float u = (float)x / gridSize, v = (float)y / gridSize;
+                float height = 0.05f * std::sin(u * 6.0f) * std::cos(v * 5.0f) + jitter(rng);
+                Vertex vertex{};
+                vertex.Position = glm::vec3(u, height, v);
+                vertex.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+                baseVertices.push_back(vertex);
+            }
+        }
+        for (int y = 0; y < gridSize; ++y)
+        {
+            for (int x = 0; x < gridSize; ++x)
+            {
+                unsigned int i = (unsigned int)(y * (gridSize + 1) + x);
+                indices.insert(indices.end(), {i, i + gridSize + 1, i + 1, i + 1, i + gridSize + 1, i + gridSize + 2});
+            }
+        }
+
+        float errors[2] = {0.0f, 0.0f};
+        const float scales[2] = {1.0f, 10.0f};
+        for (int run = 0; run < 2; ++run)
+        {
+            std::vector<Vertex> vertices = baseVertices;
+            for (Vertex &vertex : vertices)
+                vertex.Position *= scales[run];
+            std::vector<unsigned int> simplified(indices.size());
+            size_t count = MeshSimplifier::Simplify(simplified.data(), indices.data(), indices.size(), vertices.data(),
+                                                    vertices.size(), indices.size() / 8 / 3 * 3, 1.0f * scales[run], &errors[run]);
+
+            // Largest distance of an original vertex from the simplified surface
+            float deviation = 0.0f;
+            for (const Vertex &vertex : vertices)
+            {
+                float closest = INFINITY;
+                for (size_t i = 0; i < count; i += 3)
+                    closest = std::min(closest, PointTriangleDistance(vertex.Position, vertices[simplified[i]].Position,
+                                                                      vertices[simplified[i + 1]].Position,
+                                                                      vertices[simplified[i + 2]].Position));
+                deviation = std::max(deviation, closest);
+            }
+            std::cout << "  scale " << scales[run] << ": " << indices.size() / 3 << " -> " << count / 3 << " triangles, error "
+                      << errors[run] << ", measured deviation " << deviation << std::endl;
+            Check(deviation <= errors[run] * 2.0f && errors[run] <= deviation * 2.0f,
+                  "reported error within 2x of the measured deviation");
+        }
+        Check(std::abs(errors[1] / errors[0] - 10.0f) < 0.1f, "error scales 10x with the mesh");
+    }
+
+    // Frustum culling of 100k randomly placed objects: bounds transform and SIMD plane test per frame,
+    // checked against a plain scalar loop
+    void BenchFrustumCull()
+    {
+        const size_t objectCount = 100000;
+        const int runs = 20;
+
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> position(-200.0f, 200.0f), unit(0.0f, 1.0f);
+        std::vector<glm::mat4> models(objectCount);
+        for (glm::mat4 &model : models)
+        {
+            model = glm::translate(glm::mat4(1.0f), glm::vec3(position(rng), position(rng) * 0.1f, position(rng)));
+            model = glm::rotate(model, unit(rng) * 6.28f, glm::normalize(glm::vec3(unit(rng), 1.0f, unit(rng))));
+            model = glm::scale(model, glm::vec3(0.5f + unit(rng) * 2.0f));
+        }
+        const Aabb objectBounds = {glm::vec3(-1.0f, -0.5f, -2.0f), glm::vec3(1.0f, 0.5f, 2.0f)};
+        const float radius = glm::length(objectBounds.Extent());
+
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(50.0f, 0.0f, 30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        struct Camera
+        {
+            const char *name;
+            glm::mat4 projection;
+        };
+        const Camera cameras[] = {
+            {"perspective", glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f)},
+            {"orthographic", glm::ortho(-40.0f, 40.0f, -22.5f, 22.5f, 0.1f, 100.0f)},
+        };
+
+        CullingBounds bounds;
+        bounds.Reserve(objectCount);
+        double buildMs = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            auto start = Clock::now();
+            bounds.Clear();
+            for (const glm::mat4 &model : models)
+                bounds.Add(model, objectBounds, radius);
+            buildMs = std::min(buildMs, ElapsedMs(start));
+        }
+        std::cout << "  " << objectCount << " objects, bounds transform " << std::fixed << std::setprecision(3) << buildMs
+                  << " ms" << std::endl;
+
+        std::vector<uint8_t> visible(objectCount), reference(objectCount);
+        for (const Camera &camera : cameras)
+        {
+            Frustum frustum = Frustum::FromMatrix(camera.projection * view);
+
+            double simdMs = 1e30;
+            size_t visibleCount = 0;
+            for (int run = 0; run < runs; ++run)
+            {
+                auto start = Clock::now();
+                visibleCount = Culling::Cull(frustum, bounds, visible.data());
+                simdMs = std::min(simdMs, ElapsedMs(start));
+            }
+
+            double scalarMs = 1e30;
+            for (int run = 0; run < runs; ++run)
+            {
+                auto start = Clock::now();
+                for (size_t i = 0; i < objectCount; ++i)
+                {
+                    bool inside = true;
+                    for (const glm::vec4 &plane : frustum.planes)
+                    {
+                        glm::vec3 normal(plane);
+                        glm::vec3 c(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+                        glm::vec3 e(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+                        float distance = glm::dot(normal, c) + plane.w;
+                        inside &= distance + std::min(bounds.radius[i], glm::dot(glm::abs(normal), e)) >= 0.0f;
+                    }
+                    reference[i] = inside ? 1 : 0;
+                }
+                scalarMs = std::min(scalarMs, ElapsedMs(start));
+            }
+
+            std::cout << "  " << std::left << std::setw(13) << camera.name << std::right << std::setw(7) << visibleCount
+                      << " visible  SIMD " << std::setw(7) << simdMs << " ms (" << std::setprecision(2)
+                      << simdMs * 1e6 / objectCount << " ns/object)  scalar " << std::setprecision(3) << scalarMs << " ms"
+                      << std::endl;
+            Check(visible == reference, "SIMD culling matches the scalar test");
+        }
+    }
+
+    // Dynamic BVH against linear scans at growing object counts: build, per-frame refit of moving
+    // objects, and frustum / sphere / ray queries
+    void BenchBvh()
+    {
+        const int queryCount = 1000;
+        std::cout << "  objects   build    refit  reinserted   frustum (flat)   sphere x" << queryCount
+                  << " (linear)   ray x" << queryCount << " (linear)  height" << std::endl;
+
+        for (size_t objectCount : {1000u, 10000u, 100000u})
+        {
+            // Spread so the density (and the answer to each query) stays similar across counts
+            float worldSize = 20.0f * std::sqrt((float)objectCount);
+            std::mt19937 rng(7);
+            std::uniform_real_distribution<float> position(-worldSize * 0.5f, worldSize * 0.5f), size(0.25f, 2.0f),
+                unit(-1.0f, 1.0f);
+            std::vector<Aabb> boxes(objectCount);
+            for (Aabb &box : boxes)
+            {
+                glm::vec3 center(position(rng), position(rng) * 0.05f, position(rng));
+                glm::vec3 extent(size(rng), size(rng), size(rng));
+                box = {center - extent, center + extent};
+            }
+
+            DynamicBvh bvh;
+            std::vector<int> proxies(objectCount);
+            auto start = Clock::now();
+            for (size_t i = 0; i < objectCount; ++i)
+                proxies[i] = bvh.Insert(boxes[i], (uint32_t)i);
+            double buildMs = ElapsedMs(start);
+
+            // One animation step: everything drifts a little, 1% teleports
+            for (size_t i = 0; i < objectCount; ++i)
+            {
+                glm::vec3 offset = i % 100 == 0 ? glm::vec3(position(rng), 0.0f, position(rng)) - boxes[i].Center()
+                                                : glm::vec3(unit(rng), 0.0f, unit(rng)) * 0.05f;
+                boxes[i].min += offset;
+                boxes[i].max += offset;
+            }
+            size_t reinserted = 0;
+            start = Clock::now();
+            for (size_t i = 0; i < objectCount; ++i)
+                reinserted += bvh.Update(proxies[i], boxes[i]) ? 1 : 0;
+            double refitMs = ElapsedMs(start);
+
+            // Frustum: a ground-level camera looking across the field, against the flat SIMD pass
+            glm::mat4 projectionView = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f) *
+                                       glm::lookAt(glm::vec3(0.0f, 5.0f, 0.0f), glm::vec3(1.0f, 4.0f, 0.3f), glm::vec3(0.0f, 1.0f, 0.0f));
+            Frustum frustum = Frustum::FromMatrix(projectionView);
+            size_t frustumHits = 0;
+            start = Clock::now();
+            bvh.QueryFrustum(frustum, [&](uint32_t) { frustumHits++; });
+            double frustumMs = ElapsedMs(start);
+
+            CullingBounds flat;
+            flat.Reserve(objectCount);
+            for (const Aabb &box : boxes)
+                flat.Add(glm::mat4(1.0f), box, glm::length(box.Extent()));
+            std::vector<uint8_t> visible(objectCount);
+            start = Clock::now();
+            size_t visibleCount = Culling::Cull(frustum, flat, visible.data());
+            double flatMs = ElapsedMs(start);
+
+            std::vector<glm::vec3> points(queryCount), directions(queryCount);
+            for (int q = 0; q < queryCount; ++q)
+            {
+                points[q] = glm::vec3(position(rng), 1.0f, position(rng));
+                directions[q] = glm::normalize(glm::vec3(unit(rng), unit(rng) * 0.1f, unit(rng)));
+            }
+
+            const float radius = 10.0f;
+            size_t sphereHits = 0, linearSphereHits = 0;
+            start = Clock::now();
+            for (const glm::vec3 &point : points)
+                bvh.QuerySphere(point, radius, [&](uint32_t) { sphereHits++; });
+            double sphereMs = ElapsedMs(start);
+            start = Clock::now();
+            for (const glm::vec3 &point : points)
+            {
+                for (const Aabb &box : boxes)
+                {
+                    glm::vec3 offset = point - glm::clamp(point, box.min, box.max);
+                    linearSphereHits += glm::dot(offset, offset) <= radius * radius ? 1 : 0;
+                }
+            }
+            double linearSphereMs = ElapsedMs(start);
+
+            // Nearest hit per ray, refined against the tight boxes
+            const float noHit = 1e30f;
+            std::vector<float> rayHits(queryCount, noHit), linearRayHits(queryCount, noHit);
+            start = Clock::now();
+            for (int q = 0; q < queryCount; ++q)
+            {
+                glm::vec3 inverse = 1.0f / directions[q];
+                bvh.Raycast(points[q], directions[q], noHit, [&](uint32_t index, float &maxDistance)
+                {
+                    float t = boxes[index].Intersect(points[q], inverse, maxDistance);
+                    if (t >= 0.0f)
+                        rayHits[q] = maxDistance = t;
+                });
+            }
+            double rayMs = ElapsedMs(start);
+            start = Clock::now();
+            for (int q = 0; q < queryCount; ++q)
+            {
+                glm::vec3 inverse = 1.0f / directions[q];
+                for (const Aabb &box : boxes)
+                {
+                    float t = box.Intersect(points[q], inverse, linearRayHits[q]);
+                    if (t >= 0.0f)
+                        linearRayHits[q] = t;
+                }
+            }
+            double linearRayMs = ElapsedMs(start);
+
+            std::cout << std::fixed << std::setprecision(2) << "  " << std::setw(7) << objectCount << std::setw(8) << buildMs
+                      << std::setw(9) << refitMs << std::setw(12) << reinserted << std::setw(10) << frustumMs << " ("
+                      << std::setw(6) << flatMs << ")" << std::setw(10) << sphereMs << " (" << std::setw(7) << linearSphereMs
+                      << ")" << std::setw(10) << rayMs << " (" << std::setw(7) << linearRayMs << ")" << std::setw(6)
+                      << bvh.GetHeight() << std::endl;
+            Check(sphereHits >= linearSphereHits && rayHits == linearRayHits && frustumHits >= visibleCount,
+                  "BVH queries find every object the linear scans do");
+        }
+        std::cout << "  (times in ms)" << std::endl;
+    }
+
+    // Render queue sort at 100k draws, radix against std::sort, and the program and mesh binds
+    // submission takes in insertion order against key order
+    void BenchRenderQueue()
+    {
+        const size_t drawCount = 100000;
+        const uint32_t shaderCount = 16, meshCount = 2000;
+        const int runs = 20;
+
+        std::mt19937 rng(11);
+        std::uniform_int_distribution<uint32_t> shaderId(1, shaderCount), meshId(1, meshCount);
+        std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+        struct Draw
+        {
+            uint32_t shader, mesh;
+            float depth;
+        };
+        std::vector<Draw> draws(drawCount);
+        for (Draw &draw : draws)
+            draw = {shaderId(rng), meshId(rng), depth(rng)};
+
+        RenderQueue queue;
+        double buildMs = 1e30, radixMs = 1e30, stdMs = 1e30;
+        std::vector<RenderQueue::Item> reference;
+        for (int run = 0; run < runs; ++run)
+        {
+            auto start = Clock::now();
+            queue.Clear();
+            for (uint32_t i = 0; i < drawCount; ++i)
+                queue.Push(RenderQueue::MakeKey(RenderQueue::PASS_OPAQUE, draws[i].shader, draws[i].mesh, draws[i].depth), i);
+            buildMs = std::min(buildMs, ElapsedMs(start));
+
+            reference = queue.Items();
+            start = Clock::now();
+            std::stable_sort(reference.begin(), reference.end(),
+                             [](const RenderQueue::Item &a, const RenderQueue::Item &b) { return a.key < b.key; });
+            stdMs = std::min(stdMs, ElapsedMs(start));
+
+            start = Clock::now();
+            queue.Sort();
+            radixMs = std::min(radixMs, ElapsedMs(start));
+        }
+        bool match = std::equal(reference.begin(), reference.end(), queue.Items().begin(),
+                                [](const RenderQueue::Item &a, const RenderQueue::Item &b) { return a.index == b.index; });
+
+        // Binds a state cache cannot elide: each change of program, and of mesh
+        auto countChanges = [&](auto indexAt, size_t &shaderChanges, size_t &meshChanges)
+        {
+            shaderChanges = meshChanges = 0;
+            uint32_t shader = 0, mesh = 0;
+            for (size_t i = 0; i < drawCount; ++i)
+            {
+                const Draw &draw = draws[indexAt(i)];
+                shaderChanges += draw.shader != shader;
+                meshChanges += draw.mesh != mesh;
+                shader = draw.shader;
+                mesh = draw.mesh;
+            }
+        };
+        size_t unsortedShaders, unsortedMeshes, sortedShaders, sortedMeshes;
+        countChanges([](size_t i) { return i; }, unsortedShaders, unsortedMeshes);
+        countChanges([&](size_t i) { return queue.Items()[i].index; }, sortedShaders, sortedMeshes);
+
+        std::cout << "  " << drawCount << " draws, " << shaderCount << " programs, " << meshCount << " meshes" << std::endl;
+        std::cout << std::fixed << std::setprecision(3) << "  key build " << buildMs << " ms, radix sort " << radixMs
+                  << " ms, std::stable_sort " << stdMs << " ms" << std::endl;
+        std::cout << "  program binds " << unsortedShaders << " -> " << sortedShaders << ", mesh binds " << unsortedMeshes
+                  << " -> " << sortedMeshes << std::endl;
+        Check(match, "radix sort order matches std::stable_sort");
+    }
+
+    // Transform hierarchy propagation at 100k nodes (2500 roots, three levels of three children each),
+    // against rebuilding every world matrix from translate/rotate/scale each frame
+    void BenchTransforms()
+    {
+        const size_t rootCount = 2500;
+        const int childrenPerNode = 3, levels = 3; // 1 + 3 + 9 + 27 nodes per root
+        const int runs = 20;
+
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        TransformHierarchy hierarchy;
+        struct Naive
+        {
+            int parent;
+            glm::vec3 position;
+            float angle;
+            glm::vec3 scale;
+        };
+        std::vector<Naive> naive;
+        std::vector<TransformHierarchy::NodeId> roots; // Node ids match the indices in 'naive'
+        for (size_t r = 0; r < rootCount; ++r)
+        {
+            std::vector<std::pair<TransformHierarchy::NodeId, int>> frontier;
+            TransformHierarchy::NodeId root = hierarchy.Create();
+            roots.push_back(root);
+            naive.push_back({-1, glm::vec3(unit(rng), unit(rng), unit(rng)) * 100.0f, unit(rng), glm::vec3(1.0f)});
+            hierarchy.SetLocal(root, naive.back().position, glm::angleAxis(naive.back().angle, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(1.0f));
+            frontier.push_back({root, (int)naive.size() - 1});
+            for (int level = 0; level < levels; ++level)
+            {
+                std::vector<std::pair<TransformHierarchy::NodeId, int>> next;
+                for (auto [parent, parentIndex] : frontier)
+                {
+                    for (int c = 0; c < childrenPerNode; ++c)
+                    {
+                        TransformHierarchy::NodeId node = hierarchy.Create(parent);
+                        naive.push_back({parentIndex, glm::vec3(unit(rng), unit(rng), unit(rng)), unit(rng), glm::vec3(0.9f)});
+                        hierarchy.SetLocal(node, naive.back().position, glm::angleAxis(naive.back().angle, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(0.9f));
+                        next.push_back({node, (int)naive.size() - 1});
+                    }
+                }
+                frontier.swap(next);
+            }
+        }
+
+        auto start = Clock::now();
+        hierarchy.Update();
+        double firstMs = ElapsedMs(start);
+
+        // Naive: every frame, every node, parent first (the creation order above guarantees it)
+        std::vector<glm::mat4> naiveWorld(naive.size());
+        double naiveMs = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            start = Clock::now();
+            for (size_t i = 0; i < naive.size(); ++i)
+            {
+                const Naive &n = naive[i];
+                glm::mat4 local = glm::translate(glm::mat4(1.0f), n.position);
+                local = glm::rotate(local, n.angle, glm::vec3(0.0f, 1.0f, 0.0f));
+                local = glm::scale(local, n.scale);
+                naiveWorld[i] = n.parent >= 0 ? naiveWorld[n.parent] * local : local;
+            }
+            naiveMs = std::min(naiveMs, ElapsedMs(start));
+        }
+
+        float maxError = 0.0f;
+        for (size_t i = 0; i < naive.size(); ++i)
+        {
+            const glm::mat4 &world = hierarchy.GetWorld((TransformHierarchy::NodeId)i);
+            for (int column = 0; column < 4; ++column)
+                maxError = std::max(maxError, glm::length(world[column] - naiveWorld[i][column]));
+        }
+
+        std::cout << "  " << hierarchy.Size() << " nodes, " << hierarchy.LevelCount() << " levels; first update "
+                  << std::fixed << std::setprecision(3) << firstMs << " ms, naive rebuild " << naiveMs << " ms" << std::endl;
+        Check(maxError < 1e-3f, "world transforms match the naive rebuild");
+
+        for (double movingFraction : {1.0, 0.1, 0.01, 0.0})
+        {
+            size_t moving = (size_t)(rootCount * movingFraction);
+            double updateMs = 1e30;
+            for (int run = 0; run < runs; ++run)
+            {
+                for (size_t r = 0; r < moving; ++r)
+                    hierarchy.SetTranslation(roots[r], glm::vec3((float)run, 0.0f, (float)r));
+                start = Clock::now();
+                hierarchy.Update();
+                updateMs = std::min(updateMs, ElapsedMs(start));
+            }
+            std::cout << "  " << std::setw(6) << std::setprecision(1) << movingFraction * 100.0 << "% of roots moving: "
+                      << std::setprecision(3) << std::setw(7) << updateMs << " ms (" << hierarchy.LastUpdatedCount()
+                      << " world matrices)" << std::endl;
+        }
+    }
+
+    // Per-frame object pass at 1M objects: copy the world matrix, transform the bounds and test them
+    // against the frustum. The dense ObjectStore columns against the layout the scene used before,
+    // one heap object per entry (with its cold draw-only state inline) reached through a pointer list
+    // in creation order, which after some churn no longer matches allocation order.
+    void BenchObjectStore()
+    {
+        const size_t objectCount = 1000000;
+        const int runs = 10;
+
+        struct LegacyObject
+        {
+            virtual ~LegacyObject() = default;
+            unsigned int vao = 0, vbo = 0, ebo = 0;
+            char drawState[96] = {}; // LOD tables, sub-meshes, arena range
+            glm::mat4 model = glm::mat4(1.0f);
+            Aabb localBounds, worldBounds;
+            bool visible = true;
+        };
+
+        std::mt19937 rng(21);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        TransformHierarchy hierarchy;
+        ObjectStore store(hierarchy);
+        store.Reserve(objectCount);
+        std::vector<std::unique_ptr<LegacyObject>> legacy(objectCount);
+        std::vector<ObjectHandle> handles(objectCount);
+        for (size_t i = 0; i < objectCount; ++i)
+            legacy[i] = std::make_unique<LegacyObject>();
+        std::shuffle(legacy.begin(), legacy.end(), rng);
+        for (size_t i = 0; i < objectCount; ++i)
+        {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(unit(rng), unit(rng) * 0.1f, unit(rng)) * 500.0f);
+            model = glm::rotate(model, unit(rng) * 3.14159f, glm::vec3(0.0f, 1.0f, 0.0f));
+            glm::vec3 extent = glm::vec3(0.5f + 0.5f * std::abs(unit(rng)));
+            Aabb bounds{-extent, extent};
+
+            handles[i] = store.Create(nullptr, nullptr);
+            store.models[i] = model;
+            store.localBounds[i] = bounds;
+            legacy[i]->model = model;
+            legacy[i]->localBounds = bounds;
+        }
+
+        Frustum frustum = Frustum::FromMatrix(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f) *
+                                              glm::lookAt(glm::vec3(0.0f, 20.0f, 0.0f), glm::vec3(1.0f, 20.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+        auto inFrustum = [&](const Aabb &box)
+        {
+            for (const glm::vec4 &plane : frustum.planes)
+            {
+                glm::vec3 positive = glm::mix(box.min, box.max, glm::step(glm::vec3(0.0f), glm::vec3(plane)));
+                if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+                    return false;
+            }
+            return true;
+        };
+
+        double storeMs = 1e30, legacyMs = 1e30;
+        size_t storeVisible = 0, legacyVisible = 0;
+        for (int run = 0; run < runs; ++run)
+        {
+            auto start = Clock::now();
+            storeVisible = 0;
+            for (size_t i = 0; i < store.Size(); ++i)
+            {
+                store.worldBounds[i] = store.localBounds[i].Transformed(store.models[i]);
+                bool visible = inFrustum(store.worldBounds[i]);
+                store.flags[i] = visible ? (store.flags[i] | ObjectStore::FLAG_VISIBLE) : (store.flags[i] & ~ObjectStore::FLAG_VISIBLE);
+                storeVisible += visible;
+            }
+            storeMs = std::min(storeMs, ElapsedMs(start));
+
+            start = Clock::now();
+            legacyVisible = 0;
+            for (const std::unique_ptr<LegacyObject> &object : legacy)
+            {
+                object->worldBounds = object->localBounds.Transformed(object->model);
+                object->visible = inFrustum(object->worldBounds);
+                legacyVisible += object->visible;
+            }
+            legacyMs = std::min(legacyMs, ElapsedMs(start));
+        }
+
+        // Handle lookups in random order, then destroying a tenth of the objects
+        std::vector<ObjectHandle> lookups(handles);
+        std::shuffle(lookups.begin(), lookups.end(), rng);
+        auto start = Clock::now();
+        size_t resolved = 0;
+        for (ObjectHandle handle : lookups)
+            resolved += store.IndexOf(handle) != ObjectStore::INVALID_INDEX;
+        double resolveMs = ElapsedMs(start);
+
+        start = Clock::now();
+        for (size_t i = 0; i < objectCount; i += 10)
+            store.Destroy(handles[i]);
+        double destroyMs = ElapsedMs(start);
+        size_t stale = 0;
+        for (size_t i = 0; i < objectCount; ++i)
+            stale += store.IsValid(handles[i]) != (i % 10 != 0);
+        // Reused slots must not revive the destroyed handles
+        for (size_t i = 0; i < objectCount; i += 10)
+            store.Create(nullptr, nullptr);
+        for (size_t i = 0; i < objectCount; i += 10)
+            stale += store.IsValid(handles[i]);
+
+        std::cout << "  " << objectCount << " objects, " << storeVisible << " visible" << std::endl;
+        std::cout << std::fixed << std::setprecision(3) << "  bounds + frustum pass: dense columns " << storeMs
+                  << " ms, heap objects " << legacyMs << " ms" << std::endl;
+        std::cout << "  " << resolved << " handle lookups " << resolveMs << " ms, " << objectCount / 10 << " destroys "
+                  << destroyMs << " ms" << std::endl;
+        Check(storeVisible == legacyVisible, "dense columns cull the same objects as the heap objects");
+        Check(stale == 0, "destroyed handles stay invalid after their slots are reused");
+    }
+
+    // Clustered light assignment for 4096 point lights scattered over a street grid in front of the camera,
+    // against testing every light against every cluster. Validated by sampling points in the frustum:
+    // every light whose sphere contains a point must be listed in the point's cluster.
+    void BenchLightClusters()
+    {
+        const size_t lightCount = LightClusters::MAX_LIGHTS;
+        const float nearPlane = 0.1f, farPlane = 100.0f;
+        const int runs = 20;
+
+        std::mt19937 rng(8);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, nearPlane, farPlane);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 4.0f, 0.0f), glm::vec3(0.0f, 2.0f, -20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        std::vector<LightClusters::LightBounds> bounds(lightCount);
+        for (LightClusters::LightBounds &light : bounds)
+        {
+            glm::vec3 world((unit(rng) - 0.5f) * 120.0f, unit(rng) * 3.0f, -unit(rng) * 110.0f + 5.0f);
+            light = {glm::vec3(view * glm::vec4(world, 1.0f)), 1.0f + unit(rng) * 3.0f};
+        }
+
+        LightClusters clusters;
+        double assignMs = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            auto start = Clock::now();
+            clusters.Assign(bounds, projection, nearPlane, farPlane);
+            assignMs = std::min(assignMs, ElapsedMs(start));
+        }
+
+        // Brute force: every light against every cluster box
+        double bruteMs = 1e30;
+        size_t bruteIndices = 0;
+        for (int run = 0; run < 3; ++run)
+        {
+            auto start = Clock::now();
+            bruteIndices = 0;
+            for (int cluster = 0; cluster < LightClusters::CLUSTER_COUNT; ++cluster)
+            {
+                const Aabb &box = clusters.GetClusterBounds(cluster);
+                for (const LightClusters::LightBounds &light : bounds)
+                {
+                    glm::vec3 offset = light.center - glm::clamp(light.center, box.min, box.max);
+                    bruteIndices += glm::dot(offset, offset) <= light.radius * light.radius;
+                }
+            }
+            bruteMs = std::min(bruteMs, ElapsedMs(start));
+        }
+
+        // Cluster lookup as in lighting_pass.fs.glsl
+        glm::mat4 inverseProjection = glm::inverse(projection);
+        glm::vec2 sliceParams = clusters.GetSliceParams();
+        size_t missing = 0, samples = 200000, lightsPerSample = 0;
+        for (size_t sample = 0; sample < samples; ++sample)
+        {
+            glm::vec2 uv(unit(rng), unit(rng));
+            float depth = nearPlane * std::pow(farPlane / nearPlane, unit(rng));
+            glm::vec4 farPoint = inverseProjection * glm::vec4(uv * 2.0f - 1.0f, 1.0f, 1.0f);
+            glm::vec3 direction = glm::vec3(farPoint) / farPoint.w;
+            glm::vec3 point = direction * (depth / -direction.z);
+
+            glm::ivec2 tile = glm::min(glm::ivec2(uv * glm::vec2(LightClusters::TILES_X, LightClusters::TILES_Y)),
+                                       glm::ivec2(LightClusters::TILES_X - 1, LightClusters::TILES_Y - 1));
+            int slice = std::clamp((int)std::floor(std::log(depth) * sliceParams.x - sliceParams.y), 0, LightClusters::SLICES - 1);
+            glm::uvec2 range = clusters.GetRanges()[LightClusters::ClusterIndex(tile.x, tile.y, slice)];
+            const uint16_t *listed = clusters.GetIndices().data() + range.x;
+            lightsPerSample += range.y;
+            for (size_t i = 0; i < lightCount; ++i)
+            {
+                glm::vec3 offset = point - bounds[i].center;
+                if (glm::dot(offset, offset) <= bounds[i].radius * bounds[i].radius &&
+                    std::find(listed, listed + range.y, (uint16_t)i) == listed + range.y)
+                    missing++;
+            }
+        }
+
+        std::cout << "  " << lightCount << " lights, " << LightClusters::CLUSTER_COUNT << " clusters (" << LightClusters::TILES_X
+                  << "x" << LightClusters::TILES_Y << "x" << LightClusters::SLICES << "), " << ThreadPool::Shared().Size()
+                  << " worker threads" << std::endl;
+        std::cout << std::fixed << std::setprecision(3) << "  assign " << assignMs << " ms, brute force " << bruteMs << " ms"
+                  << std::endl;
+        std::cout << "  " << clusters.IndexCount() << " indices (brute force " << bruteIndices << "), max "
+                  << clusters.MaxClusterLights() << " per cluster, " << std::setprecision(1)
+                  << (double)lightsPerSample / samples << " per sampled point (of " << lightCount << ")" << std::endl;
+        Check(missing == 0, "clusters hold every light reaching the sampled points");
+    }
+
+    struct BenchmarkEntry
+    {
+        const char *name;
+        std::function<void()> run;
+    };
+
+    const std::vector<BenchmarkEntry> &Benchmarks()
+    {
+        static const std::vector<BenchmarkEntry> entries = {
+            {"obj-load", BenchObjLoad},
+            {"obj-threads", BenchObjThreads},
+            {"mesh-cache", BenchMeshCache},
+            {"mesh-optimize", BenchMeshOptimize},
+            {"mesh-lod", BenchMeshLod},
+            {"lod-error", BenchLodError},
+            {"frustum-cull", BenchFrustumCull},
+            {"bvh", BenchBvh},
+            {"render-queue", BenchRenderQueue},
+            {"transforms", BenchTransforms},
+            {"object-store", BenchObjectStore},
+            {"light-clusters", BenchLightClusters},
+        };
+        return entries;
+    }
+}
+
+int RunBenchmarks(int argc, char **argv)
+{
+    bool ranAny = false;
+    for (const BenchmarkEntry &entry : Benchmarks())
+    {
+        bool selected = argc == 0;
+        for (int i = 0; i < argc; ++i)
+            selected |= std::strcmp(argv[i], entry.name) == 0;
+        if (!selected)
+            continue;
+
+        std::cout << "[" << entry.name << "]" << std::endl;
+        entry.run();
+        ranAny = true;
+    }
+
+    if (!ranAny)
+    {
+        std::cout << "Unknown benchmark. Available:";
+        for (const BenchmarkEntry &entry : Benchmarks())
+            std::cout << " " << entry.name;
+        std::cout << std::endl;
+        return 1;
+    }
+    return checkFailed ? 1 : 0;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// CPU-side benchmarks that do not need a window or GL context.
+// Invoked as: gk-opengl --bench [name...]   (no names runs everything)
+int RunBenchmarks(int argc, char **argv);
@@ -0,0 +1,261 @@
+#include "Bvh.h"
+
+int DynamicBvh::AllocateNode()
+{
+    if (freeList == NULL_NODE)
+    {
+        nodes.emplace_back();
+        return (int)nodes.size() - 1;
+    }
+    int index = freeList;
+    freeList = nodes[index].parent;
+    nodes[index] = Node();
+    return index;
+}
+
+void DynamicBvh::FreeNode(int node)
+{
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+Aabb DynamicBvh::Fatten(const Aabb &bounds) const
+{
+    glm::vec3 enlarge(margin);
+    return {bounds.min - enlarge, bounds.max + enlarge};
+}
+
+int DynamicBvh::Insert(const Aabb &bounds, uint32_t userData)
+{
+    int leaf = AllocateNode();
+    nodes[leaf].bounds = Fatten(bounds);
+    nodes[leaf].userData = userData;
+    InsertLeaf(leaf);
+    leafCount++;
+    return leaf;
+}
+
+void DynamicBvh::Remove(int proxy)
+{
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    leafCount--;
+}
+
+bool DynamicBvh::Update(int proxy, const Aabb &bounds)
+{
+    // Still inside its fat box, and the fat box is not much larger than needed: nothing to do.
+    // The second test keeps objects that shrank or stopped moving from keeping oversized boxes.
+    const Aabb &fat = nodes[proxy].bounds;
+    if (fat.Contains(bounds))
+    {
+        glm::vec3 slack(4.0f * margin);
+        Aabb loose = {bounds.min - slack, bounds.max + slack};
+        if (loose.Contains(fat))
+            return false;
+    }
+
+    RemoveLeaf(proxy);
+    nodes[proxy].bounds = Fatten(bounds);
+    InsertLeaf(proxy);
+    return true;
+}
+
+float DynamicBvh::GetAreaRatio() const
+{
+    if (root == NULL_NODE)
+        return 0.0f;
+    float rootArea = nodes[root].bounds.SurfaceArea();
+    float total = 0.0f;
+    for (const Node &node : nodes)
+    {
+        if (node.height > 0) // Internal and not free
+            total += node.bounds.SurfaceArea();
+    }
+    return rootArea > 0.0f ? total / rootArea : 0.0f;
+}
+
+void DynamicBvh::InsertLeaf(int leaf)
+{
+    if (root == NULL_NODE)
+    {
+        root = leaf;
+        nodes[root].parent = NULL_NODE;
+        return;
+    }
+
+    // Walk down to the best sibling. At each node, compare pairing the leaf with this node against
+    // descending into either child; every ancestor on the way grows to include the leaf, which is
+    // the 'inheritance' cost common to both children.
+    Aabb leafBounds = nodes[leaf].bounds;
+    int index = root;
+    while (!nodes[index].IsLeaf())
+    {
+        const Node &node = nodes[index];
+        float area = node.bounds.SurfaceArea();
+        float combinedArea = Aabb::Union(node.bounds, leafBounds).SurfaceArea();
+
+        float cost = 2.0f * combinedArea;                       // New parent of this node and the leaf
+        float inheritance = 2.0f * (combinedArea - area);       // Growth of this node if we descend
+
+        auto descendCost = [&](int child)
+        {
+            const Node &c = nodes[child];
+            float grownArea = Aabb::Union(leafBounds, c.bounds).SurfaceArea();
+            return (c.IsLeaf() ? grownArea : grownArea - c.bounds.SurfaceArea()) + inheritance;
+        };
+        float cost1 = descendCost(node.child1);
+        float cost2 = descendCost(node.child2);
+
+        if (cost < cost1 && cost < cost2)
+            break;
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    // Replace the sibling with a new parent of the sibling and the leaf
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = AllocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].bounds = Aabb::Union(leafBounds, nodes[sibling].bounds);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent == NULL_NODE)
+        root = newParent;
+    else if (nodes[oldParent].child1 == sibling)
+        nodes[oldParent].child1 = newParent;
+    else
+        nodes[oldParent].child2 = newParent;
+
+    RefitUpwards(newParent);
+}
+
+void DynamicBvh::RemoveLeaf(int leaf)
+{
+    if (leaf == root)
+    {
+        root = NULL_NODE;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    // The sibling takes the parent's place
+    if (grandParent == NULL_NODE)
+    {
+        root = sibling;
+        nodes[sibling].parent = NULL_NODE;
+        FreeNode(parent);
+        return;
+    }
+
+    if (nodes[grandParent].child1 == parent)
+        nodes[grandParent].child1 = sibling;
+    else
+        nodes[grandParent].child2 = sibling;
+    nodes[sibling].parent = grandParent;
+    FreeNode(parent);
+
+    RefitUpwards(grandParent);
+}
+
+void DynamicBvh::RefitUpwards(int index)
+{
+    while (index != NULL_NODE)
+    {
+        index = Balance(index);
+        Node &node = nodes[index];
+        node.bounds = Aabb::Union(nodes[node.child1].bounds, nodes[node.child2].bounds);
+        node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+        index = node.parent;
+    }
+}
+
+int DynamicBvh::Balance(int iA)
+{
+    // Rotates the taller grandchild subtree up when the children's heights differ by more than one.
+    // Returns the node that now occupies A's place.
+    Node &A = nodes[iA];
+    if (A.IsLeaf() || A.height < 2)
+        return iA;
+
+    int iB = A.child1;
+    int iC = A.child2;
+    Node &B = nodes[iB];
+    Node &C = nodes[iC];
+    int balance = C.height - B.height;
+
+    auto replaceChild = [&](int parent, int oldChild, int newChild)
+    {
+        if (parent == NULL_NODE)
+            root = newChild;
+        else if (nodes[parent].child1 == oldChild)
+            nodes[parent].child1 = newChild;
+        else
+            nodes[parent].child2 = newChild;
+    };
+
+    if (balance > 1)
+    {
+        // Rotate C up
+        int iF = C.child1;
+        int iG = C.child2;
+        Node &F = nodes[iF];
+        Node &G = nodes[iG];
+
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+        replaceChild(C.parent, iA, iC);
+
+        // The taller of F and G stays under C, the other replaces C under A
+        int iKeep = F.height > G.height ? iF : iG;
+        int iMove = F.height > G.height ? iG : iF;
+        Node &keep = nodes[iKeep];
+        Node &move = nodes[iMove];
+        C.child2 = iKeep;
+        A.child2 = iMove;
+        move.parent = iA;
+        A.bounds = Aabb::Union(B.bounds, move.bounds);
+        C.bounds = Aabb::Union(A.bounds, keep.bounds);
+        A.height = 1 + std::max(B.height, move.height);
+        C.height = 1 + std::max(A.height, keep.height);
+        return iC;
+    }
+
+    if (balance < -1)
+    {
+        // Rotate B up
+        int iD = B.child1;
+        int iE = B.child2;
+        Node &D = nodes[iD];
+        Node &E = nodes[iE];
+
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+        replaceChild(B.parent, iA, iB);
+
+        int iKeep = D.height > E.height ? iD : iE;
+        int iMove = D.height > E.height ? iE : iD;
+        Node &keep = nodes[iKeep];
+        Node &move = nodes[iMove];
+        B.child2 = iKeep;
+        A.child1 = iMove;
+        move.parent = iA;
+        A.bounds = Aabb::Union(C.bounds, move.bounds);
+        B.bounds = Aabb::Union(A.bounds, keep.bounds);
+        A.height = 1 + std::max(C.height, move.height);
+        B.height = 1 + std::max(A.height, keep.height);
+        return iB;
+    }
+
+    return iA;
+}
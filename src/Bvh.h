@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Culling.h"
+
+// Dynamic AABB tree over objects identified by a user value (e.g. an index into the scene).
+// Leaves store "fat" boxes, enlarged by 'margin', so an object that moves a little needs no tree
+// update at all; one that leaves its fat box is removed and reinserted. Insertion walks down by
+// surface area heuristic cost and the path back up is rebalanced with tree rotations, so the tree
+// stays shallow without ever being rebuilt.
+// Queries report leaves whose fat box passes the test, so callers needing exact results refine
+// them against their own tight bounds.
+class DynamicBvh
+{
+public:
+    static const int NULL_NODE = -1;
+
+    explicit DynamicBvh(float margin = 0.25f) : margin(margin) {}
+
+    // Returns a proxy id that stays valid until Remove
+    int Insert(const Aabb &bounds, uint32_t userData);
+    void Remove(int proxy);
+    // Moves a proxy to new tight bounds. Returns true if the tree had to change.
+    bool Update(int proxy, const Aabb &bounds);
+
+    uint32_t GetUserData(int proxy) const { return nodes[proxy].userData; }
+    const Aabb &GetFatBounds(int proxy) const { return nodes[proxy].bounds; }
+    size_t Size() const { return leafCount; }
+    int GetHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+    // Sum of the internal node areas over the root area: the SAH cost of the tree, lower is better
+    float GetAreaRatio() const;
+
+    // Calls callback(userData) for every leaf overlapping 'bounds'
+    template <typename Callback>
+    void QueryAabb(const Aabb &bounds, Callback &&callback) const
+    {
+        Traverse([&](const Aabb &node) { return node.Overlaps(bounds); }, callback);
+    }
+
+    // Calls callback(userData) for every leaf overlapping the sphere
+    template <typename Callback>
+    void QuerySphere(const glm::vec3 &center, float radius, Callback &&callback) const
+    {
+        float radiusSquared = radius * radius;
+        Traverse([&](const Aabb &node)
+        {
+            glm::vec3 offset = center - glm::clamp(center, node.min, node.max);
+            return glm::dot(offset, offset) <= radiusSquared;
+        }, callback);
+    }
+
+    // Calls callback(userData) for every leaf intersecting the frustum. Subtrees entirely inside
+    // are reported without testing their nodes.
+    template <typename Callback>
+    void QueryFrustum(const Frustum &frustum, Callback &&callback) const;
+
+    // Calls callback(userData, maxDistance) for every leaf the ray hits within 'maxDistance', nearest
+    // subtrees first. The callback may lower 'maxDistance' (e.g. to its exact hit) to prune the rest.
+    template <typename Callback>
+    void Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Callback &&callback) const;
+
+private:
+    struct Node
+    {
+        Aabb bounds;
+        int parent = NULL_NODE; // Next free node while on the free list
+        int child1 = NULL_NODE;
+        int child2 = NULL_NODE;
+        int height = 0; // 0 for leaves, -1 while free
+        uint32_t userData = 0;
+
+        bool IsLeaf() const { return child1 == NULL_NODE; }
+    };
+
+    std::vector<Node> nodes;
+    int root = NULL_NODE;
+    int freeList = NULL_NODE;
+    size_t leafCount = 0;
+    float margin;
+
+    int AllocateNode();
+    void FreeNode(int node);
+    void InsertLeaf(int leaf);
+    void RemoveLeaf(int leaf);
+    int Balance(int node);
+    // Recomputes bounds and heights from 'node' up to the root, rebalancing on the way
+    void RefitUpwards(int node);
+    Aabb Fatten(const Aabb &bounds) const;
+
+    template <typename Test, typename Callback>
+    void Traverse(Test &&test, Callback &&callback) const
+    {
+        if (root == NULL_NODE)
+            return;
+        std::vector<int> stack;
+        stack.reserve(64);
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if (!test(node.bounds))
+                continue;
+            if (node.IsLeaf())
+            {
+                callback(node.userData);
+                continue;
+            }
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+};
+
+template <typename Callback>
+void DynamicBvh::QueryFrustum(const Frustum &frustum, Callback &&callback) const
+{
+    if (root == NULL_NODE)
+        return;
+
+    // Each entry carries a bit per plane that still needs testing; planes a parent is entirely
+    // inside of are skipped for the whole subtree
+    const unsigned int ALL_PLANES = 0x3F;
+    std::vector<std::pair<int, unsigned int>> stack;
+    stack.reserve(64);
+    stack.push_back({root, ALL_PLANES});
+    while (!stack.empty())
+    {
+        auto [index, planeMask] = stack.back();
+        stack.pop_back();
+        const Node &node = nodes[index];
+
+        bool outside = false;
+        glm::vec3 center = node.bounds.Center(), extent = node.bounds.Extent();
+        for (int p = 0; p < 6 && !outside; ++p)
+        {
+            if (!(planeMask & (1u << p)))
+                continue;
+            const glm::vec4 &plane = frustum.planes[p];
+            float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+            if (distance + radius < 0.0f)
+                outside = true;
+            else if (distance - radius >= 0.0f)
+                planeMask &= ~(1u << p);
+        }
+        if (outside)
+            continue;
+
+        if (node.IsLeaf())
+            callback(node.userData);
+        else
+        {
+            stack.push_back({node.child1, planeMask});
+            stack.push_back({node.child2, planeMask});
+        }
+    }
+}
+
+template <typename Callback>
+void DynamicBvh::Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Callback &&callback) const
+{
+    if (root == NULL_NODE)
+        return;
+
+    glm::vec3 inverseDirection = 1.0f / direction; // Infinities for axis-parallel rays are handled by the slab test
+    std::vector<std::pair<int, float>> stack;      // Node and its entry distance
+    stack.reserve(64);
+    float rootEnter = nodes[root].bounds.Intersect(origin, inverseDirection, maxDistance);
+    if (rootEnter >= 0.0f)
+        stack.push_back({root, rootEnter});
+    while (!stack.empty())
+    {
+        auto [index, enter] = stack.back();
+        stack.pop_back();
+        if (enter > maxDistance)
+            continue; // A closer hit was found after this node was pushed
+
+        const Node &node = nodes[index];
+        if (node.IsLeaf())
+        {
+            callback(node.userData, maxDistance);
+            continue;
+        }
+
+        float enter1 = nodes[node.child1].bounds.Intersect(origin, inverseDirection, maxDistance);
+        float enter2 = nodes[node.child2].bounds.Intersect(origin, inverseDirection, maxDistance);
+        // Push the farther child first so the nearer one is visited first
+        int first = node.child1, second = node.child2;
+        if (enter2 >= 0.0f && (enter1 < 0.0f || enter2 < enter1))
+        {
+            std::swap(first, second);
+            std::swap(enter1, enter2);
+        }
+        if (enter2 >= 0.0f)
+            stack.push_back({second, enter2});
+        if (enter1 >= 0.0f)
+            stack.push_back({first, enter1});
+    }
+}
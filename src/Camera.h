@@ -27,6 +27,9 @@ const float PITCH = 0.0f;
 const float SPEED = 2.5f;
 const float SENSITIVITY = 0.1f;
 const float ZOOM = 45.0f;
+// Clip planes of both projections
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
 
 class Camera
 {
@@ -68,13 +71,13 @@ public:
         float aspectRatio = width / height;
         if (Type == ProjectionType::Perspective)
         {
-            return glm::perspective(glm::radians(Zoom), aspectRatio, 0.1f, 100.0f);
+            return glm::perspective(glm::radians(Zoom), aspectRatio, NEAR_PLANE, FAR_PLANE);
         }
         else
         {
             float halfHeight = OrthoHeight / 2.0f;
             float halfWidth = halfHeight * aspectRatio;
-            return glm::ortho(-halfWidth, halfWidth, -halfHeight, halfHeight, 0.1f, 100.0f);
+            return glm::ortho(-halfWidth, halfWidth, -halfHeight, halfHeight, NEAR_PLANE, FAR_PLANE);
         }
     }
 
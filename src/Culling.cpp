@@ -0,0 +1,139 @@
+#include "Culling.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULLING_SSE 1
+#endif
+
+Frustum Frustum::FromMatrix(const glm::mat4 &projectionView)
+{
+    // Gribb/Hartmann: each plane is the last row of the matrix plus or minus one of the others
+    // (glm is column-major, so row i is m[0][i], m[1][i], m[2][i], m[3][i])
+    auto row = [&](int i)
+    {
+        return glm::vec4(projectionView[0][i], projectionView[1][i], projectionView[2][i], projectionView[3][i]);
+    };
+    glm::vec4 x = row(0), y = row(1), z = row(2), w = row(3);
+
+    Frustum frustum;
+    frustum.planes[0] = w + x;
+    frustum.planes[1] = w - x;
+    frustum.planes[2] = w + y;
+    frustum.planes[3] = w - y;
+    frustum.planes[4] = w + z;
+    frustum.planes[5] = w - z;
+    for (glm::vec4 &plane : frustum.planes)
+        plane /= glm::length(glm::vec3(plane));
+    return frustum;
+}
+
+void CullingBounds::Clear()
+{
+    for (std::vector<float> *array : {&centerX, &centerY, &centerZ, &radius, &extentX, &extentY, &extentZ})
+        array->clear();
+}
+
+void CullingBounds::Reserve(size_t count)
+{
+    for (std::vector<float> *array : {&centerX, &centerY, &centerZ, &radius, &extentX, &extentY, &extentZ})
+        array->reserve(count);
+}
+
+void CullingBounds::Add(const glm::mat4 &model, const Aabb &objectBounds, float objectRadius)
+{
+    Aabb world = objectBounds.Transformed(model);
+    glm::vec3 worldCenter = world.Center();
+    glm::vec3 worldExtent = world.Extent();
+    glm::mat3 linear(model);
+
+    // The sphere scales with the largest axis; the box's circumscribed sphere can still be tighter
+    float maxScaleSquared = std::max({glm::dot(linear[0], linear[0]), glm::dot(linear[1], linear[1]),
+                                      glm::dot(linear[2], linear[2])});
+    float worldRadius = std::sqrt(std::min(objectRadius * objectRadius * maxScaleSquared, glm::dot(worldExtent, worldExtent)));
+
+    centerX.push_back(worldCenter.x);
+    centerY.push_back(worldCenter.y);
+    centerZ.push_back(worldCenter.z);
+    radius.push_back(worldRadius);
+    extentX.push_back(worldExtent.x);
+    extentY.push_back(worldExtent.y);
+    extentZ.push_back(worldExtent.z);
+}
+
+namespace
+{
+    bool IsVisible(const Frustum &frustum, const CullingBounds &bounds, size_t i)
+    {
+        for (const glm::vec4 &plane : frustum.planes)
+        {
+            float distance = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w;
+            float boxRadius = std::abs(plane.x) * bounds.extentX[i] + std::abs(plane.y) * bounds.extentY[i] +
+                              std::abs(plane.z) * bounds.extentZ[i];
+            if (distance + std::min(bounds.radius[i], boxRadius) < 0.0f)
+                return false;
+        }
+        return true;
+    }
+}
+
+size_t Culling::Cull(const Frustum &frustum, const CullingBounds &bounds, uint8_t *visible)
+{
+    size_t count = bounds.Size();
+    size_t visibleCount = 0;
+    size_t i = 0;
+
+#ifdef CULLING_SSE
+    // Planes broadcast once; the box radius along a plane needs |normal|
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        const glm::vec4 &plane = frustum.planes[p];
+        planeX[p] = _mm_set1_ps(plane.x);
+        planeY[p] = _mm_set1_ps(plane.y);
+        planeZ[p] = _mm_set1_ps(plane.z);
+        planeW[p] = _mm_set1_ps(plane.w);
+        absX[p] = _mm_set1_ps(std::abs(plane.x));
+        absY[p] = _mm_set1_ps(std::abs(plane.y));
+        absZ[p] = _mm_set1_ps(std::abs(plane.z));
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+        __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+        __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 r = _mm_loadu_ps(&bounds.radius[i]);
+        __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+        __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+        __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+
+        __m128 outside = zero;
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                                         _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+            __m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)),
+                                          _mm_mul_ps(absZ[p], ez));
+            // Outside when distance < -min(sphere radius, box radius), i.e. distance + min(...) < 0
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, _mm_min_ps(r, boxRadius)), zero));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int k = 0; k < 4; ++k)
+        {
+            visible[i + k] = (mask >> k) & 1 ? 0 : 1;
+            visibleCount += visible[i + k];
+        }
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        visible[i] = IsVisible(frustum, bounds, i) ? 1 : 0;
+        visibleCount += visible[i];
+    }
+    return visibleCount;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Axis-aligned bounding box
+struct Aabb
+{
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+
+    glm::vec3 Center() const { return (min + max) * 0.5f; }
+    glm::vec3 Extent() const { return (max - min) * 0.5f; }
+    float SurfaceArea() const
+    {
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+    bool Contains(const Aabb &other) const
+    {
+        return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+    }
+    bool Overlaps(const Aabb &other) const
+    {
+        return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::greaterThanEqual(max, other.min));
+    }
+    static Aabb Union(const Aabb &a, const Aabb &b) { return {glm::min(a.min, b.min), glm::max(a.max, b.max)}; }
+
+    // Box around this one after 'model' (Arvo: the half size along each axis is |M| * extent)
+    Aabb Transformed(const glm::mat4 &model) const
+    {
+        glm::vec3 center = glm::vec3(model * glm::vec4(Center(), 1.0f));
+        glm::mat3 linear(model);
+        glm::vec3 e = Extent();
+        glm::vec3 extent = glm::abs(linear[0]) * e.x + glm::abs(linear[1]) * e.y + glm::abs(linear[2]) * e.z;
+        return {center - extent, center + extent};
+    }
+
+    // Slab test against the ray origin + t * direction for t in [0, maxDistance], given 1 / direction.
+    // Returns the entry distance, or a negative value on a miss.
+    float Intersect(const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance) const
+    {
+        glm::vec3 t0 = (min - origin) * inverseDirection;
+        glm::vec3 t1 = (max - origin) * inverseDirection;
+        glm::vec3 entries = glm::min(t0, t1), exits = glm::max(t0, t1);
+        float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+        float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+        return enter <= exit ? enter : -1.0f;
+    }
+};
+
+// The six planes of a view frustum, normalized and facing inwards: a point p is inside when
+// dot(plane.xyz, p) + plane.w >= 0 for every plane. Extracted from projection * view, so
+// perspective and orthographic cameras are handled the same way.
+struct Frustum
+{
+    glm::vec4 planes[6]; // Left, right, bottom, top, near, far
+
+    static Frustum FromMatrix(const glm::mat4 &projectionView);
+};
+
+// World-space bounds of many objects in structure-of-arrays layout, so the culling loop can test
+// four objects per SSE instruction. Each object has a bounding sphere and an axis-aligned box
+// sharing the same center.
+struct CullingBounds
+{
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> radius;
+    std::vector<float> extentX, extentY, extentZ; // Box half sizes
+
+    size_t Size() const { return radius.size(); }
+    void Clear();
+    void Reserve(size_t count);
+
+    // Appends object-space bounds (a box and a sphere of 'objectRadius' around its center) transformed by 'model'
+    void Add(const glm::mat4 &model, const Aabb &objectBounds, float objectRadius);
+};
+
+namespace Culling
+{
+    // Writes 1 to visible[i] when object i intersects the frustum and 0 when it is certainly outside.
+    // An object is rejected when its sphere or its box lies entirely behind one of the planes.
+    // Returns the number of visible objects.
+    size_t Cull(const Frustum &frustum, const CullingBounds &bounds, uint8_t *visible);
+}
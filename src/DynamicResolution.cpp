@@ -0,0 +1,44 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Weight of the newest frame in the smoothed time
+    const float SMOOTHING = 0.1f;
+}
+
+bool DynamicResolution::Update(float frameMs)
+{
+    if (!(frameMs > 0.0f) || !(targetMs > 0.0f))
+        return false;
+    smoothedMs = smoothedMs > 0.0f ? smoothedMs + (frameMs - smoothedMs) * SMOOTHING : frameMs;
+    if (++framesSinceChange < SETTLE_FRAMES)
+        return false;
+
+    float next = scale;
+    if (smoothedMs > targetMs)
+        next = scale * std::sqrt(targetMs / smoothedMs);
+    else if (smoothedMs < targetMs * HEADROOM)
+        next = std::min(scale * std::sqrt(targetMs * HEADROOM / smoothedMs), scale + SCALE_STEP_UP);
+
+    // Whole steps, rounded down: a drop lands under budget in one change
+    next = std::floor(next / SCALE_STEP + 1e-3f) * SCALE_STEP;
+    next = std::clamp(next, MIN_SCALE, MAX_SCALE);
+    if (next == scale)
+        return false;
+
+    // Expect the new pixel count to be reflected in the time straight away; the next
+    // measurements correct it
+    smoothedMs *= (next * next) / (scale * scale);
+    scale = next;
+    framesSinceChange = 0;
+    return true;
+}
+
+void DynamicResolution::Reset(float newScale)
+{
+    scale = std::clamp(newScale, MIN_SCALE, MAX_SCALE);
+    smoothedMs = 0.0f;
+    framesSinceChange = 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// Frame-time controller for dynamic resolution.
+//
+// Fed the GPU time of every frame, it picks the fraction of the window size (per dimension) the
+// deferred passes render at, between MIN_SCALE and MAX_SCALE. The cost of those passes is assumed
+// to follow the pixel count, so the scale that fits 'targetMs' is the current one times
+// sqrt(target / measured). Measurements are smoothed, the scale drops to that estimate at once but
+// grows at most SCALE_STEP_UP per change and only once the frame is below HEADROOM of the budget,
+// and every change waits SETTLE_FRAMES, so the resolution does not oscillate around the budget.
+class DynamicResolution
+{
+public:
+    static constexpr float MIN_SCALE = 0.5f;
+    static constexpr float MAX_SCALE = 1.0f;
+    static constexpr float SCALE_STEP = 1.0f / 32.0f; // Scales are multiples of this
+    static constexpr float SCALE_STEP_UP = 0.1f;
+    static constexpr float HEADROOM = 0.85f;
+    static constexpr int SETTLE_FRAMES = 10;
+
+    float targetMs = 16.0f;
+
+    // Adds one frame's time in milliseconds; returns whether the scale changed
+    bool Update(float frameMs);
+    // Starts over at 'scale', forgetting the measurements
+    void Reset(float scale = MAX_SCALE);
+
+    float GetScale() const { return scale; }
+    // Smoothed frame time, rescaled to the current scale after each change
+    float GetSmoothedMs() const { return smoothedMs; }
+
+private:
+    float scale = MAX_SCALE;
+    float smoothedMs = 0.0f;
+    int framesSinceChange = 0;
+};
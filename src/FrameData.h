@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// CPU mirror of the std140 'FrameData' uniform block declared in phong, gbuffer and lighting_pass.
+// Filled once per frame by Scene and bound to FRAME_DATA_BINDING, so camera, fog and light state
+// costs a single buffer update instead of one uniform call per field, light and object.
+// Every member is a vec4/mat4, so the C++ layout matches std140 without manual padding.
+
+const unsigned int FRAME_DATA_BINDING = 0;
+const int MAX_FRAME_LIGHTS = 8; // Must match MAX_LIGHTS in the shaders
+
+// One light, in view space
+struct GpuLight
+{
+    glm::vec4 positionType;     // xyz position, w = LightType
+    glm::vec4 directionCutOff;  // xyz direction, w = cos(inner cone angle)
+    glm::vec4 colorOuterCutOff; // rgb color, w = cos(outer cone angle)
+    glm::vec4 attenuation;      // x constant, y linear, z quadratic, w range (see AttenuationRange)
+};
+
+struct FrameData
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 inverseProjection; // Reconstructs view-space positions from the G-buffer depth
+    glm::vec4 fogColor;    // rgb color
+    glm::vec4 fogParams;   // x start, y end, z enabled (0/1)
+    glm::ivec4 lightCount; // x = valid entries in 'lights'; y, z, w = directional, point, spot counts
+    // Grouped by type in that order, so specialized shaders can loop over each type separately
+    GpuLight lights[MAX_FRAME_LIGHTS];
+};
+
+static_assert(sizeof(GpuLight) == 64, "GpuLight must match the std140 layout");
+static_assert(sizeof(FrameData) == 3 * 64 + 3 * 16 + MAX_FRAME_LIGHTS * 64, "FrameData must match the std140 layout");
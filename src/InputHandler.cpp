@@ -136,4 +136,11 @@ void InputHandler::ScrollCallback(GLFWwindow *window, double xoffset, double yof
 void InputHandler::FramebufferSizeCallback(GLFWwindow *window, int width, int height)
 {
     glViewport(0, 0, width, height);
+
+    // The render targets follow the window size
+    InputHandler *handler = static_cast<InputHandler *>(glfwGetWindowUserPointer(window));
+    if (handler)
+    {
+        handler->scene->Resize(width, height);
+    }
 }
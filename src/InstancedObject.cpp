@@ -0,0 +1,154 @@
+#include "InstancedObject.h"
+#include "Culling.h"
+#include "RenderState.h"
+#include <algorithm>
+#include <cstddef>
+
+namespace
+{
+    const UniformId UNIFORM_INSTANCED = Shader::Uniform("instanced");
+
+    const GLuint INSTANCE_TRANSFORM_LOCATION = 4; // mat4 takes 4-7
+    const GLuint INSTANCE_COLOR_LOCATION = 8;
+
+    // Dirty ranges closer than this are uploaded as one; a few unchanged instances cost less than a call
+    const size_t MERGE_GAP = 64;
+}
+
+InstancedObject::InstancedObject(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices)
+    : SceneObject(vertices, indices), meshMin(boundsMin), meshMax(boundsMax)
+{
+    glGenBuffers(1, &instanceVBO);
+
+    RenderState::BindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (GLuint column = 0; column < 4; ++column)
+    {
+        GLuint location = INSTANCE_TRANSFORM_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void *)(offsetof(InstanceData, transform) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+    glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+    glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                          (void *)offsetof(InstanceData, color));
+    glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+    RenderState::BindVertexArray(0);
+}
+
+InstancedObject::~InstancedObject()
+{
+    glDeleteBuffers(1, &instanceVBO);
+}
+
+size_t InstancedObject::AddInstance(const glm::mat4 &transform, const glm::vec4 &color)
+{
+    instances.push_back({transform, color});
+    MarkDirty(instances.size() - 1);
+    GrowBounds(transform);
+    return instances.size() - 1;
+}
+
+void InstancedObject::SetInstance(size_t index, const InstanceData &instance)
+{
+    instances[index] = instance;
+    MarkDirty(index);
+    GrowBounds(instance.transform);
+}
+
+void InstancedObject::SetInstanceTransform(size_t index, const glm::mat4 &transform)
+{
+    instances[index].transform = transform;
+    MarkDirty(index);
+    GrowBounds(transform);
+}
+
+void InstancedObject::SetInstanceColor(size_t index, const glm::vec4 &color)
+{
+    instances[index].color = color;
+    MarkDirty(index);
+}
+
+void InstancedObject::MarkDirty(size_t index)
+{
+    // Consecutive updates (the common case) extend the last range instead of adding one
+    if (!dirtyRanges.empty() && index >= dirtyRanges.back().first && index <= dirtyRanges.back().second)
+    {
+        dirtyRanges.back().second = std::max(dirtyRanges.back().second, index + 1);
+        return;
+    }
+    dirtyRanges.push_back({index, index + 1});
+}
+
+void InstancedObject::GrowBounds(const glm::mat4 &transform)
+{
+    Aabb instanceBounds = Aabb{meshMin, meshMax}.Transformed(transform);
+    if (hasInstanceBounds)
+        instanceBounds = Aabb::Union(instanceBounds, {boundsMin, boundsMax});
+    SetBounds(instanceBounds.min, instanceBounds.max);
+    hasInstanceBounds = true;
+}
+
+void InstancedObject::RecomputeBounds()
+{
+    hasInstanceBounds = false;
+    // Without instances the box goes back to the mesh's own, as before the first AddInstance
+    if (instances.empty())
+        SetBounds(meshMin, meshMax);
+    for (const InstanceData &instance : instances)
+        GrowBounds(instance.transform);
+}
+
+void InstancedObject::UploadInstances()
+{
+    lastUploadCount = 0;
+    if (dirtyRanges.empty())
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if (instances.size() > capacity)
+    {
+        // Reallocate with headroom and upload everything
+        capacity = std::max(instances.size(), capacity * 2);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), instances.data());
+        lastUploadCount = instances.size();
+        dirtyRanges.clear();
+        return;
+    }
+
+    std::sort(dirtyRanges.begin(), dirtyRanges.end());
+    size_t first = dirtyRanges[0].first, last = dirtyRanges[0].second;
+    auto upload = [&]()
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(InstanceData), (last - first) * sizeof(InstanceData), &instances[first]);
+        lastUploadCount += last - first;
+    };
+    for (size_t i = 1; i < dirtyRanges.size(); ++i)
+    {
+        if (dirtyRanges[i].first <= last + MERGE_GAP)
+        {
+            last = std::max(last, dirtyRanges[i].second);
+            continue;
+        }
+        upload();
+        first = dirtyRanges[i].first;
+        last = dirtyRanges[i].second;
+    }
+    upload();
+    dirtyRanges.clear();
+}
+
+void InstancedObject::Draw(const Shader &shader, const glm::mat4 &model, int lod)
+{
+    UploadInstances();
+    if (instances.empty())
+        return;
+
+    SetDrawState(shader, model);
+    shader.setBool(UNIFORM_INSTANCED, true);
+    DrawElements(lod, (GLsizei)instances.size());
+    // Other objects drawn with this program expect the default
+    shader.setBool(UNIFORM_INSTANCED, false);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include "Shape.h"
+
+// Per-instance vertex data, read by the shaders at attribute locations 4-7 (transform) and 8 (color)
+struct InstanceData
+{
+    glm::mat4 transform = glm::mat4(1.0f); // Applied before the object's own model matrix
+    glm::vec4 color = glm::vec4(1.0f);     // Replaces the vertex color
+};
+
+// One mesh drawn many times with a single glDrawElementsInstanced. Instance transforms and colors
+// live in a vertex buffer with divisor 1, so no per-instance uniforms or draw calls are needed.
+// Changes are tracked as dirty ranges and only those ranges are uploaded on the next draw.
+// The object's bounds cover every instance, so culling and the BVH treat the batch as one object.
+class InstancedObject : public SceneObject
+{
+public:
+    InstancedObject(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices);
+    ~InstancedObject() override;
+
+    using SceneObject::Draw;
+    void Draw(const Shader &shader, const glm::mat4 &model, int lod = 0) override;
+
+    // Returns the index of the new instance
+    size_t AddInstance(const glm::mat4 &transform, const glm::vec4 &color = glm::vec4(1.0f));
+    void SetInstance(size_t index, const InstanceData &instance);
+    void SetInstanceTransform(size_t index, const glm::mat4 &transform);
+    void SetInstanceColor(size_t index, const glm::vec4 &color);
+    const InstanceData &GetInstance(size_t index) const { return instances[index]; }
+    size_t GetInstanceCount() const { return instances.size(); }
+
+    // Bounds only grow as instances move; this shrinks them back to the current instances
+    void RecomputeBounds();
+
+    // Instances uploaded by the last draw (statistics)
+    size_t GetLastUploadCount() const { return lastUploadCount; }
+
+private:
+    std::vector<InstanceData> instances;
+    unsigned int instanceVBO = 0;
+    size_t capacity = 0; // Instances the GPU buffer can hold
+
+    // Half-open [first, last) ranges changed since the last upload
+    std::vector<std::pair<size_t, size_t>> dirtyRanges;
+    size_t lastUploadCount = 0;
+
+    // Object-space bounds of the mesh itself
+    glm::vec3 meshMin, meshMax;
+    bool hasInstanceBounds = false;
+
+    void MarkDirty(size_t index);
+    void GrowBounds(const glm::mat4 &transform);
+    void UploadInstances();
+};
@@ -1,4 +1,18 @@
 #include "Light.h"
+#include <algorithm>
+#include <cmath>
+
+float AttenuationRange(const glm::vec3 &color, float constant, float linear, float quadratic)
+{
+  // Solve quadratic * d^2 + linear * d + constant = brightness / cutoff for the positive root
+  float target = std::max({color.r, color.g, color.b}) / LIGHT_ATTENUATION_CUTOFF;
+  float c = constant - target;
+  if (c >= 0.0f)
+    return 0.0f; // Never bright enough to matter
+  if (quadratic <= 0.0f)
+    return linear > 0.0f ? -c / linear : INFINITY;
+  return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+}
 
 // Base Light
 Light::Light(glm::vec3 col) : color(col) {}
@@ -9,23 +23,14 @@ DirectionalLight::DirectionalLight(glm::vec3 dir, glm::vec3 col)
 {
 }
 
-void DirectionalLight::SetUniforms(Shader &shader, int index)
-{
-  std::string base = "lights[" + std::to_string(index) + "]";
-  shader.setInt(base + ".type", 0); // DIRECTIONAL
-  shader.setVec3(base + ".direction", direction);
-  shader.setVec3(base + ".color", color);
-  // Placeholder values for struct completeness in shader (if needed by some drivers, although conditional check should cover)
-}
-
-void DirectionalLight::SetUniformsViewSpace(Shader &shader, int index, const glm::mat4 &view)
+void DirectionalLight::WriteViewSpace(GpuLight &out, const glm::mat4 &view) const
 {
-  std::string base = "lights[" + std::to_string(index) + "]";
-  shader.setInt(base + ".type", 0);
   // Transform direction to view space (ignore translation)
   glm::vec3 viewDir = glm::mat3(view) * direction;
-  shader.setVec3(base + ".direction", viewDir);
-  shader.setVec3(base + ".color", color);
+  out.positionType = glm::vec4(0.0f, 0.0f, 0.0f, (float)LightType::DIRECTIONAL);
+  out.directionCutOff = glm::vec4(viewDir, 0.0f);
+  out.colorOuterCutOff = glm::vec4(color, 0.0f);
+  out.attenuation = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
 }
 
 // Point Light
@@ -34,28 +39,14 @@ PointLight::PointLight(glm::vec3 pos, glm::vec3 col)
 {
 }
 
-void PointLight::SetUniforms(Shader &shader, int index)
+void PointLight::WriteViewSpace(GpuLight &out, const glm::mat4 &view) const
 {
-  std::string base = "lights[" + std::to_string(index) + "]";
-  shader.setInt(base + ".type", 1); // POINT
-  shader.setVec3(base + ".position", position);
-  shader.setVec3(base + ".color", color);
-  shader.setFloat(base + ".constant", constant);
-  shader.setFloat(base + ".linear", linear);
-  shader.setFloat(base + ".quadratic", quadratic);
-}
-
-void PointLight::SetUniformsViewSpace(Shader &shader, int index, const glm::mat4 &view)
-{
-  std::string base = "lights[" + std::to_string(index) + "]";
-  shader.setInt(base + ".type", 1);
   // Transform position to view space
   glm::vec3 viewPos = glm::vec3(view * glm::vec4(position, 1.0f));
-  shader.setVec3(base + ".position", viewPos);
-  shader.setVec3(base + ".color", color);
-  shader.setFloat(base + ".constant", constant);
-  shader.setFloat(base + ".linear", linear);
-  shader.setFloat(base + ".quadratic", quadratic);
+  out.positionType = glm::vec4(viewPos, (float)LightType::POINT);
+  out.directionCutOff = glm::vec4(0.0f);
+  out.colorOuterCutOff = glm::vec4(color, 0.0f);
+  out.attenuation = glm::vec4(constant, linear, quadratic, GetRange());
 }
 
 // Spot Light
@@ -66,33 +57,13 @@ SpotLight::SpotLight(glm::vec3 pos, glm::vec3 dir, glm::vec3 col)
 {
 }
 
-void SpotLight::SetUniformsViewSpace(Shader &shader, int index, const glm::mat4 &view)
+void SpotLight::WriteViewSpace(GpuLight &out, const glm::mat4 &view) const
 {
-  std::string base = "lights[" + std::to_string(index) + "]";
-  shader.setInt(base + ".type", 2);
   // Transform position and direction
   glm::vec3 viewPos = glm::vec3(view * glm::vec4(position, 1.0f));
   glm::vec3 viewDir = glm::mat3(view) * direction;
-
-  shader.setVec3(base + ".position", viewPos);
-  shader.setVec3(base + ".direction", viewDir);
-  shader.setVec3(base + ".color", color);
-  shader.setFloat(base + ".constant", constant);
-  shader.setFloat(base + ".linear", linear);
-  shader.setFloat(base + ".quadratic", quadratic);
-  shader.setFloat(base + ".cutOff", cutOff);
-  shader.setFloat(base + ".outerCutOff", outerCutOff);
-}
-void SpotLight::SetUniforms(Shader &shader, int index)
-{
-  std::string base = "lights[" + std::to_string(index) + "]";
-  shader.setInt(base + ".type", 2); // SPOT
-  shader.setVec3(base + ".position", position);
-  shader.setVec3(base + ".direction", direction);
-  shader.setVec3(base + ".color", color);
-  shader.setFloat(base + ".constant", constant);
-  shader.setFloat(base + ".linear", linear);
-  shader.setFloat(base + ".quadratic", quadratic);
-  shader.setFloat(base + ".cutOff", cutOff);
-  shader.setFloat(base + ".outerCutOff", outerCutOff);
+  out.positionType = glm::vec4(viewPos, (float)LightType::SPOT);
+  out.directionCutOff = glm::vec4(viewDir, cutOff);
+  out.colorOuterCutOff = glm::vec4(color, outerCutOff);
+  out.attenuation = glm::vec4(constant, linear, quadratic, GetRange());
 }
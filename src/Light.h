@@ -1,6 +1,16 @@
 #pragma once
 #include <glm/glm.hpp>
-#include "Shader.h"
+#include "FrameData.h"
+
+// Fraction of a light's brightest channel below which its contribution is treated as zero.
+// Bounds the reach of point and spot lights for clustered shading (see LightClusters).
+const float LIGHT_ATTENUATION_CUTOFF = 1.0f / 256.0f;
+
+// Distance at which color / (constant + linear * d + quadratic * d^2) falls to the cutoff
+float AttenuationRange(const glm::vec3 &color, float constant, float linear, float quadratic);
+
+// Cap on light ranges for culling and light volumes: unbounded attenuation still ends somewhere past the far plane
+inline float MaxLightRange(float farPlane) { return 4.0f * farPlane; }
 
 enum class LightType
 {
@@ -15,8 +25,9 @@ public:
     Light(glm::vec3 color);
     virtual ~Light() = default;
 
-    virtual void SetUniforms(Shader &shader, int index) = 0;
-    virtual void SetUniformsViewSpace(Shader &shader, int index, const glm::mat4 &view) = 0;
+    // Packs the light into its FrameData slot with position and direction in view space
+    virtual void WriteViewSpace(GpuLight &out, const glm::mat4 &view) const = 0;
+    virtual LightType GetType() const = 0;
 
     glm::vec3 color;
 };
@@ -25,8 +36,8 @@ class DirectionalLight : public Light
 {
 public:
     DirectionalLight(glm::vec3 direction, glm::vec3 color);
-    void SetUniforms(Shader &shader, int index) override;
-    void SetUniformsViewSpace(Shader &shader, int index, const glm::mat4 &view) override;
+    void WriteViewSpace(GpuLight &out, const glm::mat4 &view) const override;
+    LightType GetType() const override { return LightType::DIRECTIONAL; }
 
     glm::vec3 direction;
 };
@@ -35,8 +46,9 @@ class PointLight : public Light
 {
 public:
     PointLight(glm::vec3 position, glm::vec3 color);
-    void SetUniforms(Shader &shader, int index) override;
-    void SetUniformsViewSpace(Shader &shader, int index, const glm::mat4 &view) override;
+    void WriteViewSpace(GpuLight &out, const glm::mat4 &view) const override;
+    LightType GetType() const override { return LightType::POINT; }
+    float GetRange() const { return AttenuationRange(color, constant, linear, quadratic); }
 
     glm::vec3 position;
     // Attenuation
@@ -49,8 +61,9 @@ class SpotLight : public Light
 {
 public:
     SpotLight(glm::vec3 position, glm::vec3 direction, glm::vec3 color);
-    void SetUniformsViewSpace(Shader &shader, int index, const glm::mat4 &view) override;
-    void SetUniforms(Shader &shader, int index) override;
+    void WriteViewSpace(GpuLight &out, const glm::mat4 &view) const override;
+    LightType GetType() const override { return LightType::SPOT; }
+    float GetRange() const { return AttenuationRange(color, constant, linear, quadratic); }
 
     glm::vec3 position;
     glm::vec3 direction;
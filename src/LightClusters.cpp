@@ -0,0 +1,250 @@
+#include "LightClusters.h"
+#include "Light.h"
+#include "RenderState.h"
+#include "ThreadPool.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Lights per task of the per-light pass
+    const size_t LIGHT_CHUNK_SIZE = 512;
+
+    bool SphereOverlaps(const LightClusters::LightBounds &sphere, const Aabb &box)
+    {
+        glm::vec3 offset = sphere.center - glm::clamp(sphere.center, box.min, box.max);
+        return glm::dot(offset, offset) <= sphere.radius * sphere.radius;
+    }
+
+    // Smallest sphere around a cone of the given length and half-angle cosine, apex at 'position'
+    LightClusters::LightBounds ConeBounds(const glm::vec3 &position, const glm::vec3 &direction, float length, float cosAngle)
+    {
+        if (cosAngle >= 0.70710678f)
+        {
+            // Narrow: the sphere through the apex and the rim of the base
+            float radius = length / (2.0f * cosAngle);
+            return {position + direction * radius, radius};
+        }
+        // Wide: the circle of the base
+        float sinAngle = std::sqrt(std::max(0.0f, 1.0f - cosAngle * cosAngle));
+        return {position + direction * (length * cosAngle), length * sinAngle};
+    }
+}
+
+LightClusters::~LightClusters()
+{
+    if (!buffers[0])
+        return;
+    for (unsigned int texture : textures)
+        RenderState::OnDeleteTexture(texture);
+    glDeleteTextures(3, textures);
+    glDeleteBuffers(3, buffers);
+}
+
+void LightClusters::Build(const std::vector<Light *> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                          float nearPlane, float farPlane)
+{
+    gpuLights.clear();
+    std::vector<LightBounds> bounds;
+    bounds.reserve(std::min(lights.size(), (size_t)MAX_LIGHTS));
+    for (const Light *light : lights)
+    {
+        if (gpuLights.size() == MAX_LIGHTS)
+            break;
+        LightType type = light->GetType();
+        if (type == LightType::DIRECTIONAL)
+            continue;
+
+        gpuLights.emplace_back();
+        GpuLight &packed = gpuLights.back();
+        light->WriteViewSpace(packed, view);
+        glm::vec3 position = glm::vec3(packed.positionType);
+        float range = std::min(packed.attenuation.w, MaxLightRange(farPlane));
+        if (type == LightType::POINT)
+        {
+            bounds.push_back({position, range});
+        }
+        else
+        {
+            const SpotLight *spot = static_cast<const SpotLight *>(light);
+            glm::vec3 direction = glm::normalize(glm::vec3(packed.directionCutOff));
+            bounds.push_back(ConeBounds(position, direction, range, std::min(spot->cutOff, spot->outerCutOff)));
+        }
+    }
+    Assign(bounds, projection, nearPlane, farPlane);
+}
+
+void LightClusters::Assign(const std::vector<LightBounds> &bounds, const glm::mat4 &projection, float nearPlane, float farPlane)
+{
+    lightBounds.assign(bounds.begin(), bounds.begin() + std::min(bounds.size(), (size_t)MAX_LIGHTS));
+    const size_t lightCount = lightBounds.size();
+
+    // Screen tiles each light's box projects to; boxes reaching behind the eye cover the whole screen
+    tileRanges.resize(lightCount);
+    size_t chunks = (lightCount + LIGHT_CHUNK_SIZE - 1) / LIGHT_CHUNK_SIZE;
+    ThreadPool::Shared().ParallelFor(chunks, [&](size_t chunk)
+    {
+        size_t end = std::min(lightCount, (chunk + 1) * LIGHT_CHUNK_SIZE);
+        for (size_t i = chunk * LIGHT_CHUNK_SIZE; i < end; ++i)
+        {
+            const LightBounds &light = lightBounds[i];
+            glm::vec2 ndcMin(1.0f), ndcMax(-1.0f);
+            bool wholeScreen = false;
+            for (int corner = 0; corner < 8 && !wholeScreen; ++corner)
+            {
+                glm::vec3 sign((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+                glm::vec4 clip = projection * glm::vec4(light.center + sign * light.radius, 1.0f);
+                if (clip.w <= 1e-4f)
+                {
+                    wholeScreen = true;
+                    break;
+                }
+                glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                ndcMin = glm::min(ndcMin, ndc);
+                ndcMax = glm::max(ndcMax, ndc);
+            }
+            if (wholeScreen)
+            {
+                tileRanges[i] = glm::ivec4(0, TILES_X - 1, 0, TILES_Y - 1);
+                continue;
+            }
+            // Off screen leaves an empty range (min > max)
+            tileRanges[i] = glm::ivec4(std::max(0, (int)std::floor((ndcMin.x * 0.5f + 0.5f) * TILES_X)),
+                                       std::min(TILES_X - 1, (int)std::floor((ndcMax.x * 0.5f + 0.5f) * TILES_X)),
+                                       std::max(0, (int)std::floor((ndcMin.y * 0.5f + 0.5f) * TILES_Y)),
+                                       std::min(TILES_Y - 1, (int)std::floor((ndcMax.y * 0.5f + 0.5f) * TILES_Y)));
+        }
+    });
+
+    // Slice k spans depths nearPlane * (farPlane / nearPlane)^(k / SLICES) up to the next power
+    float logRatio = std::log(farPlane / nearPlane);
+    sliceParams = glm::vec2(SLICES / logRatio, SLICES * std::log(nearPlane) / logRatio);
+    glm::mat4 inverseProjection = glm::inverse(projection);
+
+    clusterBounds.resize(CLUSTER_COUNT);
+    ranges.resize(CLUSTER_COUNT);
+    sliceIndices.resize(SLICES);
+    ThreadPool::Shared().ParallelFor(SLICES, [&](size_t slice)
+    {
+        float sliceNear = nearPlane * std::exp(logRatio * slice / SLICES);
+        float sliceFar = nearPlane * std::exp(logRatio * (slice + 1) / SLICES);
+        ComputeClusterBounds((int)slice, inverseProjection, sliceNear, sliceFar);
+        AssignSlice((int)slice, sliceNear, sliceFar);
+    });
+
+    // Concatenate the per-slice lists; ranges were written relative to their slice
+    indices.clear();
+    maxClusterLights = 0;
+    for (int slice = 0; slice < SLICES; ++slice)
+    {
+        uint32_t offset = (uint32_t)indices.size();
+        for (int cluster = ClusterIndex(0, 0, slice); cluster < ClusterIndex(0, 0, slice + 1); ++cluster)
+        {
+            ranges[cluster].x += offset;
+            maxClusterLights = std::max(maxClusterLights, ranges[cluster].y);
+        }
+        indices.insert(indices.end(), sliceIndices[slice].begin(), sliceIndices[slice].end());
+    }
+}
+
+void LightClusters::ComputeClusterBounds(int slice, const glm::mat4 &inverseProjection, float sliceNear, float sliceFar)
+{
+    // Each tile corner is a ray from the near to the far clip plane, so this works for both projections
+    auto unproject = [&](float x, float y, float z)
+    {
+        glm::vec4 point = inverseProjection * glm::vec4(x, y, z, 1.0f);
+        return glm::vec3(point) / point.w;
+    };
+    for (int y = 0; y < TILES_Y; ++y)
+    {
+        for (int x = 0; x < TILES_X; ++x)
+        {
+            Aabb box{glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+            for (int corner = 0; corner < 4; ++corner)
+            {
+                float ndcX = (float)(x + (corner & 1)) / TILES_X * 2.0f - 1.0f;
+                float ndcY = (float)(y + (corner >> 1)) / TILES_Y * 2.0f - 1.0f;
+                glm::vec3 front = unproject(ndcX, ndcY, -1.0f), back = unproject(ndcX, ndcY, 1.0f);
+                for (float depth : {sliceNear, sliceFar})
+                {
+                    float t = (depth + front.z) / (front.z - back.z);
+                    glm::vec3 point = front + (back - front) * t;
+                    box.min = glm::min(box.min, point);
+                    box.max = glm::max(box.max, point);
+                }
+            }
+            clusterBounds[ClusterIndex(x, y, slice)] = box;
+        }
+    }
+}
+
+void LightClusters::AssignSlice(int slice, float sliceNear, float sliceFar)
+{
+    // Each light reaching this depth range is tested against the clusters of its tiles only; the hits
+    // (tile << 16 | light) are then grouped by cluster with a counting sort
+    const int tileCount = TILES_X * TILES_Y;
+    std::vector<uint32_t> hits;
+    uint32_t counts[TILES_X * TILES_Y + 1] = {};
+    for (size_t i = 0; i < lightBounds.size(); ++i)
+    {
+        const LightBounds &light = lightBounds[i];
+        float depth = -light.center.z;
+        if (depth + light.radius < sliceNear || depth - light.radius > sliceFar)
+            continue;
+        const glm::ivec4 &tiles = tileRanges[i];
+        for (int y = tiles.z; y <= tiles.w; ++y)
+        {
+            for (int x = tiles.x; x <= tiles.y; ++x)
+            {
+                if (!SphereOverlaps(light, clusterBounds[ClusterIndex(x, y, slice)]))
+                    continue;
+                uint32_t tile = (uint32_t)(y * TILES_X + x);
+                hits.push_back(tile << 16 | (uint32_t)i);
+                counts[tile + 1]++;
+            }
+        }
+    }
+
+    for (int tile = 0; tile < tileCount; ++tile)
+    {
+        ranges[ClusterIndex(0, 0, slice) + tile] = glm::uvec2(counts[tile], counts[tile + 1]);
+        counts[tile + 1] += counts[tile];
+    }
+    std::vector<uint16_t> &out = sliceIndices[slice];
+    out.resize(hits.size());
+    for (uint32_t hit : hits)
+        out[counts[hit >> 16]++] = (uint16_t)(hit & 0xFFFF);
+}
+
+void LightClusters::Upload()
+{
+    const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+    const int units[3] = {CLUSTER_LIGHTS_UNIT, CLUSTER_RANGES_UNIT, CLUSTER_INDICES_UNIT};
+    if (!buffers[0])
+    {
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        for (int i = 0; i < 3; ++i)
+        {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+            RenderState::BindTexture(units[i], GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+    }
+
+    const void *data[3] = {gpuLights.data(), ranges.data(), indices.data()};
+    const size_t sizes[3] = {gpuLights.size() * sizeof(GpuLight), ranges.size() * sizeof(glm::uvec2),
+                             indices.size() * sizeof(uint16_t)};
+    for (int i = 0; i < 3; ++i)
+    {
+        // Orphan the previous frame's storage; an empty list still gets a valid buffer
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, std::max(sizes[i], (size_t)16), NULL, GL_STREAM_DRAW);
+        if (sizes[i])
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+        RenderState::BindTexture(units[i], GL_TEXTURE_BUFFER, textures[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
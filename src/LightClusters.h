@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Culling.h"
+#include "FrameData.h"
+
+class Light;
+
+// Texture units the lighting pass reads the cluster buffers from
+const int CLUSTER_LIGHTS_UNIT = 4;
+const int CLUSTER_RANGES_UNIT = 5;
+const int CLUSTER_INDICES_UNIT = 6;
+
+// Clustered light assignment for the deferred lighting pass.
+//
+// The view frustum is split into TILES_X * TILES_Y screen tiles times SLICES depth slices whose
+// thickness grows exponentially with distance, so clusters stay roughly cube-shaped. Every point and
+// spot light is bounded by a view-space sphere reaching as far as its attenuation stays above
+// LIGHT_ATTENUATION_CUTOFF, and is listed in each cluster that sphere touches. Slices are assigned in
+// parallel on the shared thread pool. The lighting pass finds its fragment's cluster from the screen
+// position and view depth and loops over that cluster's list only.
+//
+// The results go to three texture buffers: the lights (four RGBA32F texels each, the GpuLight layout),
+// the (first index, count) of every cluster (RG32UI) and the concatenated light indices (R16UI).
+class LightClusters
+{
+public:
+    // Must match the CLUSTER_* defines in lighting_pass.fs.glsl
+    static const int TILES_X = 16;
+    static const int TILES_Y = 9;
+    static const int SLICES = 24;
+    static const int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+    static const int MAX_LIGHTS = 4096; // Further point and spot lights are ignored
+
+    // View-space bounding sphere of a light
+    struct LightBounds
+    {
+        glm::vec3 center;
+        float radius;
+    };
+
+    LightClusters() = default;
+    ~LightClusters();
+    LightClusters(const LightClusters &) = delete;
+    LightClusters &operator=(const LightClusters &) = delete;
+
+    // Packs the point and spot lights of 'lights' in view space and assigns them to the clusters of the
+    // frustum given by 'projection' and its clip plane distances. Directional lights are skipped.
+    void Build(const std::vector<Light *> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+               float nearPlane, float farPlane);
+    // The assignment step alone, for bounds already in view space
+    void Assign(const std::vector<LightBounds> &bounds, const glm::mat4 &projection, float nearPlane, float farPlane);
+
+    // Sends the last Build to the texture buffers (creating them on first use) and binds them
+    void Upload();
+
+    // slice = log(view depth) * x - y, as the lighting pass computes it
+    glm::vec2 GetSliceParams() const { return sliceParams; }
+
+    // As of the last Build/Assign
+    size_t LightCount() const { return lightBounds.size(); }
+    size_t IndexCount() const { return indices.size(); }
+    uint32_t MaxClusterLights() const { return maxClusterLights; }
+    const std::vector<glm::uvec2> &GetRanges() const { return ranges; }
+    const std::vector<uint16_t> &GetIndices() const { return indices; }
+    const Aabb &GetClusterBounds(int cluster) const { return clusterBounds[cluster]; }
+    static int ClusterIndex(int x, int y, int slice) { return (slice * TILES_Y + y) * TILES_X + x; }
+
+private:
+    std::vector<GpuLight> gpuLights;
+    std::vector<LightBounds> lightBounds;
+    std::vector<glm::ivec4> tileRanges; // Per light: min x, max x, min y, max y tile
+    std::vector<Aabb> clusterBounds;    // View space
+    std::vector<std::vector<uint16_t>> sliceIndices; // Per-slice scratch, concatenated into 'indices'
+    std::vector<glm::uvec2> ranges;
+    std::vector<uint16_t> indices;
+    glm::vec2 sliceParams = glm::vec2(0.0f);
+    uint32_t maxClusterLights = 0;
+
+    unsigned int buffers[3] = {0, 0, 0};
+    unsigned int textures[3] = {0, 0, 0};
+
+    void ComputeClusterBounds(int slice, const glm::mat4 &inverseProjection, float sliceNear, float sliceFar);
+    void AssignSlice(int slice, float sliceNear, float sliceFar);
+};
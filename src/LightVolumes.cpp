@@ -0,0 +1,180 @@
+#include "LightVolumes.h"
+#include "Light.h"
+#include "RenderState.h"
+#include "Shader.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const float PI = 3.14159265f;
+    const int SPHERE_SECTORS = 16;
+    const int SPHERE_STACKS = 8;
+    const int CONE_SEGMENTS = 16;
+
+    const UniformId UNIFORM_FIRST_LIGHT = Shader::Uniform("firstLight");
+    const UniformId UNIFORM_SPOT_VOLUMES = Shader::Uniform("spotVolumes");
+    const UniformId UNIFORM_MAX_RANGE = Shader::Uniform("maxRange");
+
+    // Triangles of a convex mesh, wound counter-clockwise seen from outside
+    struct MeshBuilder
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> indices;
+        glm::vec3 interior;
+
+        unsigned int Add(const glm::vec3 &position)
+        {
+            positions.push_back(position);
+            return (unsigned int)positions.size() - 1;
+        }
+
+        void Triangle(unsigned int a, unsigned int b, unsigned int c)
+        {
+            glm::vec3 normal = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+            glm::vec3 centroid = (positions[a] + positions[b] + positions[c]) / 3.0f;
+            if (glm::dot(normal, centroid - interior) < 0.0f)
+                std::swap(b, c);
+            indices.insert(indices.end(), {a, b, c});
+        }
+    };
+}
+
+LightVolumes::~LightVolumes()
+{
+    for (Mesh *mesh : {&sphere, &cone})
+    {
+        if (!mesh->VAO)
+            continue;
+        RenderState::OnDeleteVertexArray(mesh->VAO);
+        glDeleteVertexArrays(1, &mesh->VAO);
+        glDeleteBuffers(1, &mesh->VBO);
+        glDeleteBuffers(1, &mesh->EBO);
+    }
+    if (lightTexture)
+    {
+        RenderState::OnDeleteTexture(lightTexture);
+        glDeleteTextures(1, &lightTexture);
+        glDeleteBuffers(1, &lightBuffer);
+    }
+}
+
+void LightVolumes::Init()
+{
+    // Unit sphere, pushed out so its flat faces still enclose the radius-1 sphere
+    MeshBuilder sphereMesh{{}, {}, glm::vec3(0.0f)};
+    float sphereScale = 1.0f / (std::cos(PI / SPHERE_SECTORS) * std::cos(PI / (2 * SPHERE_STACKS)));
+    unsigned int top = sphereMesh.Add(glm::vec3(0.0f, sphereScale, 0.0f));
+    unsigned int bottom = sphereMesh.Add(glm::vec3(0.0f, -sphereScale, 0.0f));
+    for (int stack = 1; stack < SPHERE_STACKS; ++stack)
+    {
+        float polar = PI * stack / SPHERE_STACKS;
+        for (int sector = 0; sector < SPHERE_SECTORS; ++sector)
+        {
+            float azimuth = 2.0f * PI * sector / SPHERE_SECTORS;
+            sphereMesh.Add(glm::vec3(std::sin(polar) * std::cos(azimuth), std::cos(polar), std::sin(polar) * std::sin(azimuth)) * sphereScale);
+        }
+    }
+    auto ring = [](int stack, int sector) { return 2u + (unsigned int)((stack - 1) * SPHERE_SECTORS + sector % SPHERE_SECTORS); };
+    for (int sector = 0; sector < SPHERE_SECTORS; ++sector)
+    {
+        sphereMesh.Triangle(top, ring(1, sector), ring(1, sector + 1));
+        sphereMesh.Triangle(bottom, ring(SPHERE_STACKS - 1, sector), ring(SPHERE_STACKS - 1, sector + 1));
+        for (int stack = 1; stack + 1 < SPHERE_STACKS; ++stack)
+        {
+            sphereMesh.Triangle(ring(stack, sector), ring(stack + 1, sector), ring(stack + 1, sector + 1));
+            sphereMesh.Triangle(ring(stack, sector), ring(stack + 1, sector + 1), ring(stack, sector + 1));
+        }
+    }
+
+    // Unit cone: apex at the origin, opening along +z to a base of radius 1 at z = 1 (enclosed likewise)
+    MeshBuilder coneMesh{{}, {}, glm::vec3(0.0f, 0.0f, 0.5f)};
+    float coneScale = 1.0f / std::cos(PI / CONE_SEGMENTS);
+    unsigned int apex = coneMesh.Add(glm::vec3(0.0f));
+    unsigned int baseCenter = coneMesh.Add(glm::vec3(0.0f, 0.0f, 1.0f));
+    for (int segment = 0; segment < CONE_SEGMENTS; ++segment)
+    {
+        float angle = 2.0f * PI * segment / CONE_SEGMENTS;
+        coneMesh.Add(glm::vec3(std::cos(angle) * coneScale, std::sin(angle) * coneScale, 1.0f));
+    }
+    for (int segment = 0; segment < CONE_SEGMENTS; ++segment)
+    {
+        unsigned int a = 2 + segment, b = 2 + (segment + 1) % CONE_SEGMENTS;
+        coneMesh.Triangle(apex, a, b);
+        coneMesh.Triangle(baseCenter, a, b);
+    }
+
+    for (auto [mesh, source] : {std::pair{&sphere, &sphereMesh}, std::pair{&cone, &coneMesh}})
+    {
+        glGenVertexArrays(1, &mesh->VAO);
+        glGenBuffers(1, &mesh->VBO);
+        glGenBuffers(1, &mesh->EBO);
+        RenderState::BindVertexArray(mesh->VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->VBO);
+        glBufferData(GL_ARRAY_BUFFER, source->positions.size() * sizeof(glm::vec3), source->positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, source->indices.size() * sizeof(unsigned int), source->indices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+        mesh->indexCount = (int)source->indices.size();
+    }
+    RenderState::BindVertexArray(0);
+
+    glGenBuffers(1, &lightBuffer);
+    glGenTextures(1, &lightTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(GpuLight), NULL, GL_STREAM_DRAW);
+    RenderState::BindTexture(LIGHT_VOLUME_LIGHTS_UNIT, GL_TEXTURE_BUFFER, lightTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightVolumes::Update(const std::vector<Light *> &lights, const glm::mat4 &view, float farPlane)
+{
+    if (!sphere.VAO)
+        Init();
+
+    maxRange = MaxLightRange(farPlane);
+    gpuLights.clear();
+    for (LightType type : {LightType::POINT, LightType::SPOT})
+    {
+        for (const Light *light : lights)
+        {
+            if (light->GetType() != type)
+                continue;
+            gpuLights.emplace_back();
+            light->WriteViewSpace(gpuLights.back(), view);
+        }
+        if (type == LightType::POINT)
+            pointCount = gpuLights.size();
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max(gpuLights.size(), (size_t)1) * sizeof(GpuLight), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, gpuLights.size() * sizeof(GpuLight), gpuLights.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightVolumes::DrawPointLights(Shader &shader)
+{
+    Draw(shader, sphere, 0, pointCount, false);
+}
+
+void LightVolumes::DrawSpotLights(Shader &shader)
+{
+    Draw(shader, cone, pointCount, gpuLights.size() - pointCount, true);
+}
+
+void LightVolumes::Draw(Shader &shader, const Mesh &mesh, size_t first, size_t count, bool spot)
+{
+    if (count == 0)
+        return;
+    shader.use();
+    shader.setInt(UNIFORM_FIRST_LIGHT, (int)first);
+    shader.setBool(UNIFORM_SPOT_VOLUMES, spot);
+    shader.setFloat(UNIFORM_MAX_RANGE, maxRange);
+    RenderState::BindTexture(LIGHT_VOLUME_LIGHTS_UNIT, GL_TEXTURE_BUFFER, lightTexture);
+    RenderState::BindVertexArray(mesh.VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0, (GLsizei)count);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "FrameData.h"
+
+class Light;
+class Shader;
+
+// Texture unit the light volume program reads its lights from
+const int LIGHT_VOLUME_LIGHTS_UNIT = 4;
+
+// Deferred point and spot lights drawn as their bounding volumes instead of full-screen passes.
+//
+// Each point light is a sphere and each spot light a cone, sized by the light's attenuation range
+// (see AttenuationRange), so only pixels the light can reach run the lighting shader. All lights of
+// a type go in one instanced draw: the vertex shader places the unit mesh from the light's packed
+// data (four RGBA32F texels per light in a texture buffer, points first, then spots).
+//
+// Only back faces are drawn, with a depth test that passes where the G-buffer surface lies in front
+// of them; with depth clamping that also covers the camera being inside a volume. The caller sets
+// blending, depth, stencil and culling state (see Scene::Draw).
+class LightVolumes
+{
+public:
+    LightVolumes() = default;
+    ~LightVolumes();
+    LightVolumes(const LightVolumes &) = delete;
+    LightVolumes &operator=(const LightVolumes &) = delete;
+
+    // Packs the point and spot lights of 'lights' in view space and uploads them. Volumes are capped
+    // at MaxLightRange(farPlane), like the cluster bounds.
+    void Update(const std::vector<Light *> &lights, const glm::mat4 &view, float farPlane);
+    void DrawPointLights(Shader &shader);
+    void DrawSpotLights(Shader &shader);
+
+    size_t PointLightCount() const { return pointCount; }
+    size_t SpotLightCount() const { return gpuLights.size() - pointCount; }
+
+private:
+    struct Mesh
+    {
+        unsigned int VAO = 0, VBO = 0, EBO = 0;
+        int indexCount = 0;
+    };
+    Mesh sphere, cone;
+    unsigned int lightBuffer = 0, lightTexture = 0;
+
+    std::vector<GpuLight> gpuLights;
+    size_t pointCount = 0;
+    float maxRange = 0.0f;
+
+    void Init();
+    void Draw(Shader &shader, const Mesh &mesh, size_t first, size_t count, bool spot);
+};
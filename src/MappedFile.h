@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+// The mapping stays valid until Close() is called or the object is destroyed.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    // Maps 'path' into memory. Returns false if the file cannot be opened or mapped.
+    bool Open(const std::string &path);
+    void Close();
+
+    bool IsOpen() const { return opened; }
+    const char *Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+    bool opened = false;
+
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,280 @@
+#include "MeshArena.h"
+#include "RenderState.h"
+#include <algorithm>
+#include <cstddef> // for offsetof
+#include <iostream>
+
+RangeAllocator::RangeAllocator(uint32_t capacity)
+    : capacity(capacity)
+{
+    if (capacity > 0)
+        freeRanges[0] = capacity;
+}
+
+uint32_t RangeAllocator::Allocate(uint32_t count)
+{
+    if (count == 0)
+        return 0;
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+    {
+        if (it->second < count)
+            continue;
+        uint32_t offset = it->first;
+        uint32_t remaining = it->second - count;
+        freeRanges.erase(it);
+        if (remaining > 0)
+            freeRanges[offset + count] = remaining;
+        used += count;
+        return offset;
+    }
+    return INVALID;
+}
+
+void RangeAllocator::Free(uint32_t offset, uint32_t count)
+{
+    if (count == 0)
+        return;
+    used -= count;
+
+    auto next = freeRanges.lower_bound(offset);
+    // Merge with the preceding range when it ends right here
+    if (next != freeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            offset = prev->first;
+            count += prev->second;
+            freeRanges.erase(prev);
+        }
+    }
+    // And with the following one when it starts right after
+    if (next != freeRanges.end() && offset + count == next->first)
+    {
+        count += next->second;
+        freeRanges.erase(next);
+    }
+    freeRanges[offset] = count;
+}
+
+void RangeAllocator::Grow(uint32_t newCapacity)
+{
+    if (newCapacity <= capacity)
+        return;
+    uint32_t oldCapacity = capacity;
+    capacity = newCapacity;
+    // Freeing the new tail merges it with a free range at the old end
+    used += newCapacity - oldCapacity;
+    Free(oldCapacity, newCapacity - oldCapacity);
+}
+
+MeshArena::MeshArena(uint32_t vertexCapacity, uint32_t indexCapacity)
+    : vertexAllocator(vertexCapacity), indexAllocator(indexCapacity)
+{
+    // baseInstance is what carries the draw id into the instanced attribute, so both are needed
+    multiDrawIndirect = GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &drawIdVBO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCapacity * sizeof(Vertex), NULL, GL_STATIC_DRAW);
+    RenderState::BindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCapacity * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+    SetupVertexArray();
+    RenderState::BindVertexArray(0);
+
+    glGenBuffers(1, &drawDataBuffer);
+    glGenTextures(1, &drawDataTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, drawDataBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, ARENA_DRAW_DATA_TEXELS * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+    RenderState::BindTexture(ARENA_DRAW_DATA_UNIT, GL_TEXTURE_BUFFER, drawDataTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, drawDataBuffer);
+
+    if (multiDrawIndirect)
+        glGenBuffers(1, &indirectBuffer);
+
+    std::cout << "Mesh arena: " << vertexCapacity << " vertices, " << indexCapacity << " indices, "
+              << (multiDrawIndirect ? "multi-draw indirect" : "per-object base vertex draws") << std::endl;
+}
+
+MeshArena::~MeshArena()
+{
+    RenderState::OnDeleteVertexArray(VAO);
+    RenderState::OnDeleteTexture(drawDataTexture);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &drawIdVBO);
+    glDeleteBuffers(1, &drawDataBuffer);
+    glDeleteTextures(1, &drawDataTexture);
+    if (indirectBuffer)
+        glDeleteBuffers(1, &indirectBuffer);
+}
+
+void MeshArena::SetupVertexArray()
+{
+    // Expects the VAO bound
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Position));
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Color));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Normal));
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, TexCoords));
+
+    // Draw id (location 9): one value per instance, so a command's baseInstance selects it.
+    // The fallback path leaves the array disabled and sets the current value per draw instead.
+    if (multiDrawIndirect)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, drawIdVBO);
+        glEnableVertexAttribArray(9);
+        glVertexAttribIPointer(9, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void *)0);
+        glVertexAttribDivisor(9, 1);
+    }
+}
+
+MeshAllocation MeshArena::Add(const Vertex *vertices, uint32_t vertexCount, const unsigned int *indices, uint32_t indexCount)
+{
+    MeshAllocation allocation;
+    allocation.firstVertex = vertexAllocator.Allocate(vertexCount);
+    allocation.firstIndex = indexAllocator.Allocate(indexCount);
+    if (allocation.firstVertex == RangeAllocator::INVALID || allocation.firstIndex == RangeAllocator::INVALID)
+    {
+        // Undo the half that succeeded, double whatever ran out and retry
+        if (allocation.firstVertex != RangeAllocator::INVALID)
+            vertexAllocator.Free(allocation.firstVertex, vertexCount);
+        if (allocation.firstIndex != RangeAllocator::INVALID)
+            indexAllocator.Free(allocation.firstIndex, indexCount);
+
+        uint32_t newVertexCapacity = vertexAllocator.Capacity();
+        while (newVertexCapacity - vertexAllocator.Used() < vertexCount)
+            newVertexCapacity = std::max(newVertexCapacity * 2, 1024u);
+        uint32_t newIndexCapacity = indexAllocator.Capacity();
+        while (newIndexCapacity - indexAllocator.Used() < indexCount)
+            newIndexCapacity = std::max(newIndexCapacity * 2, 1024u);
+        // A fragmented arena may still lack a contiguous range after one doubling
+        if (newVertexCapacity == vertexAllocator.Capacity() && allocation.firstVertex == RangeAllocator::INVALID)
+            newVertexCapacity *= 2;
+        if (newIndexCapacity == indexAllocator.Capacity() && allocation.firstIndex == RangeAllocator::INVALID)
+            newIndexCapacity *= 2;
+        GrowBuffers(newVertexCapacity, newIndexCapacity);
+        return Add(vertices, vertexCount, indices, indexCount);
+    }
+    allocation.vertexCount = vertexCount;
+    allocation.indexCount = indexCount;
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)allocation.firstVertex * sizeof(Vertex), (GLsizeiptr)vertexCount * sizeof(Vertex), vertices);
+    // The element buffer binding is VAO state, so go through our own VAO
+    RenderState::BindVertexArray(VAO);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)allocation.firstIndex * sizeof(unsigned int), (GLsizeiptr)indexCount * sizeof(unsigned int), indices);
+    RenderState::BindVertexArray(0);
+    return allocation;
+}
+
+void MeshArena::Remove(const MeshAllocation &allocation)
+{
+    vertexAllocator.Free(allocation.firstVertex, allocation.vertexCount);
+    indexAllocator.Free(allocation.firstIndex, allocation.indexCount);
+}
+
+void MeshArena::GrowBuffers(uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+    // Copy both buffers into larger ones on the GPU; allocations keep their offsets
+    auto grow = [](unsigned int &buffer, GLsizeiptr oldSize, GLsizeiptr newSize)
+    {
+        unsigned int grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+        glDeleteBuffers(1, &buffer);
+        buffer = grown;
+    };
+    if (vertexCapacity > vertexAllocator.Capacity())
+    {
+        grow(VBO, (GLsizeiptr)vertexAllocator.Capacity() * sizeof(Vertex), (GLsizeiptr)vertexCapacity * sizeof(Vertex));
+        vertexAllocator.Grow(vertexCapacity);
+    }
+    if (indexCapacity > indexAllocator.Capacity())
+    {
+        grow(EBO, (GLsizeiptr)indexAllocator.Capacity() * sizeof(unsigned int), (GLsizeiptr)indexCapacity * sizeof(unsigned int));
+        indexAllocator.Grow(indexCapacity);
+    }
+
+    RenderState::BindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    SetupVertexArray();
+    RenderState::BindVertexArray(0);
+
+    std::cout << "Mesh arena grown to " << vertexCapacity << " vertices, " << indexCapacity << " indices" << std::endl;
+}
+
+void MeshArena::EnsureDrawIds(uint32_t count)
+{
+    if (count <= drawIdCapacity)
+        return;
+    drawIdCapacity = std::max(count, drawIdCapacity * 2);
+    std::vector<uint32_t> ids(drawIdCapacity);
+    for (uint32_t i = 0; i < drawIdCapacity; ++i)
+        ids[i] = i;
+    glBindBuffer(GL_ARRAY_BUFFER, drawIdVBO);
+    glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(uint32_t), ids.data(), GL_STATIC_DRAW);
+}
+
+void MeshArena::Bind() const
+{
+    RenderState::BindVertexArray(VAO);
+}
+
+int MeshArena::DrawBatch(const std::vector<BatchDraw> &draws)
+{
+    if (draws.empty())
+        return 0;
+
+    drawData.resize(draws.size() * ARENA_DRAW_DATA_TEXELS);
+    for (size_t i = 0; i < draws.size(); ++i)
+    {
+        glm::vec4 *texels = &drawData[i * ARENA_DRAW_DATA_TEXELS];
+        for (int column = 0; column < 4; ++column)
+            texels[column] = draws[i].model[column];
+        texels[4] = draws[i].color;
+    }
+    // Orphan, then fill: a batch drawn earlier in the frame may still be reading the old storage
+    glBindBuffer(GL_TEXTURE_BUFFER, drawDataBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, drawData.size() * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, drawData.size() * sizeof(glm::vec4), drawData.data());
+    RenderState::BindTexture(ARENA_DRAW_DATA_UNIT, GL_TEXTURE_BUFFER, drawDataTexture);
+
+    Bind();
+    if (!multiDrawIndirect)
+    {
+        for (size_t i = 0; i < draws.size(); ++i)
+        {
+            glVertexAttribI1ui(9, (GLuint)i);
+            glDrawElementsBaseVertex(GL_TRIANGLES, draws[i].indexCount, GL_UNSIGNED_INT,
+                                     (void *)((size_t)draws[i].firstIndex * sizeof(unsigned int)), draws[i].baseVertex);
+        }
+        return (int)draws.size();
+    }
+
+    EnsureDrawIds((uint32_t)draws.size());
+    commands.resize(draws.size());
+    for (size_t i = 0; i < draws.size(); ++i)
+        commands[i] = {draws[i].indexCount, 1, draws[i].firstIndex, draws[i].baseVertex, (uint32_t)i};
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)0, (GLsizei)commands.size(), 0);
+    return 1;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "Shape.h"
+
+// First-fit allocator over a linear range of elements. Free ranges are kept sorted by offset
+// and merged with their neighbours on release, so fragmentation stays bounded by the live
+// allocations rather than by their history.
+class RangeAllocator
+{
+public:
+    static const uint32_t INVALID = 0xFFFFFFFF;
+
+    explicit RangeAllocator(uint32_t capacity = 0);
+
+    // Returns the offset of 'count' free elements, or INVALID if no free range is large enough
+    uint32_t Allocate(uint32_t count);
+    void Free(uint32_t offset, uint32_t count);
+    // Extends the managed range; the new tail becomes free
+    void Grow(uint32_t newCapacity);
+
+    uint32_t Capacity() const { return capacity; }
+    uint32_t Used() const { return used; }
+
+private:
+    std::map<uint32_t, uint32_t> freeRanges; // Offset -> count
+    uint32_t capacity;
+    uint32_t used = 0;
+};
+
+// Matches the layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand
+{
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+// Per-draw data in the arena's texture buffer: the model matrix columns, then the object color
+// with w = 1 when it replaces the vertex colors. Read by the vertex shaders through 'drawData'.
+const int ARENA_DRAW_DATA_TEXELS = 5;
+const GLuint ARENA_DRAW_DATA_UNIT = 3;
+
+// Shared geometry for many meshes: one vertex buffer, one 32-bit index buffer and one VAO, with
+// meshes sub-allocated inside them. Objects stored here can be drawn in batches that bind the
+// VAO once and fetch their transforms by draw id, either with a single glMultiDrawElementsIndirect
+// (ARB_multi_draw_indirect + ARB_base_instance) or, without those, one glDrawElementsBaseVertex per
+// object with the draw id set as a constant attribute.
+// Uses the full-float Vertex layout; packed and streamed meshes keep their own buffers.
+class MeshArena
+{
+public:
+    MeshArena(uint32_t vertexCapacity = 1 << 18, uint32_t indexCapacity = 1 << 20);
+    ~MeshArena();
+
+    // Reserves space and uploads the mesh. Grows the buffers when full.
+    MeshAllocation Add(const Vertex *vertices, uint32_t vertexCount, const unsigned int *indices, uint32_t indexCount);
+    void Remove(const MeshAllocation &allocation);
+
+    void Bind() const;
+    unsigned int GetVertexArray() const { return VAO; }
+    bool SupportsMultiDrawIndirect() const { return multiDrawIndirect; }
+
+    // One entry per draw of a batch, in draw id order
+    struct BatchDraw
+    {
+        glm::mat4 model;
+        glm::vec4 color;      // w = 1 to replace the vertex colors
+        uint32_t firstIndex;  // Absolute, in the arena index buffer
+        uint32_t indexCount;
+        int32_t baseVertex;   // Absolute, in the arena vertex buffer
+    };
+    // Uploads the per-draw data and issues the whole batch. The bound program must read its
+    // transforms from 'drawData' (the 'arenaDraw' path of the vertex shaders).
+    // Returns the number of GL draw calls used.
+    int DrawBatch(const std::vector<BatchDraw> &draws);
+
+    uint32_t UsedVertices() const { return vertexAllocator.Used(); }
+    uint32_t UsedIndices() const { return indexAllocator.Used(); }
+
+private:
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    RangeAllocator vertexAllocator, indexAllocator;
+    bool multiDrawIndirect = false;
+
+    // Draw id stream (0, 1, 2, ... per instance), indirect commands and per-draw data
+    unsigned int drawIdVBO = 0;
+    uint32_t drawIdCapacity = 0;
+    unsigned int indirectBuffer = 0;
+    unsigned int drawDataBuffer = 0, drawDataTexture = 0;
+    std::vector<glm::vec4> drawData;
+    std::vector<DrawElementsIndirectCommand> commands;
+
+    void SetupVertexArray();
+    void GrowBuffers(uint32_t vertexCapacity, uint32_t indexCapacity);
+    void EnsureDrawIds(uint32_t count);
+};
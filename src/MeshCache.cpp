@@ -0,0 +1,248 @@
+#include "MeshCache.h"
+#include "ModelLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace
+{
+    const char MAGIC[8] = {'G', 'K', 'M', 'E', 'S', 'H', 'B', 'N'};
+    const uint32_t VERSION = 4; // 4: LOD errors are object-space distances
+    const size_t DATA_ALIGNMENT = 16;
+
+    struct MeshCacheHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t vertexStride;
+        uint64_t sourceSize;
+        int64_t sourceMtime;
+        uint64_t contentHash;
+        uint32_t processingFlags;
+        uint32_t pathLength; // Source path bytes follow the header, then the MeshLod and SubMesh arrays
+        uint32_t lodCount;
+        uint32_t subMeshCount;
+        uint64_t vertexCount;
+        uint64_t indexCount;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+    };
+
+    size_t AlignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Whether 'count' elements at 'offset' lie within the file; never multiplies the untrusted count
+    bool FitsInFile(size_t fileSize, uint64_t offset, uint64_t count, size_t elementSize)
+    {
+        return offset <= fileSize && count <= (fileSize - offset) / elementSize;
+    }
+
+    struct SourceKey
+    {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t hash = 0;
+    };
+
+    bool ReadSourceKey(const std::string &sourcePath, SourceKey &key)
+    {
+        std::error_code ec;
+        auto mtime = std::filesystem::last_write_time(sourcePath, ec);
+        if (ec)
+            return false;
+
+        MappedFile source;
+        if (!source.Open(sourcePath))
+            return false;
+
+        key.size = source.Size();
+        key.mtime = (int64_t)mtime.time_since_epoch().count();
+        key.hash = MeshCache::HashBytes(source.Data(), source.Size());
+        return true;
+    }
+}
+
+uint64_t MeshCache::HashBytes(const void *data, size_t size, uint64_t seed)
+{
+    // Word-at-a-time multiply/rotate hash: fast enough to key 100+ MB sources on every load
+    const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+    const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+
+    uint64_t h = seed ^ (size * PRIME1);
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; ++i)
+    {
+        uint64_t w;
+        std::memcpy(&w, p + i * 8, 8);
+        h ^= w * PRIME2;
+        h = ((h << 31) | (h >> 33)) * PRIME1;
+    }
+
+    // Empty input may come with a null pointer, which memcpy must not see even for zero bytes
+    if (size > words * 8)
+    {
+        uint64_t tail = 0;
+        std::memcpy(&tail, p + words * 8, size - words * 8);
+        h ^= tail * PRIME2;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    return h;
+}
+
+std::string MeshCache::CachePath(const std::string &sourcePath)
+{
+    return sourcePath + ".meshbin";
+}
+
+bool MeshCache::Load(const std::string &sourcePath, uint32_t processingFlags, MappedMesh &out)
+{
+    MappedFile file;
+    if (!file.Open(CachePath(sourcePath)) || file.Size() < sizeof(MeshCacheHeader))
+        return false;
+
+    MeshCacheHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.vertexStride != sizeof(Vertex) || header.processingFlags != processingFlags)
+        return false;
+
+    // Bounds-check everything before trusting the offsets. Each count is checked against the bytes left
+    // before it is multiplied, so a corrupt header cannot overflow its way past the checks.
+    size_t fileSize = file.Size();
+    size_t lodOffset = sizeof(header) + header.pathLength;
+    if (!FitsInFile(fileSize, sizeof(header), header.pathLength, 1) ||
+        !FitsInFile(fileSize, lodOffset, header.lodCount, sizeof(MeshLod)))
+        return false;
+    size_t lodBytes = header.lodCount * sizeof(MeshLod);
+    if (!FitsInFile(fileSize, lodOffset + lodBytes, header.subMeshCount, sizeof(SubMesh)) ||
+        header.vertexOffset % DATA_ALIGNMENT != 0 || header.indexOffset % DATA_ALIGNMENT != 0 ||
+        !FitsInFile(fileSize, header.vertexOffset, header.vertexCount, sizeof(Vertex)) ||
+        !FitsInFile(fileSize, header.indexOffset, header.indexCount, sizeof(unsigned int)))
+        return false;
+    size_t subMeshBytes = header.subMeshCount * sizeof(SubMesh);
+
+    std::string storedPath(file.Data() + sizeof(header), header.pathLength);
+    if (storedPath != sourcePath)
+        return false;
+
+    SourceKey key;
+    if (!ReadSourceKey(sourcePath, key) || key.size != header.sourceSize || key.mtime != header.sourceMtime ||
+        key.hash != header.contentHash)
+        return false;
+
+    const char *tables = file.Data() + sizeof(header) + header.pathLength;
+    // The tables follow the path unaligned, so they are copied out; empty vectors have no storage to copy to
+    out.lods.resize(header.lodCount);
+    if (lodBytes > 0)
+        std::memcpy(out.lods.data(), tables, lodBytes);
+    out.subMeshes.resize(header.subMeshCount);
+    if (subMeshBytes > 0)
+        std::memcpy(out.subMeshes.data(), tables + lodBytes, subMeshBytes);
+    for (const MeshLod &lod : out.lods)
+    {
+        if ((uint64_t)lod.indexOffset + lod.indexCount > header.indexCount ||
+            (uint64_t)lod.firstSubMesh + lod.subMeshCount > header.subMeshCount)
+            return false;
+    }
+    for (const SubMesh &subMesh : out.subMeshes)
+    {
+        if ((uint64_t)subMesh.indexOffset + subMesh.indexCount > header.indexCount)
+            return false;
+    }
+
+    // Every index must address a vertex, or a stale entry would send out-of-range indices to the GPU.
+    // Sub-mesh indices are relative to their base vertex, so their ranges are checked with it added.
+    const unsigned int *indices = reinterpret_cast<const unsigned int *>(file.Data() + header.indexOffset);
+    if (header.indexCount > 0 && *std::max_element(indices, indices + header.indexCount) >= header.vertexCount)
+        return false;
+    for (const SubMesh &subMesh : out.subMeshes)
+    {
+        if (subMesh.indexCount == 0)
+            continue;
+        const unsigned int *first = indices + subMesh.indexOffset;
+        if ((uint64_t)*std::max_element(first, first + subMesh.indexCount) + subMesh.baseVertex >= header.vertexCount)
+            return false;
+    }
+
+    out.vertices = reinterpret_cast<const Vertex *>(file.Data() + header.vertexOffset);
+    out.vertexCount = header.vertexCount;
+    out.indices = indices;
+    out.indexCount = header.indexCount;
+    out.file = std::move(file);
+    return true;
+}
+
+bool MeshCache::Store(const std::string &sourcePath, uint32_t processingFlags, const MeshData &mesh)
+{
+    SourceKey key;
+    if (!ReadSourceKey(sourcePath, key))
+        return false;
+
+    MeshCacheHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.vertexStride = sizeof(Vertex);
+    header.sourceSize = key.size;
+    header.sourceMtime = key.mtime;
+    header.contentHash = key.hash;
+    header.processingFlags = processingFlags;
+    header.pathLength = (uint32_t)sourcePath.size();
+    header.lodCount = (uint32_t)mesh.lods.size();
+    header.subMeshCount = (uint32_t)mesh.subMeshes.size();
+    header.vertexCount = mesh.vertices.size();
+    header.indexCount = mesh.indices.size();
+    size_t tableBytes = mesh.lods.size() * sizeof(MeshLod) + mesh.subMeshes.size() * sizeof(SubMesh);
+    header.vertexOffset = AlignUp(sizeof(header) + sourcePath.size() + tableBytes, DATA_ALIGNMENT);
+    header.indexOffset = AlignUp(header.vertexOffset + mesh.vertices.size() * sizeof(Vertex), DATA_ALIGNMENT);
+
+    // Write to a temporary file and rename, so a crash never leaves a truncated entry behind. The name is
+    // unique per store, so concurrent loads of the same model do not write into each other's file.
+    static std::atomic<uint32_t> storeCounter{0};
+    std::string cachePath = CachePath(sourcePath);
+    std::string tempPath = cachePath + "." + std::to_string(storeCounter++) + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cerr << "Failed to write mesh cache: " << tempPath << std::endl;
+            return false;
+        }
+
+        const char padding[DATA_ALIGNMENT] = {};
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(sourcePath.data(), sourcePath.size());
+        out.write(reinterpret_cast<const char *>(mesh.lods.data()), mesh.lods.size() * sizeof(MeshLod));
+        out.write(reinterpret_cast<const char *>(mesh.subMeshes.data()), mesh.subMeshes.size() * sizeof(SubMesh));
+        out.write(padding, header.vertexOffset - sizeof(header) - sourcePath.size() - tableBytes);
+        out.write(reinterpret_cast<const char *>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+        size_t vertexEnd = header.vertexOffset + mesh.vertices.size() * sizeof(Vertex);
+        out.write(padding, header.indexOffset - vertexEnd);
+        out.write(reinterpret_cast<const char *>(mesh.indices.data()), mesh.indices.size() * sizeof(unsigned int));
+        if (!out)
+        {
+            std::cerr << "Failed to write mesh cache: " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec)
+    {
+        std::cerr << "Failed to write mesh cache: " << cachePath << " (" << ec.message() << ")" << std::endl;
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
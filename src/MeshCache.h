@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "Shape.h"
+
+struct MeshData;
+
+// A cached mesh mapped straight from its .meshbin file.
+// Vertices and indices point into the mapping and stay valid while this object lives.
+struct MappedMesh
+{
+    MappedFile file;
+    const Vertex *vertices = nullptr;
+    size_t vertexCount = 0;
+    const unsigned int *indices = nullptr;
+    size_t indexCount = 0;
+    std::vector<MeshLod> lods;
+    std::vector<SubMesh> subMeshes;
+};
+
+// On-disk binary cache of processed meshes, stored next to the source as '<source>.meshbin'.
+// An entry is only used when the source path, size, modification time, content hash
+// and processing flags all match the ones it was written with.
+namespace MeshCache
+{
+    std::string CachePath(const std::string &sourcePath);
+
+    // Maps the cache entry for 'sourcePath' into 'out'. Returns false on a miss or a stale entry.
+    bool Load(const std::string &sourcePath, uint32_t processingFlags, MappedMesh &out);
+
+    // Writes (or replaces) the cache entry for 'sourcePath'. Failures are logged and otherwise ignored.
+    bool Store(const std::string &sourcePath, uint32_t processingFlags, const MeshData &mesh);
+
+    // 64-bit hash of a byte range; used for the source content key
+    uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 0);
+}
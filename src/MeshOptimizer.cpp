@@ -0,0 +1,450 @@
+#include "MeshOptimizer.h"
+#include "ModelLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    // Forsyth scoring parameters (see "Linear-Speed Vertex Cache Optimisation")
+    const int FORSYTH_CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRI_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    float VertexScore(int cachePosition, unsigned int remainingValence)
+    {
+        if (remainingValence == 0)
+            return -1.0f; // No triangles left; never worth picking
+
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+                score = LAST_TRI_SCORE; // Used by the last triangle; fixed score avoids favouring one of the three
+            else
+            {
+                float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+
+        // Boost vertices with few triangles left so lone triangles do not get stranded
+        score += VALENCE_BOOST_SCALE * std::pow((float)remainingValence, -VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    // Vertex -> triangle adjacency in CSR form
+    struct TriangleAdjacency
+    {
+        std::vector<unsigned int> counts;
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> triangles;
+
+        void Build(const unsigned int *indices, size_t indexCount, size_t vertexCount)
+        {
+            counts.assign(vertexCount, 0);
+            offsets.assign(vertexCount, 0);
+            triangles.resize(indexCount);
+
+            for (size_t i = 0; i < indexCount; ++i)
+                counts[indices[i]]++;
+
+            unsigned int offset = 0;
+            for (size_t v = 0; v < vertexCount; ++v)
+            {
+                offsets[v] = offset;
+                offset += counts[v];
+            }
+
+            std::vector<unsigned int> fill(offsets);
+            for (size_t i = 0; i < indexCount; ++i)
+                triangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+        }
+    };
+
+    // FIFO cache simulation shared by the analyzer and the overdraw clusterer
+    struct FifoCache
+    {
+        std::vector<unsigned int> timestamps;
+        unsigned int time;
+        unsigned int size;
+
+        FifoCache(size_t vertexCount, unsigned int cacheSize)
+            : timestamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+        void Flush() { time += size + 1; }
+
+        // Returns true on a miss (vertex gets transformed)
+        bool Access(unsigned int v)
+        {
+            if (time - timestamps[v] > size)
+            {
+                timestamps[v] = time++;
+                return true;
+            }
+            return false;
+        }
+    };
+}
+
+void MeshOptimizer::OptimizeVertexCache(unsigned int *destination, const unsigned int *indices, size_t indexCount, size_t vertexCount)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    TriangleAdjacency adjacency;
+    adjacency.Build(indices, indexCount, vertexCount);
+
+    // Live triangle counts shrink as triangles are emitted
+    std::vector<unsigned int> liveTriangles(adjacency.counts);
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScores[v] = VertexScore(-1, liveTriangles[v]);
+
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+    std::vector<char> emitted(triangleCount, 0);
+
+    // Cache holds up to FORSYTH_CACHE_SIZE entries plus the three just pushed
+    unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+    unsigned int cacheCount = 0;
+
+    size_t inputCursor = 0; // Fallback scan position when the cache offers nothing
+    unsigned int bestTriangle = 0;
+    for (size_t out = 0; out < triangleCount; ++out)
+    {
+        const unsigned int *tri = &indices[bestTriangle * 3];
+        destination[out * 3 + 0] = tri[0];
+        destination[out * 3 + 1] = tri[1];
+        destination[out * 3 + 2] = tri[2];
+        emitted[bestTriangle] = 1;
+
+        // Push the triangle's vertices to the front of the LRU cache
+        unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+        unsigned int newCount = 0;
+        for (int k = 0; k < 3; ++k)
+            newCache[newCount++] = tri[k];
+        for (unsigned int i = 0; i < cacheCount; ++i)
+        {
+            unsigned int v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                newCache[newCount++] = v;
+        }
+
+        // Remove the emitted triangle from its vertices' live lists
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int v = tri[k];
+            unsigned int *list = &adjacency.triangles[adjacency.offsets[v]];
+            unsigned int count = liveTriangles[v];
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                if (list[i] == bestTriangle)
+                {
+                    std::swap(list[i], list[count - 1]);
+                    break;
+                }
+            }
+            liveTriangles[v]--;
+        }
+
+        // Update scores of every vertex that is or was in the cache, then re-score their triangles
+        for (unsigned int i = 0; i < newCount; ++i)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < (unsigned int)FORSYTH_CACHE_SIZE ? (int)i : -1;
+        }
+
+        float bestScore = -1.0f;
+        unsigned int nextTriangle = ~0u;
+        for (unsigned int i = 0; i < newCount; ++i)
+        {
+            unsigned int v = newCache[i];
+            float newScore = VertexScore(cachePosition[v], liveTriangles[v]);
+            float delta = newScore - vertexScores[v];
+            vertexScores[v] = newScore;
+
+            const unsigned int *list = &adjacency.triangles[adjacency.offsets[v]];
+            for (unsigned int j = 0; j < liveTriangles[v]; ++j)
+            {
+                unsigned int t = list[j];
+                triangleScores[t] += delta;
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    nextTriangle = t;
+                }
+            }
+        }
+
+        cacheCount = std::min<unsigned int>(newCount, FORSYTH_CACHE_SIZE);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        if (nextTriangle == ~0u)
+        {
+            // Cache is exhausted: continue with the next triangle in input order
+            while (inputCursor < triangleCount && emitted[inputCursor])
+                ++inputCursor;
+            if (inputCursor == triangleCount)
+                break;
+            nextTriangle = (unsigned int)inputCursor;
+        }
+        bestTriangle = nextTriangle;
+    }
+}
+
+void MeshOptimizer::OptimizeOverdraw(unsigned int *destination, const unsigned int *indices, size_t indexCount,
+                                     const Vertex *vertices, size_t vertexCount, float threshold)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    // 1. Hard boundaries: a triangle that misses the cache on all three vertices starts a new cluster
+    std::vector<unsigned int> clusters;
+    {
+        FifoCache cache(vertexCount, 16);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            int misses = cache.Access(indices[t * 3]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+            if (t == 0 || misses == 3)
+                clusters.push_back((unsigned int)t);
+        }
+    }
+
+    // 2. Soft boundaries: split each hard cluster wherever its running ACMR (cache flushed at every
+    // split, as reordering will do) is already within 'threshold' of the cluster's own ACMR
+    std::vector<unsigned int> softClusters;
+    {
+        FifoCache cache(vertexCount, 16);
+        for (size_t c = 0; c < clusters.size(); ++c)
+        {
+            size_t start = clusters[c];
+            size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+            cache.Flush();
+            unsigned int clusterMisses = 0;
+            for (size_t t = start; t < end; ++t)
+                clusterMisses += cache.Access(indices[t * 3]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+            float clusterThreshold = threshold * (float)clusterMisses / (float)(end - start);
+
+            softClusters.push_back((unsigned int)start);
+            cache.Flush();
+            unsigned int runningMisses = 0, runningTriangles = 0;
+            for (size_t t = start; t < end; ++t)
+            {
+                runningMisses += cache.Access(indices[t * 3]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+                runningTriangles++;
+                if ((float)runningMisses / runningTriangles <= clusterThreshold)
+                {
+                    softClusters.push_back((unsigned int)(t + 1));
+                    cache.Flush();
+                    runningMisses = runningTriangles = 0;
+                }
+            }
+
+            // Drop an empty trailing split, and merge a short tail (worse ACMR) into the previous cluster
+            if (softClusters.back() == end)
+                softClusters.pop_back();
+            else if (runningTriangles > 0 && softClusters.size() > 1 && softClusters.back() != start)
+                softClusters.pop_back();
+        }
+    }
+
+    // 3. Sort clusters by how far they face away from the mesh center, outermost first
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> clusterCentroid(softClusters.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormal(softClusters.size(), glm::vec3(0.0f));
+    for (size_t c = 0; c < softClusters.size(); ++c)
+    {
+        size_t end = c + 1 < softClusters.size() ? softClusters[c + 1] : triangleCount;
+        float clusterArea = 0.0f;
+        for (size_t t = softClusters[c]; t < end; ++t)
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].Position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &d = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 n = glm::cross(b - a, d - a); // Length is twice the area
+            float area = glm::length(n);
+            clusterCentroid[c] += (a + b + d) * (area / 3.0f);
+            clusterNormal[c] += n;
+            clusterArea += area;
+        }
+        meshCentroid += clusterCentroid[c];
+        meshArea += clusterArea;
+        clusterCentroid[c] = clusterArea > 0.0f ? clusterCentroid[c] / clusterArea : clusterCentroid[c];
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    std::vector<float> sortKey(softClusters.size());
+    for (size_t c = 0; c < softClusters.size(); ++c)
+    {
+        float len = glm::length(clusterNormal[c]);
+        glm::vec3 n = len > 0.0f ? clusterNormal[c] / len : glm::vec3(0.0f);
+        sortKey[c] = glm::dot(clusterCentroid[c] - meshCentroid, n);
+    }
+
+    std::vector<unsigned int> order(softClusters.size());
+    for (size_t c = 0; c < order.size(); ++c)
+        order[c] = (unsigned int)c;
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+                     { return sortKey[a] > sortKey[b]; });
+
+    size_t out = 0;
+    for (unsigned int c : order)
+    {
+        size_t start = softClusters[c];
+        size_t end = c + 1 < softClusters.size() ? softClusters[c + 1] : triangleCount;
+        std::copy(indices + start * 3, indices + end * 3, destination + out);
+        out += (end - start) * 3;
+    }
+}
+
+size_t MeshOptimizer::OptimizeVertexFetch(Vertex *destination, unsigned int *indices, size_t indexCount,
+                                          const Vertex *vertices, size_t vertexCount)
+{
+    std::vector<unsigned int> remap(vertexCount, ~0u);
+    size_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        unsigned int &target = remap[indices[i]];
+        if (target == ~0u)
+        {
+            destination[next] = vertices[indices[i]];
+            target = (unsigned int)next++;
+        }
+        indices[i] = target;
+    }
+    return next;
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const unsigned int *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    if (indexCount < 3)
+        return stats;
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<char> referenced(vertexCount, 0);
+    size_t transformed = 0, unique = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        transformed += cache.Access(indices[i]);
+        if (!referenced[indices[i]])
+        {
+            referenced[indices[i]] = 1;
+            ++unique;
+        }
+    }
+
+    stats.acmr = (float)transformed / (indexCount / 3);
+    stats.atvr = (float)transformed / unique;
+    return stats;
+}
+
+bool MeshOptimizer::PartitionSubMeshes(MeshData &mesh, size_t maxVertices, size_t vertexStride)
+{
+    if (mesh.vertices.size() <= maxVertices || mesh.indices.size() < 3)
+        return false;
+
+    std::vector<MeshLod> lods = mesh.lods;
+    if (lods.empty())
+        lods.push_back({0u, (unsigned int)mesh.indices.size(), 0.0f});
+
+    // Grow each sub-mesh in draw order, copying the vertices it uses into its own contiguous range
+    // (first-use order, so fetch locality is kept), until the next triangle would overflow it
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices(mesh.indices.size());
+    std::vector<SubMesh> subMeshes;
+    std::vector<unsigned int> local(mesh.vertices.size(), ~0u);
+    std::vector<unsigned int> used;
+
+    for (MeshLod &lod : lods)
+    {
+        lod.firstSubMesh = (unsigned int)subMeshes.size();
+        unsigned int start = lod.indexOffset;
+        unsigned int end = lod.indexOffset + lod.indexCount;
+        unsigned int base = (unsigned int)vertices.size();
+
+        auto closeSubMesh = [&](unsigned int next)
+        {
+            if (next > start)
+                subMeshes.push_back({start, next - start, base});
+            for (unsigned int v : used)
+                local[v] = ~0u;
+            used.clear();
+            start = next;
+            base = (unsigned int)vertices.size();
+        };
+
+        for (unsigned int i = start; i < end; i += 3)
+        {
+            const unsigned int *tri = &mesh.indices[i];
+            size_t added = (local[tri[0]] == ~0u) + (local[tri[1]] == ~0u && tri[1] != tri[0]) +
+                           (local[tri[2]] == ~0u && tri[2] != tri[0] && tri[2] != tri[1]);
+            if (vertices.size() - base + added > maxVertices)
+                closeSubMesh(i);
+
+            for (int k = 0; k < 3; ++k)
+            {
+                if (local[tri[k]] == ~0u)
+                {
+                    local[tri[k]] = (unsigned int)(vertices.size() - base);
+                    vertices.push_back(mesh.vertices[tri[k]]);
+                    used.push_back(tri[k]);
+                }
+                indices[i + k] = local[tri[k]];
+            }
+        }
+        closeSubMesh(end);
+        lod.subMeshCount = (unsigned int)subMeshes.size() - lod.firstSubMesh;
+    }
+
+    // Coarse LODs and sub-mesh borders duplicate vertices; only keep the split if it still saves memory
+    size_t before = mesh.vertices.size() * vertexStride + mesh.indices.size() * sizeof(unsigned int);
+    size_t after = vertices.size() * vertexStride + indices.size() * sizeof(uint16_t);
+    if (after >= before)
+        return false;
+
+    mesh.vertices.swap(vertices);
+    mesh.indices.swap(indices);
+    mesh.lods.swap(lods);
+    mesh.subMeshes.swap(subMeshes);
+    return true;
+}
+
+void MeshOptimizer::OptimizeMesh(MeshData &mesh, bool report)
+{
+    if (mesh.indices.size() < 3)
+        return;
+
+    VertexCacheStats before = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+
+    std::vector<unsigned int> cacheOrder(mesh.indices.size());
+    OptimizeVertexCache(cacheOrder.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    VertexCacheStats afterCache = AnalyzeVertexCache(cacheOrder.data(), cacheOrder.size(), mesh.vertices.size());
+
+    OptimizeOverdraw(mesh.indices.data(), cacheOrder.data(), cacheOrder.size(), mesh.vertices.data(), mesh.vertices.size());
+
+    std::vector<Vertex> fetchOrder(mesh.vertices.size());
+    size_t used = OptimizeVertexFetch(fetchOrder.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size());
+    fetchOrder.resize(used);
+    mesh.vertices.swap(fetchOrder);
+
+    if (report)
+    {
+        VertexCacheStats after = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+        std::cout << "Mesh optimized: ACMR " << before.acmr << " -> " << afterCache.acmr << " (cache) -> " << after.acmr
+                  << " (overdraw), ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+    }
+}
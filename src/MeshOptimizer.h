@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include "Shape.h"
+
+struct MeshData;
+
+// Post-transform vertex cache statistics from a FIFO cache simulation.
+struct VertexCacheStats
+{
+    float acmr = 0.0f; // Average cache miss ratio: transformed vertices per triangle (0.5 .. 3)
+    float atvr = 0.0f; // Average transformed vertex ratio: transformed / referenced vertices (1 is ideal)
+};
+
+// Offline mesh optimization passes run on the CPU before the mesh is uploaded.
+// All passes work on triangle lists and keep the rendered result identical.
+namespace MeshOptimizer
+{
+    // Reorders triangles for post-transform vertex cache locality (Forsyth's linear-speed algorithm).
+    // 'destination' and 'indices' may not overlap.
+    void OptimizeVertexCache(unsigned int *destination, const unsigned int *indices, size_t indexCount, size_t vertexCount);
+
+    // Reorders cache-optimized triangles in clusters so outward-facing clusters are drawn first,
+    // reducing overdraw. A cluster split is only kept while the ACMR stays within
+    // 'threshold' times the input ACMR (Tipsify-style soft boundaries).
+    void OptimizeOverdraw(unsigned int *destination, const unsigned int *indices, size_t indexCount,
+                          const Vertex *vertices, size_t vertexCount, float threshold = 1.05f);
+
+    // Rewrites vertices in first-use order and remaps 'indices' in place for linear vertex fetches.
+    // Unreferenced vertices are dropped. Returns the new vertex count.
+    size_t OptimizeVertexFetch(Vertex *destination, unsigned int *indices, size_t indexCount,
+                               const Vertex *vertices, size_t vertexCount);
+
+    VertexCacheStats AnalyzeVertexCache(const unsigned int *indices, size_t indexCount, size_t vertexCount,
+                                        unsigned int cacheSize = 16);
+
+    // Splits every LOD of a mesh with more than 'maxVertices' vertices into sub-meshes of at most
+    // 'maxVertices' vertices each, so their indices (relative to each sub-mesh's base vertex) fit in 16 bits.
+    // Each sub-mesh gets its own vertex range; vertices on sub-mesh borders and those of coarser LODs are
+    // duplicated. Returns false (leaving the mesh untouched) if the mesh is small enough already or the
+    // duplicates would cost more than the smaller indices save, with vertices priced at 'vertexStride',
+    // the size they are uploaded at.
+    bool PartitionSubMeshes(MeshData &mesh, size_t maxVertices = MAX_SHORT_INDEX_VERTICES,
+                            size_t vertexStride = sizeof(Vertex));
+
+    // Runs cache, overdraw and fetch optimization on 'mesh' and optionally logs ACMR/ATVR before and after.
+    void OptimizeMesh(MeshData &mesh, bool report = true);
+}
@@ -0,0 +1,395 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "ModelLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    // Symmetric 4x4 quadric stored as its 10 unique coefficients, plus the total weight of its planes
+    struct Quadric
+    {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0;
+        double c = 0;
+        double weight = 0;
+
+        static Quadric FromPlane(const glm::dvec3 &n, double d, double weight)
+        {
+            Quadric q;
+            q.a00 = weight * n.x * n.x;
+            q.a01 = weight * n.x * n.y;
+            q.a02 = weight * n.x * n.z;
+            q.a11 = weight * n.y * n.y;
+            q.a12 = weight * n.y * n.z;
+            q.a22 = weight * n.z * n.z;
+            q.b0 = weight * n.x * d;
+            q.b1 = weight * n.y * d;
+            q.b2 = weight * n.z * d;
+            q.c = weight * d * d;
+            q.weight = weight;
+            return q;
+        }
+
+        Quadric &operator+=(const Quadric &o)
+        {
+            a00 += o.a00, a01 += o.a01, a02 += o.a02, a11 += o.a11, a12 += o.a12, a22 += o.a22;
+            b0 += o.b0, b1 += o.b1, b2 += o.b2;
+            c += o.c;
+            weight += o.weight;
+            return *this;
+        }
+
+        // Weighted mean of the squared distances from p to the accumulated planes. Dividing by the
+        // weight keeps the result a squared object-space distance whatever the triangle areas.
+        double Error(const glm::vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double r = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                       2.0 * (b0 * x + b1 * y + b2 * z) + c;
+            return r > 0.0 && weight > 0.0 ? r / weight : 0.0;
+        }
+    };
+
+    // Border edges are protected by a steep plane perpendicular to the surface along the edge,
+    // weighted by the squared edge length so it compares with the area of the faces beside it
+    const double BORDER_WEIGHT = 10.0;
+
+    struct Collapse
+    {
+        unsigned int from, to; // Welded vertex ids
+        double cost;
+    };
+
+    // Welds vertices by exact position; returns welded id per vertex and the welded count
+    size_t WeldPositions(const Vertex *vertices, size_t vertexCount, std::vector<unsigned int> &weld)
+    {
+        struct PosHash
+        {
+            size_t operator()(const glm::vec3 &p) const
+            {
+                uint32_t b[3];
+                std::memcpy(b, &p, sizeof(b));
+                return (size_t)((b[0] * 73856093u) ^ (b[1] * 19349663u) ^ (b[2] * 83492791u));
+            }
+        };
+
+        std::unordered_map<glm::vec3, unsigned int, PosHash> firstByPosition;
+        firstByPosition.reserve(vertexCount);
+        weld.resize(vertexCount);
+        size_t count = 0;
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            auto [it, inserted] = firstByPosition.emplace(vertices[v].Position, (unsigned int)count);
+            if (inserted)
+                ++count;
+            weld[v] = it->second;
+        }
+        return count;
+    }
+}
+
+size_t MeshSimplifier::Simplify(unsigned int *destination, const unsigned int *indices, size_t indexCount,
+                                const Vertex *vertices, size_t vertexCount, size_t targetIndexCount, float targetError,
+                                float *resultError)
+{
+    std::vector<unsigned int> weld;
+    size_t weldedCount = WeldPositions(vertices, vertexCount, weld);
+
+    // Position and the original vertices behind every welded id
+    std::vector<glm::vec3> position(weldedCount);
+    std::vector<unsigned int> originalOffsets(weldedCount + 1, 0);
+    std::vector<unsigned int> originals(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        position[weld[v]] = vertices[v].Position;
+        originalOffsets[weld[v] + 1]++;
+    }
+    for (size_t w = 0; w < weldedCount; ++w)
+        originalOffsets[w + 1] += originalOffsets[w];
+    {
+        std::vector<unsigned int> fill(originalOffsets.begin(), originalOffsets.end() - 1);
+        for (size_t v = 0; v < vertexCount; ++v)
+            originals[fill[weld[v]]++] = (unsigned int)v;
+    }
+
+    std::vector<unsigned int> current(indices, indices + indexCount);
+    std::vector<unsigned int> next;
+    next.reserve(indexCount);
+
+    // Face quadrics, area weighted
+    std::vector<Quadric> quadrics(weldedCount);
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        glm::dvec3 p0 = position[weld[current[i]]], p1 = position[weld[current[i + 1]]], p2 = position[weld[current[i + 2]]];
+        glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        double area = glm::length(n);
+        if (area <= 0.0)
+            continue;
+        n /= area;
+        Quadric q = Quadric::FromPlane(n, -glm::dot(n, p0), area * 0.5);
+        for (int k = 0; k < 3; ++k)
+            quadrics[weld[current[i + k]]] += q;
+    }
+
+    double maxError = 0.0;
+    const double errorLimit = (double)targetError * targetError;
+    std::vector<char> touched(weldedCount);
+    std::vector<unsigned int> collapseTo(weldedCount);
+    std::vector<char> isBorder(weldedCount);
+
+    for (int pass = 0; pass < 64 && current.size() > targetIndexCount; ++pass)
+    {
+        size_t triCount = current.size() / 3;
+
+        // Welded edge list; each directed edge once per triangle, sorted so twins are adjacent
+        std::vector<uint64_t> edges;
+        edges.reserve(current.size());
+        for (size_t t = 0; t < triCount; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                unsigned int a = weld[current[t * 3 + k]], b = weld[current[t * 3 + (k + 1) % 3]];
+                uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+                edges.push_back(key);
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        // An edge used by exactly one triangle lies on an open border
+        std::fill(isBorder.begin(), isBorder.end(), 0);
+        std::vector<uint64_t> borderEdges;
+        std::vector<uint64_t> uniqueEdges;
+        for (size_t i = 0; i < edges.size();)
+        {
+            size_t j = i;
+            while (j < edges.size() && edges[j] == edges[i])
+                ++j;
+            uniqueEdges.push_back(edges[i]);
+            if (j - i == 1)
+            {
+                borderEdges.push_back(edges[i]);
+                isBorder[edges[i] >> 32] = 1;
+                isBorder[edges[i] & 0xFFFFFFFFu] = 1;
+            }
+            i = j;
+        }
+
+        if (pass == 0)
+        {
+            // Border quadrics keep open boundaries in place
+            for (size_t t = 0; t < triCount; ++t)
+            {
+                glm::dvec3 p[3];
+                unsigned int w[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    w[k] = weld[current[t * 3 + k]];
+                    p[k] = position[w[k]];
+                }
+                glm::dvec3 faceNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+                if (glm::length(faceNormal) <= 0.0)
+                    continue;
+                faceNormal = glm::normalize(faceNormal);
+                for (int k = 0; k < 3; ++k)
+                {
+                    unsigned int a = w[k], b = w[(k + 1) % 3];
+                    uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+                    if (!std::binary_search(borderEdges.begin(), borderEdges.end(), key))
+                        continue;
+                    glm::dvec3 edge = p[(k + 1) % 3] - p[k];
+                    double length = glm::length(edge);
+                    if (length <= 0.0)
+                        continue;
+                    glm::dvec3 n = glm::normalize(glm::cross(edge, faceNormal));
+                    Quadric q = Quadric::FromPlane(n, -glm::dot(n, p[k]), BORDER_WEIGHT * length * length);
+                    quadrics[a] += q;
+                    quadrics[b] += q;
+                }
+            }
+        }
+
+        // Cheapest allowed direction for every edge
+        std::vector<Collapse> candidates;
+        candidates.reserve(uniqueEdges.size());
+        for (uint64_t key : uniqueEdges)
+        {
+            unsigned int a = (unsigned int)(key >> 32), b = (unsigned int)(key & 0xFFFFFFFFu);
+            if (a == b)
+                continue;
+            bool borderEdge = std::binary_search(borderEdges.begin(), borderEdges.end(), key);
+
+            // Border vertices may only slide along a border edge
+            bool aToB = !isBorder[a] || borderEdge;
+            bool bToA = !isBorder[b] || borderEdge;
+            Quadric q = quadrics[a];
+            q += quadrics[b];
+            double costAB = aToB ? q.Error(position[b]) : 1e300;
+            double costBA = bToA ? q.Error(position[a]) : 1e300;
+            if (!aToB && !bToA)
+                continue;
+            if (costAB <= costBA)
+                candidates.push_back({a, b, costAB});
+            else
+                candidates.push_back({b, a, costBA});
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse &x, const Collapse &y)
+                  { return x.cost < y.cost; });
+
+        // Welded vertex -> triangle adjacency for the flip test
+        std::vector<unsigned int> triOffsets(weldedCount + 1, 0), triList(current.size());
+        for (unsigned int idx : current)
+            triOffsets[weld[idx] + 1]++;
+        for (size_t w = 0; w < weldedCount; ++w)
+            triOffsets[w + 1] += triOffsets[w];
+        {
+            std::vector<unsigned int> fill(triOffsets.begin(), triOffsets.end() - 1);
+            for (size_t i = 0; i < current.size(); ++i)
+                triList[fill[weld[current[i]]]++] = (unsigned int)(i / 3);
+        }
+
+        std::fill(touched.begin(), touched.end(), 0);
+        for (size_t w = 0; w < weldedCount; ++w)
+            collapseTo[w] = (unsigned int)w;
+
+        // Each interior collapse removes two triangles; stop once the target is reached
+        size_t trianglesLeft = triCount;
+        size_t targetTriangles = targetIndexCount / 3;
+        size_t collapses = 0;
+        for (const Collapse &c : candidates)
+        {
+            if (trianglesLeft <= targetTriangles)
+                break;
+            if (c.cost > errorLimit)
+                break;
+            if (touched[c.from] || touched[c.to])
+                continue;
+
+            // Reject collapses that would flip any surviving triangle around 'from'
+            bool flips = false;
+            for (unsigned int i = triOffsets[c.from]; i < triOffsets[c.from + 1] && !flips; ++i)
+            {
+                unsigned int t = triList[i];
+                unsigned int w[3] = {weld[current[t * 3]], weld[current[t * 3 + 1]], weld[current[t * 3 + 2]]};
+                if (w[0] == c.to || w[1] == c.to || w[2] == c.to)
+                    continue;
+                glm::vec3 before = glm::cross(position[w[1]] - position[w[0]], position[w[2]] - position[w[0]]);
+                for (unsigned int &x : w)
+                    if (x == c.from)
+                        x = c.to;
+                glm::vec3 after = glm::cross(position[w[1]] - position[w[0]], position[w[2]] - position[w[0]]);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            // Lock the whole one-ring so no other collapse in this pass invalidates the test
+            for (unsigned int i = triOffsets[c.from]; i < triOffsets[c.from + 1]; ++i)
+            {
+                unsigned int t = triList[i];
+                for (int k = 0; k < 3; ++k)
+                    touched[weld[current[t * 3 + k]]] = 1;
+            }
+            touched[c.to] = 1;
+
+            collapseTo[c.from] = c.to;
+            quadrics[c.to] += quadrics[c.from];
+            maxError = std::max(maxError, c.cost);
+            trianglesLeft -= isBorder[c.from] ? 1 : 2;
+            ++collapses;
+        }
+
+        if (collapses == 0)
+            break;
+
+        // Remap every original vertex whose welded vertex moved to the best-matching original
+        // vertex at the destination, so UV/normal seams survive
+        std::vector<unsigned int> remap(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            unsigned int target = collapseTo[weld[v]];
+            if (target == weld[v])
+            {
+                remap[v] = (unsigned int)v;
+                continue;
+            }
+            unsigned int best = originals[originalOffsets[target]];
+            float bestScore = -1e30f;
+            for (unsigned int i = originalOffsets[target]; i < originalOffsets[target + 1]; ++i)
+            {
+                const Vertex &candidate = vertices[originals[i]];
+                float score = glm::dot(candidate.Normal, vertices[v].Normal) -
+                              glm::length(candidate.TexCoords - vertices[v].TexCoords);
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    best = originals[i];
+                }
+            }
+            remap[v] = best;
+        }
+
+        next.clear();
+        for (size_t t = 0; t < triCount; ++t)
+        {
+            unsigned int v0 = remap[current[t * 3]], v1 = remap[current[t * 3 + 1]], v2 = remap[current[t * 3 + 2]];
+            if (weld[v0] == weld[v1] || weld[v1] == weld[v2] || weld[v0] == weld[v2])
+                continue;
+            next.push_back(v0);
+            next.push_back(v1);
+            next.push_back(v2);
+        }
+        current.swap(next);
+    }
+
+    std::copy(current.begin(), current.end(), destination);
+    if (resultError)
+        *resultError = (float)std::sqrt(maxError);
+    return current.size();
+}
+
+void MeshSimplifier::GenerateLods(MeshData &mesh, int levels, bool optimizeVertexCache)
+{
+    mesh.lods.clear();
+    size_t baseCount = mesh.indices.size();
+    mesh.lods.push_back({0u, (unsigned int)baseCount, 0.0f});
+    if (baseCount < 3 || levels <= 0)
+        return;
+
+    glm::vec3 min, max;
+    ComputeBounds(mesh.vertices.data(), mesh.vertices.size(), min, max);
+    float extent = glm::length(max - min);
+
+    std::vector<unsigned int> source(mesh.indices);
+    std::vector<unsigned int> simplified(baseCount);
+    for (int level = 1; level <= levels; ++level)
+    {
+        size_t target = (source.size() / 2) / 3 * 3;
+        // Allow progressively larger deviation for coarser levels (relative to the mesh size)
+        float maxError = extent * 0.01f * (float)(1 << (level - 1));
+        float error = 0.0f;
+        size_t count = Simplify(simplified.data(), source.data(), source.size(), mesh.vertices.data(),
+                                mesh.vertices.size(), target, maxError, &error);
+
+        // Not worth a level if it barely reduced anything
+        if (count == 0 || count > source.size() * 9 / 10)
+            break;
+
+        if (optimizeVertexCache)
+        {
+            std::vector<unsigned int> ordered(count);
+            MeshOptimizer::OptimizeVertexCache(ordered.data(), simplified.data(), count, mesh.vertices.size());
+            std::copy(ordered.begin(), ordered.end(), simplified.begin());
+        }
+
+        // Each level is simplified from the previous one, so errors accumulate
+        float totalError = mesh.lods.back().error + error;
+        mesh.lods.push_back({(unsigned int)mesh.indices.size(), (unsigned int)count, totalError});
+        mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.begin() + count);
+        source.assign(simplified.begin(), simplified.begin() + count);
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include "Shape.h"
+
+struct MeshData;
+
+// Quadric error metric (Garland-Heckbert) mesh simplification used to build LOD chains.
+// Works on positions only: vertices that share a position (UV/normal seams) are welded for the
+// topology and split again on output, so the simplified mesh reuses the original vertex buffer.
+namespace MeshSimplifier
+{
+    // Writes a simplified index list with at most 'targetIndexCount' indices to 'destination'
+    // (sized for 'indexCount'), stopping early once the next collapse would exceed 'targetError'
+    // (object-space distance). Open borders only collapse along themselves.
+    // Returns the new index count; 'resultError' receives the largest error introduced.
+    size_t Simplify(unsigned int *destination, const unsigned int *indices, size_t indexCount,
+                    const Vertex *vertices, size_t vertexCount, size_t targetIndexCount, float targetError,
+                    float *resultError = nullptr);
+
+    // Appends 'levels' progressively coarser LODs (half the triangles each) to 'mesh.indices'
+    // and fills 'mesh.lods'. LOD 0 is the existing index list.
+    void GenerateLods(MeshData &mesh, int levels, bool optimizeVertexCache);
+}
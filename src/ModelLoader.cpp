@@ -1,138 +1,634 @@
 #include "ModelLoader.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexPacking.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
-#include <map>
-#include <tuple>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
 
-// Helper to split string by delimiter
-std::vector<std::string> split(const std::string &s, char delimiter)
+namespace
 {
-    std::vector<std::string> tokens;
-    std::string token;
-    std::istringstream tokenStream(s);
-    while (std::getline(tokenStream, token, delimiter))
+    // Open-addressing hash table mapping an OBJ corner (posIdx, texIdx, normIdx) to a vertex index.
+    // Linear probing over a power-of-two table; grows when half full.
+    class CornerMap
     {
-        tokens.push_back(token);
+    public:
+        explicit CornerMap(size_t expected)
+        {
+            size_t capacity = 64;
+            while (capacity < expected * 2)
+                capacity <<= 1;
+            slots.assign(capacity, Slot{});
+            mask = capacity - 1;
+        }
+
+        // Returns the stored index for the key, or inserts 'newIndex' and returns it.
+        unsigned int FindOrInsert(int p, int t, int n, unsigned int newIndex, bool &inserted)
+        {
+            if ((count + 1) * 2 > slots.size())
+                Grow();
+
+            size_t i = Hash(p, t, n) & mask;
+            while (true)
+            {
+                Slot &slot = slots[i];
+                if (slot.index == EMPTY)
+                {
+                    slot = {p, t, n, newIndex};
+                    ++count;
+                    inserted = true;
+                    return newIndex;
+                }
+                if (slot.p == p && slot.t == t && slot.n == n)
+                {
+                    inserted = false;
+                    return slot.index;
+                }
+                i = (i + 1) & mask;
+            }
+        }
+
+    private:
+        static constexpr unsigned int EMPTY = 0xFFFFFFFFu;
+
+        struct Slot
+        {
+            int p = 0, t = 0, n = 0;
+            unsigned int index = EMPTY;
+        };
+
+        std::vector<Slot> slots;
+        size_t mask = 0;
+        size_t count = 0;
+
+        static size_t Hash(int p, int t, int n)
+        {
+            uint64_t h = (uint64_t)(uint32_t)p * 0x9E3779B97F4A7C15ull;
+            h ^= (uint64_t)(uint32_t)t * 0xC2B2AE3D27D4EB4Full;
+            h ^= (uint64_t)(uint32_t)n * 0x165667B19E3779F9ull;
+            return (size_t)(h ^ (h >> 29));
+        }
+
+        void Grow()
+        {
+            std::vector<Slot> old;
+            old.swap(slots);
+            slots.assign(old.size() * 2, Slot{});
+            mask = slots.size() - 1;
+            for (const Slot &s : old)
+            {
+                if (s.index == EMPTY)
+                    continue;
+                size_t i = Hash(s.p, s.t, s.n) & mask;
+                while (slots[i].index != EMPTY)
+                    i = (i + 1) & mask;
+                slots[i] = s;
+            }
+        }
+    };
+
+    inline bool IsBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
     }
-    return tokens;
-}
 
-SceneObject *ModelLoader::LoadObj(const std::string &path)
-{
-    std::vector<glm::vec3> temp_positions;
-    std::vector<glm::vec2> temp_texcoords;
-    std::vector<glm::vec3> temp_normals;
+    inline const char *SkipBlanks(const char *p, const char *end)
+    {
+        while (p < end && IsBlank(*p))
+            ++p;
+        return p;
+    }
 
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
+    inline const char *SkipLine(const char *p, const char *end)
+    {
+        const char *nl = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        return nl ? nl + 1 : end;
+    }
 
-    // Map to reuse vertices: (posIdx, texIdx, normIdx) -> newIndex
-    std::map<std::tuple<int, int, int>, unsigned int> vertexMap;
+    inline const char *ParseFloat(const char *p, const char *end, float &out)
+    {
+        p = SkipBlanks(p, end);
+        if (p < end && *p == '+')
+            ++p;
+        auto res = std::from_chars(p, end, out);
+        if (res.ec != std::errc())
+            out = 0.0f;
+        return res.ptr;
+    }
 
-    std::ifstream file(path);
-    if (!file.is_open())
+    // Converts a 1-based (or negative, relative) OBJ index to a 0-based one; -1 means "absent".
+    // 'count' is the number of elements defined before the current line.
+    inline int ResolveIndex(int idx, size_t count)
     {
-        std::cerr << "Failed to open OBJ file: " << path << std::endl;
-        return nullptr;
+        if (idx > 0)
+            return idx - 1;
+        if (idx < 0)
+            return (int)count + idx;
+        return -1;
     }
 
-    std::string line;
-    while (std::getline(file, line))
+    enum class RecordType
+    {
+        Other,
+        Position,
+        TexCoord,
+        Normal,
+        Face
+    };
+
+    // Classifies the line starting at 'p' (leading blanks already skipped)
+    inline RecordType Classify(const char *p, const char *end)
     {
-        if (line.substr(0, 2) == "v ")
+        if (end - p < 2)
+            return RecordType::Other;
+        if (p[0] == 'v')
         {
-            std::istringstream s(line.substr(2));
-            glm::vec3 v;
-            s >> v.x >> v.y >> v.z;
-            temp_positions.push_back(v);
+            if (IsBlank(p[1]))
+                return RecordType::Position;
+            if (end - p > 2 && IsBlank(p[2]))
+            {
+                if (p[1] == 't')
+                    return RecordType::TexCoord;
+                if (p[1] == 'n')
+                    return RecordType::Normal;
+            }
         }
-        else if (line.substr(0, 3) == "vt ")
+        else if (p[0] == 'f' && IsBlank(p[1]))
+            return RecordType::Face;
+        return RecordType::Other;
+    }
+
+    struct ObjCounts
+    {
+        size_t positions = 0, texcoords = 0, normals = 0, faces = 0;
+    };
+
+    // Cheap pre-pass over a range of the mapped file. Gives the exact size of the
+    // attribute arrays and, per chunk, where its attributes start in them.
+    ObjCounts CountRecords(const char *p, const char *end)
+    {
+        ObjCounts counts;
+        while (p < end)
         {
-            std::istringstream s(line.substr(3));
-            glm::vec2 v;
-            s >> v.x >> v.y;
-            temp_texcoords.push_back(v);
+            p = SkipBlanks(p, end);
+            switch (Classify(p, end))
+            {
+            case RecordType::Position:
+                ++counts.positions;
+                break;
+            case RecordType::TexCoord:
+                ++counts.texcoords;
+                break;
+            case RecordType::Normal:
+                ++counts.normals;
+                break;
+            case RecordType::Face:
+                ++counts.faces;
+                break;
+            default:
+                break;
+            }
+            p = SkipLine(p, end);
         }
-        else if (line.substr(0, 3) == "vn ")
+        return counts;
+    }
+
+    // Newline-aligned slice of the file parsed independently of the others.
+    struct ObjChunk
+    {
+        const char *begin = nullptr;
+        const char *end = nullptr;
+
+        ObjCounts counts; // Records inside this chunk
+        ObjCounts bases;  // Records in all preceding chunks
+
+        // Resolved (0-based, absolute) corner keys, three ints per corner
+        std::vector<int> corners;
+        // Number of corners of each face, in file order
+        std::vector<unsigned int> faceSizes;
+        // Output vertex index of every corner, filled by the dedup pass
+        std::vector<unsigned int> cornerVertices;
+        size_t triangleCount = 0;
+        size_t firstIndex = 0;
+    };
+
+    // Below this size a file is parsed as a single chunk; threads would cost more than they save
+    const size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+    std::vector<ObjChunk> SplitChunks(const char *begin, const char *end, size_t chunkCount)
+    {
+        std::vector<ObjChunk> chunks;
+        const char *p = begin;
+        size_t chunkSize = (end - begin) / chunkCount + 1;
+        while (p < end)
         {
-            std::istringstream s(line.substr(3));
-            glm::vec3 v;
-            s >> v.x >> v.y >> v.z;
-            temp_normals.push_back(v);
+            const char *chunkEnd = (size_t)(end - p) > chunkSize ? SkipLine(p + chunkSize, end) : end;
+            ObjChunk chunk;
+            chunk.begin = p;
+            chunk.end = chunkEnd;
+            chunks.push_back(std::move(chunk));
+            p = chunkEnd;
         }
-        else if (line.substr(0, 2) == "f ")
-        {
-            // f v1/vt1/vn1 v2/vt2/vn2 v3/vt3/vn3 ...
-            std::string content = line.substr(2);
-            std::vector<std::string> faceTokens;
-            std::istringstream contentStream(content);
-            std::string temp;
-            while (contentStream >> temp)
-            {
-                faceTokens.push_back(temp);
-            }
+        return chunks;
+    }
 
-            // Triangulate fan: 0, 1, 2;  0, 2, 3; ...
-            for (size_t i = 1; i < faceTokens.size() - 1; ++i)
+    // Widens 'min'/'max' by the position records of a range of the mapped file
+    void ScanPositionBounds(const char *p, const char *end, glm::vec3 &min, glm::vec3 &max)
+    {
+        while (p < end)
+        {
+            p = SkipBlanks(p, end);
+            if (Classify(p, end) == RecordType::Position)
             {
-                std::string faceVerts[3] = {faceTokens[0], faceTokens[i], faceTokens[i + 1]};
+                glm::vec3 v;
+                p = ParseFloat(p + 2, end, v.x);
+                p = ParseFloat(p, end, v.y);
+                p = ParseFloat(p, end, v.z);
+                min = glm::min(min, v);
+                max = glm::max(max, v);
+            }
+            p = SkipLine(p, end);
+        }
+    }
 
-                for (const auto &fv : faceVerts)
-                {
-                    std::vector<std::string> indicesStr = split(fv, '/');
+    // Parses one chunk: attributes are written straight into the shared arrays at the
+    // chunk's base offsets, face corners are resolved into chunk-local storage.
+    void ParseChunk(ObjChunk &chunk, glm::vec3 *positions, glm::vec2 *texcoords, glm::vec3 *normals)
+    {
+        size_t nPos = chunk.bases.positions;
+        size_t nTex = chunk.bases.texcoords;
+        size_t nNorm = chunk.bases.normals;
 
-                    int pIdx = -1, tIdx = -1, nIdx = -1;
+        chunk.faceSizes.reserve(chunk.counts.faces);
+        chunk.corners.reserve(chunk.counts.faces * 9);
 
-                    if (indicesStr.size() > 0 && !indicesStr[0].empty())
-                        pIdx = std::stoi(indicesStr[0]) - 1;
-                    if (indicesStr.size() > 1 && !indicesStr[1].empty())
-                        tIdx = std::stoi(indicesStr[1]) - 1;
-                    if (indicesStr.size() > 2 && !indicesStr[2].empty())
-                        nIdx = std::stoi(indicesStr[2]) - 1;
+        const char *p = chunk.begin;
+        const char *end = chunk.end;
+        while (p < end)
+        {
+            p = SkipBlanks(p, end);
+            switch (Classify(p, end))
+            {
+            case RecordType::Position:
+            {
+                glm::vec3 &v = positions[nPos++];
+                p = ParseFloat(p + 2, end, v.x);
+                p = ParseFloat(p, end, v.y);
+                p = ParseFloat(p, end, v.z);
+                break;
+            }
+            case RecordType::TexCoord:
+            {
+                glm::vec2 &v = texcoords[nTex++];
+                p = ParseFloat(p + 3, end, v.x);
+                p = ParseFloat(p, end, v.y);
+                break;
+            }
+            case RecordType::Normal:
+            {
+                glm::vec3 &v = normals[nNorm++];
+                p = ParseFloat(p + 3, end, v.x);
+                p = ParseFloat(p, end, v.y);
+                p = ParseFloat(p, end, v.z);
+                break;
+            }
+            case RecordType::Face:
+            {
+                // f v1/vt1/vn1 v2/vt2/vn2 v3/vt3/vn3 ...
+                unsigned int cornerCount = 0;
+                p += 2;
+                while (true)
+                {
+                    p = SkipBlanks(p, end);
+                    if (p >= end || *p == '\n')
+                        break;
 
-                    auto key = std::make_tuple(pIdx, tIdx, nIdx);
-                    if (vertexMap.find(key) == vertexMap.end())
+                    int raw[3] = {0, 0, 0};
+                    for (int k = 0; k < 3; ++k)
                     {
-                        Vertex vert;
-                        // Position
-                        if (pIdx >= 0 && pIdx < temp_positions.size())
-                            vert.Position = temp_positions[pIdx];
+                        if (p < end && *p != '/')
+                        {
+                            auto res = std::from_chars(p, end, raw[k]);
+                            p = res.ptr;
+                        }
+                        if (p < end && *p == '/' && k < 2)
+                            ++p;
                         else
-                            vert.Position = glm::vec3(0.0f);
+                            break;
+                    }
+                    // Skip anything unexpected up to the next separator
+                    while (p < end && !IsBlank(*p) && *p != '\n')
+                        ++p;
 
-                        // Texture
-                        if (tIdx >= 0 && tIdx < temp_texcoords.size())
-                            vert.TexCoords = temp_texcoords[tIdx];
-                        else
-                            vert.TexCoords = glm::vec2(0.0f);
+                    chunk.corners.push_back(ResolveIndex(raw[0], nPos));
+                    chunk.corners.push_back(ResolveIndex(raw[1], nTex));
+                    chunk.corners.push_back(ResolveIndex(raw[2], nNorm));
+                    ++cornerCount;
+                }
+                chunk.faceSizes.push_back(cornerCount);
+                if (cornerCount >= 3)
+                    chunk.triangleCount += cornerCount - 2;
+                break;
+            }
+            default:
+                break;
+            }
+            p = SkipLine(p, end);
+        }
+    }
+}
 
-                        // Normal
-                        if (nIdx >= 0 && nIdx < temp_normals.size())
-                            vert.Normal = temp_normals[nIdx];
-                        else
-                            vert.Normal = glm::vec3(0.0f); // Should optionally compute if missing?
+bool ModelLoader::ScanObjBounds(const std::string &path, glm::vec3 &min, glm::vec3 &max, const LoadOptions &options)
+{
+    MappedFile file;
+    if (!file.Open(path))
+        return false;
 
-                        vert.Color = glm::vec3(0.8f); // Default grey color
+    const char *begin = file.Data();
+    const char *end = begin + file.Size();
+    ThreadPool &pool = ThreadPool::Shared();
+    unsigned int threads = options.threads == 0 ? pool.Size() : options.threads;
+    size_t maxChunks = std::max<size_t>(1, file.Size() / MIN_CHUNK_BYTES);
+    size_t chunkCount = threads > 1 ? std::min<size_t>(maxChunks, threads) : 1;
+    std::vector<ObjChunk> chunks = SplitChunks(begin, end, chunkCount);
 
-                        unsigned int newIndex = (unsigned int)vertices.size();
-                        vertices.push_back(vert);
-                        indices.push_back(newIndex);
-                        vertexMap[key] = newIndex;
-                    }
-                    else
-                    {
-                        indices.push_back(vertexMap[key]);
-                    }
-                }
+    std::vector<glm::vec3> chunkMin(chunks.size(), glm::vec3(INFINITY)), chunkMax(chunks.size(), glm::vec3(-INFINITY));
+    pool.ParallelFor(chunks.size(), [&](size_t i)
+                     { ScanPositionBounds(chunks[i].begin, chunks[i].end, chunkMin[i], chunkMax[i]); }, threads);
+
+    min = glm::vec3(INFINITY);
+    max = glm::vec3(-INFINITY);
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        min = glm::min(min, chunkMin[i]);
+        max = glm::max(max, chunkMax[i]);
+    }
+    return min.x <= max.x;
+}
+
+bool ModelLoader::ParseObj(const std::string &path, MeshData &mesh, const LoadOptions &options)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        std::cerr << "Failed to open OBJ file: " << path << std::endl;
+        return false;
+    }
+
+    const char *begin = file.Data();
+    const char *end = begin + file.Size();
+
+    ThreadPool &pool = ThreadPool::Shared();
+    unsigned int threads = options.threads == 0 ? pool.Size() : options.threads;
+    // Oversplit a little so uneven chunks still balance across the threads
+    size_t maxChunks = std::max<size_t>(1, file.Size() / MIN_CHUNK_BYTES);
+    size_t chunkCount = threads > 1 ? std::min<size_t>(maxChunks, threads * 4) : 1;
+
+    std::vector<ObjChunk> chunks = SplitChunks(begin, end, chunkCount);
+
+    // 1. Count records per chunk, then prefix-sum so each chunk knows where its data goes
+    pool.ParallelFor(chunks.size(), [&](size_t i)
+                     { chunks[i].counts = CountRecords(chunks[i].begin, chunks[i].end); }, threads);
+
+    ObjCounts total;
+    for (ObjChunk &chunk : chunks)
+    {
+        chunk.bases = total;
+        total.positions += chunk.counts.positions;
+        total.texcoords += chunk.counts.texcoords;
+        total.normals += chunk.counts.normals;
+        total.faces += chunk.counts.faces;
+    }
+
+    // 2. Parse attributes and face corners; relative indices resolve against the chunk bases
+    std::vector<glm::vec3> temp_positions(total.positions);
+    std::vector<glm::vec2> temp_texcoords(total.texcoords);
+    std::vector<glm::vec3> temp_normals(total.normals);
+
+    pool.ParallelFor(chunks.size(), [&](size_t i)
+                     { ParseChunk(chunks[i], temp_positions.data(), temp_texcoords.data(), temp_normals.data()); },
+                     threads);
+
+    // 3. Deduplicate corners in file order so the vertex order never depends on the chunking.
+    // Map to reuse vertices: (posIdx, texIdx, normIdx) -> newIndex
+    CornerMap vertexMap(std::max(total.positions, total.normals));
+    std::vector<int> uniqueKeys;
+    uniqueKeys.reserve(std::max(total.positions, total.normals) * 3);
+
+    size_t triangleCount = 0;
+    for (ObjChunk &chunk : chunks)
+    {
+        size_t cornerCount = chunk.corners.size() / 3;
+        chunk.cornerVertices.resize(cornerCount);
+        for (size_t c = 0; c < cornerCount; ++c)
+        {
+            const int *key = &chunk.corners[c * 3];
+            bool inserted;
+            unsigned int newIndex = (unsigned int)(uniqueKeys.size() / 3);
+            chunk.cornerVertices[c] = vertexMap.FindOrInsert(key[0], key[1], key[2], newIndex, inserted);
+            if (inserted)
+                uniqueKeys.insert(uniqueKeys.end(), key, key + 3);
+        }
+
+        chunk.firstIndex = triangleCount * 3;
+        triangleCount += chunk.triangleCount;
+    }
+
+    // 4. Build vertices and triangulate in parallel; both write to disjoint, precomputed ranges
+    std::vector<Vertex> &vertices = mesh.vertices;
+    std::vector<unsigned int> &indices = mesh.indices;
+    vertices.resize(uniqueKeys.size() / 3);
+    indices.resize(triangleCount * 3);
+
+    const size_t VERTEX_BATCH = 16384;
+    pool.ParallelFor((vertices.size() + VERTEX_BATCH - 1) / VERTEX_BATCH, [&](size_t batch)
+                     {
+        size_t last = std::min(vertices.size(), (batch + 1) * VERTEX_BATCH);
+        for (size_t v = batch * VERTEX_BATCH; v < last; ++v)
+        {
+            int pIdx = uniqueKeys[v * 3 + 0];
+            int tIdx = uniqueKeys[v * 3 + 1];
+            int nIdx = uniqueKeys[v * 3 + 2];
+
+            Vertex &vert = vertices[v];
+            // Position
+            if (pIdx >= 0 && pIdx < (int)temp_positions.size())
+                vert.Position = temp_positions[pIdx];
+            else
+                vert.Position = glm::vec3(0.0f);
+
+            // Texture
+            if (tIdx >= 0 && tIdx < (int)temp_texcoords.size())
+                vert.TexCoords = temp_texcoords[tIdx];
+            else
+                vert.TexCoords = glm::vec2(0.0f);
+
+            // Normal
+            if (nIdx >= 0 && nIdx < (int)temp_normals.size())
+                vert.Normal = temp_normals[nIdx];
+            else
+                vert.Normal = glm::vec3(0.0f);
+
+            vert.Color = glm::vec3(0.8f); // Default grey color
+        } }, threads);
+
+    pool.ParallelFor(chunks.size(), [&](size_t i)
+                     {
+        const ObjChunk &chunk = chunks[i];
+        unsigned int *out = indices.data() + chunk.firstIndex;
+        const unsigned int *corner = chunk.cornerVertices.data();
+        for (unsigned int faceSize : chunk.faceSizes)
+        {
+            // Triangulate fan: 0, 1, 2;  0, 2, 3; ...
+            for (unsigned int k = 1; k + 1 < faceSize; ++k)
+            {
+                *out++ = corner[0];
+                *out++ = corner[k];
+                *out++ = corner[k + 1];
             }
+            corner += faceSize;
+        } }, threads);
+
+    return true;
+}
+
+std::unique_ptr<LoadedMesh> ModelLoader::LoadMesh(const std::string &path, const LoadOptions &options,
+                                                   const std::function<void(const MeshBounds &)> &onBounds)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto elapsedMs = [&]
+    { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+
+    auto mesh = std::make_unique<LoadedMesh>();
+
+    const uint32_t processingFlags = options.ProcessingFlags();
+    if (options.useCache && MeshCache::Load(path, processingFlags, mesh->mapped))
+    {
+        mesh->vertices = mesh->mapped.vertices;
+        mesh->vertexCount = mesh->mapped.vertexCount;
+        mesh->indices = mesh->mapped.indices;
+        mesh->indexCount = mesh->mapped.indexCount;
+        mesh->lods = mesh->mapped.lods;
+        mesh->subMeshes = mesh->mapped.subMeshes;
+        if (onBounds)
+        {
+            MeshBounds bounds;
+            ComputeBounds(mesh->vertices, mesh->vertexCount, bounds.min, bounds.max);
+            onBounds(bounds);
+        }
+        std::cout << "Loaded OBJ: " << path << " from cache with " << mesh->vertexCount << " vertices and "
+                  << mesh->indexCount << " indices in " << elapsedMs() << " ms." << std::endl;
+    }
+    else
+    {
+        // A scan of the positions alone is much cheaper than the parse and lets a placeholder show meanwhile
+        MeshBounds bounds;
+        if (onBounds && ScanObjBounds(path, bounds.min, bounds.max, options))
+            onBounds(bounds);
+
+        if (!ParseObj(path, mesh->data, options))
+            return nullptr;
+
+        std::cout << "Loaded OBJ: " << path << " with " << mesh->data.vertices.size() << " vertices and "
+                  << mesh->data.indices.size() << " indices in " << elapsedMs() << " ms." << std::endl;
+
+        if (options.optimize)
+            MeshOptimizer::OptimizeMesh(mesh->data);
+
+        if (options.lodLevels > 0)
+        {
+            MeshSimplifier::GenerateLods(mesh->data, options.lodLevels, options.optimize);
+            std::cout << "Generated " << mesh->data.lods.size() - 1 << " LODs for " << path << ":";
+            for (const MeshLod &lod : mesh->data.lods)
+                std::cout << " " << lod.indexCount / 3;
+            std::cout << " triangles" << std::endl;
         }
+
+        if (options.partitionSubMeshes && MeshOptimizer::PartitionSubMeshes(mesh->data, MAX_SHORT_INDEX_VERTICES, options.VertexStride()))
+            std::cout << "Partitioned " << path << " into " << mesh->data.subMeshes.size() << " sub-meshes for 16-bit indices"
+                      << std::endl;
+
+        if (options.useCache)
+            MeshCache::Store(path, processingFlags, mesh->data);
+
+        mesh->vertices = mesh->data.vertices.data();
+        mesh->vertexCount = mesh->data.vertices.size();
+        mesh->indices = mesh->data.indices.data();
+        mesh->indexCount = mesh->data.indices.size();
+        mesh->lods = mesh->data.lods;
+        mesh->subMeshes = mesh->data.subMeshes;
     }
 
-    // Safety check: if normals are missing (0,0,0), we could Recalculate them,
-    // but for now let's leave it simple.
+    ComputeBounds(mesh->vertices, mesh->vertexCount, mesh->boundsMin, mesh->boundsMax);
+    mesh->boundsRadius = ComputeBoundingRadius(mesh->vertices, mesh->vertexCount, (mesh->boundsMin + mesh->boundsMax) * 0.5f);
+
+    if (options.packVertices)
+    {
+        VertexPacking::Pack(mesh->vertices, mesh->vertexCount, mesh->packed);
+        std::cout << "Packed vertices of " << path << ": " << mesh->vertexCount * sizeof(Vertex) / 1024 << " KB -> "
+                  << VertexPacking::ByteSize(mesh->packed) / 1024 << " KB"
+                  << (mesh->packed.colors.empty() ? " (no color stream)" : "") << std::endl;
+    }
+    return mesh;
+}
+
+SceneObject *ModelLoader::LoadObj(const std::string &path, const LoadOptions &options)
+{
+    std::unique_ptr<LoadedMesh> mesh = LoadMesh(path, options);
+    if (!mesh)
+        return nullptr;
 
-    std::cout << "Loaded OBJ: " << path << " with " << vertices.size() << " vertices and " << indices.size() << " indices." << std::endl;
+    // Uploads straight from the parsed arrays or the cache mapping; no intermediate copies.
+    // The LODs and format go first, since they decide the buffer layout and index type.
+    SceneObject *object = new SceneObject();
+    object->SetBounds(mesh->boundsMin, mesh->boundsMax, mesh->boundsRadius);
+    object->SetLods(mesh->lods, mesh->subMeshes);
+    if (options.packVertices)
+        object->SetPackedFormat(mesh->packed);
+    object->AllocateBuffers(mesh->vertexCount, mesh->indexCount);
+    if (options.packVertices)
+        object->UploadVertices(mesh->packed, 0, mesh->vertexCount);
+    else
+        object->UploadVertices(mesh->vertices, 0, mesh->vertexCount);
+    object->UploadIndices(mesh->indices, 0, mesh->indexCount);
+    object->MarkResident();
+    return object;
+}
 
-    return new SceneObject(vertices, indices);
+AsyncMesh ModelLoader::LoadObjAsync(const std::string &path, const LoadOptions &options)
+{
+    auto boundsPromise = std::make_shared<std::promise<MeshBounds>>();
+    AsyncMesh result;
+    result.bounds = boundsPromise->get_future();
+    result.mesh = ThreadPool::Shared().Submit([path, options, boundsPromise]()
+    {
+        // The bounds future must be ready by the time the mesh future is, even when loading fails
+        bool published = false;
+        std::unique_ptr<LoadedMesh> mesh;
+        try
+        {
+            mesh = LoadMesh(path, options, [&](const MeshBounds &bounds)
+            {
+                boundsPromise->set_value(bounds);
+                published = true;
+            });
+        }
+        catch (...)
+        {
+            if (!published)
+                boundsPromise->set_exception(std::current_exception());
+            throw;
+        }
+        if (!published)
+            boundsPromise->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        return mesh;
+    });
+    return result;
 }
@@ -1,10 +1,117 @@
 #pragma once
+#include <future>
+#include <memory>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 #include "Shape.h"
+#include "MeshCache.h"
+
+// CPU-side result of parsing a model: triangulated, deduplicated vertices and indices.
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    // Optional LOD chain; when empty 'indices' is a single level
+    std::vector<MeshLod> lods;
+    // Set by MeshOptimizer::PartitionSubMeshes; the LODs refer to these
+    std::vector<SubMesh> subMeshes;
+};
+
+struct LoadOptions
+{
+    // Parser threads; 0 uses every core, 1 parses serially on the calling thread.
+    // The output is identical for every thread count.
+    unsigned int threads = 0;
+
+    // Reuse/write the '<path>.meshbin' binary cache instead of re-parsing unchanged sources
+    bool useCache = true;
+
+    // Reorder triangles and vertices for vertex cache, overdraw and fetch locality (see MeshOptimizer)
+    bool optimize = false;
+
+    // Number of simplified LOD levels generated below the full-resolution mesh (see MeshSimplifier)
+    int lodLevels = 0;
+
+    // Upload in the compact PackedVertex layout instead of full-float Vertex (see VertexPacking).
+    // Packing happens after the cache; it is only part of the cache key through the partitioning.
+    bool packVertices = false;
+
+    // Split meshes with more than 65535 vertices into sub-meshes so they can use 16-bit indices
+    bool partitionSubMeshes = false;
+
+    // Bytes per uploaded vertex, not counting the optional color stream of packed vertices
+    size_t VertexStride() const { return packVertices ? sizeof(PackedVertex) : sizeof(Vertex); }
+
+    // Bits identifying every option that changes the produced mesh; part of the cache key.
+    // Whether a partition pays off depends on the vertex stride, so packing counts when partitioning.
+    uint32_t ProcessingFlags() const
+    {
+        return (optimize ? 1u : 0u) | (partitionSubMeshes ? 2u : 0u) | (partitionSubMeshes && packVertices ? 4u : 0u) |
+               ((uint32_t)lodLevels << 8);
+    }
+};
+
+// A mesh ready for GPU upload: either freshly parsed arrays or a mapped cache entry.
+// 'vertices'/'indices' point into whichever of the two holds the data.
+struct LoadedMesh
+{
+    MeshData data;
+    MappedMesh mapped;
+
+    const Vertex *vertices = nullptr;
+    size_t vertexCount = 0;
+    const unsigned int *indices = nullptr;
+    size_t indexCount = 0;
+    std::vector<MeshLod> lods;
+    std::vector<SubMesh> subMeshes;
+    // Filled when LoadOptions::packVertices is set; uploaded instead of 'vertices'
+    PackedVertexData packed;
+
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    float boundsRadius = 0.0f; // Around the center of the box
+};
+
+// Box of a mesh known before the mesh itself; a negative radius means the half diagonal (see SceneObject::SetBounds)
+struct MeshBounds
+{
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+    float radius = -1.0f;
+};
+
+// A mesh loading on a worker thread (see ModelLoader::LoadObjAsync)
+struct AsyncMesh
+{
+    // Ready ahead of 'mesh', so a placeholder can be shown while the file parses.
+    // Holds an exception instead if loading ended without finding any (e.g. the file cannot be loaded).
+    std::future<MeshBounds> bounds;
+    // nullptr if the file cannot be loaded; rethrows any exception thrown while loading
+    std::future<std::unique_ptr<LoadedMesh>> mesh;
+};
 
 class ModelLoader
 {
 public:
-    static SceneObject *LoadObj(const std::string &path);
+    static SceneObject *LoadObj(const std::string &path, const LoadOptions &options = {});
+
+    // Parses (or maps from cache) and prepares the mesh on a worker thread.
+    // The result still has to be uploaded on the GL thread; Scene::AddShapeAsync does that in slices.
+    // The bounds are published first: from the cache entry, or from ScanObjBounds before the full parse.
+    static AsyncMesh LoadObjAsync(const std::string &path, const LoadOptions &options = {});
+
+    // CPU half of LoadObj: cache lookup, parsing and vertex processing. Safe to call from any thread.
+    // 'onBounds', if set, receives the mesh bounds as soon as they are known, before the parse.
+    static std::unique_ptr<LoadedMesh> LoadMesh(const std::string &path, const LoadOptions &options = {},
+                                                const std::function<void(const MeshBounds &)> &onBounds = {});
+
+    // Box around the vertex positions of an OBJ file, from a scan that skips every other record.
+    // Returns false if the file cannot be opened or has no positions.
+    static bool ScanObjBounds(const std::string &path, glm::vec3 &min, glm::vec3 &max, const LoadOptions &options = {});
+
+    // Parses an OBJ file into 'mesh' without touching any GL state.
+    // Returns false if the file cannot be opened.
+    static bool ParseObj(const std::string &path, MeshData &mesh, const LoadOptions &options = {});
 };
@@ -0,0 +1,115 @@
+#include "ObjectStore.h"
+#include "Bvh.h"
+#include "Shape.h"
+#include <algorithm>
+
+ObjectStore::ObjectStore(TransformHierarchy &transforms)
+    : transforms(transforms)
+{
+}
+
+void ObjectStore::Reserve(size_t count)
+{
+    ForEachColumn([count](auto &column) { column.reserve(count); });
+}
+
+ObjectHandle ObjectStore::Create(SceneObject *shape, Shader *shader)
+{
+    uint32_t slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        slot = (uint32_t)slots.size();
+        slots.push_back({INVALID_INDEX, 0});
+    }
+    uint32_t dense = (uint32_t)handles.size();
+    slots[slot].dense = dense;
+    ObjectHandle handle(slot, slots[slot].generation);
+
+    handles.push_back(handle);
+    shapes.push_back(shape);
+    shaders.push_back(shader);
+    nodes.push_back(transforms.Create());
+    models.push_back(glm::mat4(1.0f));
+    localBounds.push_back(Aabb{});
+    boundsRadii.push_back(0.0f);
+    worldBounds.push_back(Aabb{});
+    meshes.push_back(0);
+    colors.push_back(glm::vec4(1.0f, 1.0f, 1.0f, 0.0f));
+    flags.push_back(0);
+    lodCounts.push_back(1);
+    lods.push_back(0);
+    bvhProxies.push_back(DynamicBvh::NULL_NODE);
+
+    if (shape)
+    {
+        shape->LinkStore(this, handle);
+        Refresh(handle);
+    }
+    return handle;
+}
+
+bool ObjectStore::Destroy(ObjectHandle handle)
+{
+    uint32_t dense = IndexOf(handle);
+    if (dense == INVALID_INDEX)
+        return false;
+
+    if (shapes[dense])
+        shapes[dense]->LinkStore(nullptr, ObjectHandle());
+    TransformHierarchy::NodeId node = nodes[dense];
+    while (transforms.GetFirstChild(node) != TransformHierarchy::NULL_NODE)
+        transforms.SetParent(transforms.GetFirstChild(node), TransformHierarchy::NULL_NODE);
+    transforms.Destroy(node);
+
+    // Move the last row into the hole
+    uint32_t last = (uint32_t)handles.size() - 1;
+    if (dense != last)
+    {
+        ForEachColumn([dense, last](auto &column) { column[dense] = column[last]; });
+        slots[handles[dense].Index()].dense = dense;
+    }
+    ForEachColumn([](auto &column) { column.pop_back(); });
+
+    Slot &slot = slots[handle.Index()];
+    slot.dense = INVALID_INDEX;
+    slot.generation = (slot.generation + 1) & ObjectHandle::GENERATION_MASK;
+    freeSlots.push_back(handle.Index());
+    return true;
+}
+
+uint32_t ObjectStore::IndexOf(ObjectHandle handle) const
+{
+    uint32_t index = handle.Index();
+    if (handle.IsNull() || index >= slots.size())
+        return INVALID_INDEX;
+    const Slot &slot = slots[index];
+    return slot.generation == handle.Generation() ? slot.dense : INVALID_INDEX;
+}
+
+void ObjectStore::SetLocalTransform(ObjectHandle handle, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    uint32_t dense = IndexOf(handle);
+    if (dense != INVALID_INDEX)
+        transforms.SetLocal(nodes[dense], position, rotation, scale);
+}
+
+void ObjectStore::Refresh(ObjectHandle handle)
+{
+    uint32_t dense = IndexOf(handle);
+    if (dense == INVALID_INDEX || !shapes[dense])
+        return;
+    const SceneObject *shape = shapes[dense];
+    localBounds[dense] = Aabb{shape->boundsMin, shape->boundsMax};
+    boundsRadii[dense] = shape->GetBoundsRadius();
+    meshes[dense] = shape->GetVertexArray();
+    colors[dense] = glm::vec4(shape->objectColor, shape->useObjectColor ? 1.0f : 0.0f);
+    lodCounts[dense] = (uint8_t)std::min(shape->GetLodCount(), 255);
+    uint8_t visible = flags[dense] & FLAG_VISIBLE;
+    flags[dense] = visible | FLAG_BOUNDS_DIRTY | (shape->IsResident() ? FLAG_RESIDENT : 0) |
+                   (shape->HasBounds() ? FLAG_HAS_BOUNDS : 0) | (shape->IsInArena() ? FLAG_IN_ARENA : 0);
+}
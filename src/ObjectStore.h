@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "Culling.h"
+#include "TransformHierarchy.h"
+
+class SceneObject;
+class Shader;
+
+// Stable reference to an object in an ObjectStore: a slot of the store's sparse table and the
+// generation that slot had when the object was created. Destroying the object bumps the generation,
+// so old handles stop resolving even after the slot is reused. Packs into 32 bits (22-bit slot,
+// 10-bit generation) so it fits places like BVH user data.
+struct ObjectHandle
+{
+    static const uint32_t INDEX_BITS = 22;
+    static const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static const uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+    uint32_t value = 0xFFFFFFFF;
+
+    ObjectHandle() = default;
+    explicit ObjectHandle(uint32_t packed) : value(packed) {}
+    ObjectHandle(uint32_t index, uint32_t generation) : value(index | ((generation & GENERATION_MASK) << INDEX_BITS)) {}
+
+    uint32_t Index() const { return value & INDEX_MASK; }
+    uint32_t Generation() const { return value >> INDEX_BITS; }
+    bool IsNull() const { return value == 0xFFFFFFFF; }
+    bool operator==(const ObjectHandle &other) const { return value == other.value; }
+    bool operator!=(const ObjectHandle &other) const { return value != other.value; }
+};
+
+// The scene's objects as parallel dense arrays, so the per-frame passes (transform pickup, culling,
+// LOD selection, render queue building) stream through just the columns they need instead of
+// chasing a pointer per object. SceneObject keeps what is only touched to draw: GL buffers, LOD tables.
+//
+// Destroying an object moves the last one into its place, so dense indices are stable only between
+// edits; keep ObjectHandles across frames. Each object also owns a node in the transform hierarchy.
+class ObjectStore
+{
+public:
+    static const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+    enum Flags : uint8_t
+    {
+        FLAG_RESIDENT = 1,
+        FLAG_HAS_BOUNDS = 2,
+        FLAG_IN_ARENA = 4,
+        FLAG_VISIBLE = 8,       // This frame, set by culling
+        FLAG_BOUNDS_DIRTY = 16, // Local bounds changed since the world bounds were computed
+    };
+
+    explicit ObjectStore(TransformHierarchy &transforms);
+
+    // Adds a row filled from 'shape' and links the shape to it, so its setters keep the row current.
+    // 'shape' may be null for bare rows whose columns the caller fills (e.g. benchmarks).
+    ObjectHandle Create(SceneObject *shape, Shader *shader);
+    // Removes the row and its transform node; child nodes become roots. The shape is unlinked, not deleted.
+    bool Destroy(ObjectHandle handle);
+    bool IsValid(ObjectHandle handle) const { return IndexOf(handle) != INVALID_INDEX; }
+    // Dense index of a live object, or INVALID_INDEX
+    uint32_t IndexOf(ObjectHandle handle) const;
+    size_t Size() const { return handles.size(); }
+    void Reserve(size_t count);
+
+    // Called by SceneObject when its properties change
+    void SetLocalTransform(ObjectHandle handle, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale);
+    // Re-reads bounds, color, residency, LOD count and mesh from the linked shape
+    void Refresh(ObjectHandle handle);
+
+    // Columns, all indexed by dense index
+    std::vector<ObjectHandle> handles;
+    std::vector<SceneObject *> shapes;
+    std::vector<Shader *> shaders;
+    std::vector<TransformHierarchy::NodeId> nodes;
+    std::vector<glm::mat4> models;     // World matrices, copied from the hierarchy each frame
+    std::vector<Aabb> localBounds;
+    std::vector<float> boundsRadii;    // Around the center of the local bounds
+    std::vector<Aabb> worldBounds;
+    std::vector<uint32_t> meshes;      // VAO, the mesh field of the render queue key
+    std::vector<glm::vec4> colors;     // Object color, w = 1 when it replaces the vertex colors
+    std::vector<uint8_t> flags;
+    std::vector<uint8_t> lodCounts;
+    std::vector<int32_t> lods;         // Selected once per frame, shared by every pass
+    std::vector<int32_t> bvhProxies;
+
+private:
+    TransformHierarchy &transforms;
+
+    struct Slot
+    {
+        uint32_t dense;
+        uint32_t generation;
+    };
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+
+    template <class F>
+    void ForEachColumn(F &&f)
+    {
+        f(handles), f(shapes), f(shaders), f(nodes), f(models), f(localBounds), f(boundsRadii), f(worldBounds);
+        f(meshes), f(colors), f(flags), f(lodCounts), f(lods), f(bvhProxies);
+    }
+};
@@ -0,0 +1,153 @@
+#include "ProgramCache.h"
+#include "MeshCache.h"
+
+#include <GL/glew.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+    const char MAGIC[8] = {'G', 'K', 'P', 'R', 'G', 'B', 'I', 'N'};
+    const uint32_t VERSION = 1;
+    const char *CACHE_DIRECTORY = "shader_cache";
+
+    struct ProgramCacheHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t binaryFormat;
+        uint64_t key;
+        uint64_t binarySize; // Binary bytes follow the header
+    };
+
+    std::string EntryPath(uint64_t key)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return (std::filesystem::path(CACHE_DIRECTORY) / name).string();
+    }
+
+    std::string GlString(GLenum name)
+    {
+        const GLubyte *value = glGetString(name);
+        return value ? reinterpret_cast<const char *>(value) : "";
+    }
+}
+
+bool ProgramCache::IsSupported()
+{
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+        return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+std::string ProgramCache::DriverId()
+{
+    return GlString(GL_VENDOR) + "\n" + GlString(GL_RENDERER) + "\n" + GlString(GL_VERSION);
+}
+
+uint64_t ProgramCache::Key(const std::string &driverId, const std::string &vertexCode, const std::string &fragmentCode,
+                           const std::string &defines)
+{
+    // Hash each part separately (chained through the seed) so moving text between them changes the key
+    uint64_t key = MeshCache::HashBytes(driverId.data(), driverId.size());
+    key = MeshCache::HashBytes(vertexCode.data(), vertexCode.size(), key);
+    key = MeshCache::HashBytes(fragmentCode.data(), fragmentCode.size(), key);
+    key = MeshCache::HashBytes(defines.data(), defines.size(), key);
+    return key;
+}
+
+unsigned int ProgramCache::Load(uint64_t key)
+{
+    std::string path = EntryPath(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return 0;
+
+    ProgramCacheHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.key != key)
+        return 0;
+
+    // The size comes from disk: check it against the file and what glProgramBinary takes before allocating.
+    // A corrupt entry is a miss, and removed so the recompile replaces it.
+    std::error_code ec;
+    uint64_t fileSize = std::filesystem::file_size(path, ec);
+    if (ec || header.binarySize == 0 || header.binarySize > fileSize - sizeof(header) ||
+        header.binarySize > (uint64_t)std::numeric_limits<GLsizei>::max())
+    {
+        std::cerr << "Discarding corrupt program cache entry: " << path << std::endl;
+        in.close();
+        std::filesystem::remove(path, ec);
+        return 0;
+    }
+
+    std::vector<char> binary(header.binarySize);
+    if (!in.read(binary.data(), binary.size()))
+        return 0;
+
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+    // Drivers reject binaries after an update or for a different GPU; the caller then recompiles
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+bool ProgramCache::Store(uint64_t key, unsigned int program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    ProgramCacheHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.binaryFormat = format;
+    header.key = key;
+    header.binarySize = binary.size();
+
+    std::error_code ec;
+    std::filesystem::create_directories(CACHE_DIRECTORY, ec);
+
+    // Write to a temporary file and rename, so a crash never leaves a truncated entry behind
+    std::string path = EntryPath(key);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(binary.data(), binary.size());
+        if (!out)
+            return false;
+    }
+
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec)
+    {
+        std::cerr << "Failed to write program cache: " << path << " (" << ec.message() << ")" << std::endl;
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Persistent cache of linked GL program binaries (glGetProgramBinary / glProgramBinary) under
+// 'shader_cache/'. Entries are keyed by the shader sources, the injected defines and the driver
+// vendor/renderer/version, so a driver update or an edited shader simply misses.
+namespace ProgramCache
+{
+    // True if the context can save and restore program binaries (GL 4.1 or ARB_get_program_binary)
+    bool IsSupported();
+
+    // Vendor, renderer and version strings of the current context; query on the GL thread
+    std::string DriverId();
+
+    // Pure function of its inputs, so it can run on worker threads
+    uint64_t Key(const std::string &driverId, const std::string &vertexCode, const std::string &fragmentCode,
+                 const std::string &defines);
+
+    // Creates a program from the cached binary. Returns 0 on a miss or when the driver rejects the binary.
+    unsigned int Load(uint64_t key);
+
+    // Saves the binary of a linked program created with the retrievable hint.
+    bool Store(uint64_t key, unsigned int program);
+}
@@ -0,0 +1,57 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <cstring>
+
+uint64_t RenderQueue::MakeKey(uint32_t pass, uint32_t shader, uint32_t mesh, float depth)
+{
+    const uint32_t depthMax = (1u << 24) - 1;
+    uint32_t quantizedDepth = (uint32_t)(std::clamp(depth, 0.0f, 1.0f) * depthMax);
+    return ((uint64_t)(pass & 0xF) << 60) | ((uint64_t)(shader & 0xFFF) << 48) | ((uint64_t)(mesh & 0xFFFFFF) << 24) |
+           quantizedDepth;
+}
+
+void RenderQueue::Sort()
+{
+    const size_t count = items.size();
+    if (count < 2)
+        return;
+
+    // Histograms of all eight digits in a single read of the keys
+    uint32_t histograms[8][256];
+    std::memset(histograms, 0, sizeof(histograms));
+    for (const Item &item : items)
+    {
+        uint64_t key = item.key;
+        for (int digit = 0; digit < 8; ++digit)
+            histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+    }
+
+    scratch.resize(count);
+    Item *source = items.data();
+    Item *destination = scratch.data();
+    for (int digit = 0; digit < 8; ++digit)
+    {
+        uint32_t *histogram = histograms[digit];
+        // Every key has the same value here: the pass would copy the array unchanged
+        if (histogram[(source[0].key >> (digit * 8)) & 0xFF] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < 256; ++bucket)
+        {
+            uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Item &item = source[i];
+            destination[histogram[(item.key >> (digit * 8)) & 0xFF]++] = item;
+        }
+        std::swap(source, destination);
+    }
+
+    // An odd number of passes leaves the result in the scratch buffer
+    if (source != items.data())
+        items.swap(scratch);
+}
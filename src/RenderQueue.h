@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Draw submission order. Each draw is reduced to a 64-bit key and an index into the caller's
+// objects; sorting by key then groups the draws so state changes are minimal:
+//
+//   63..60  pass     (e.g. opaque geometry before loading placeholders)
+//   59..48  shader   (each program is bound once per pass)
+//   47..24  mesh     (each VAO is bound once per program)
+//   23..0   depth    (front to back within a mesh, for early depth rejection)
+//
+// Fields wider than their bits are truncated, which only costs ordering, never correctness.
+class RenderQueue
+{
+public:
+    struct Item
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    enum Pass : uint32_t
+    {
+        PASS_OPAQUE = 0,
+        PASS_PLACEHOLDER = 1, // Wireframe bounds of meshes still streaming
+    };
+
+    // 'depth' is the view distance normalized to [0, 1]; values outside are clamped
+    static uint64_t MakeKey(uint32_t pass, uint32_t shader, uint32_t mesh, float depth);
+
+    void Clear() { items.clear(); }
+    void Reserve(size_t count) { items.reserve(count); }
+    void Push(uint64_t key, uint32_t index) { items.push_back({key, index}); }
+
+    // Stable LSD radix sort, 8 bits per pass. Digits shared by every key (typically the pass and
+    // the high shader and mesh bits) are skipped, so a frame usually takes 4-5 passes, not 8.
+    void Sort();
+
+    const std::vector<Item> &Items() const { return items; }
+    size_t Size() const { return items.size(); }
+
+private:
+    std::vector<Item> items;
+    std::vector<Item> scratch;
+};
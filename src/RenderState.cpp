@@ -0,0 +1,202 @@
+#include "RenderState.h"
+
+namespace
+{
+    const GLuint UNKNOWN = 0xFFFFFFFF; // Never a valid object name, so the next bind is always issued
+    const int MAX_TRACKED_UNITS = 16;
+
+    // Texture targets with a cached binding per unit; others are always issued
+    const GLenum TRACKED_TARGETS[] = {GL_TEXTURE_2D, GL_TEXTURE_BUFFER};
+    const int TRACKED_TARGET_COUNT = sizeof(TRACKED_TARGETS) / sizeof(TRACKED_TARGETS[0]);
+
+    const GLenum TRACKED_CAPABILITIES[] = {GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_STENCIL_TEST, GL_SCISSOR_TEST};
+    const int TRACKED_CAPABILITY_COUNT = sizeof(TRACKED_CAPABILITIES) / sizeof(TRACKED_CAPABILITIES[0]);
+
+    struct State
+    {
+        GLuint program;
+        GLuint vertexArray;
+        GLuint activeUnit;
+        GLuint textures[MAX_TRACKED_UNITS][TRACKED_TARGET_COUNT];
+        GLuint readFramebuffer;
+        GLuint drawFramebuffer;
+        GLuint capabilities[TRACKED_CAPABILITY_COUNT]; // UNKNOWN, GL_FALSE or GL_TRUE
+        GLuint polygonMode;
+    };
+
+    void Forget(State &state)
+    {
+        state.program = state.vertexArray = state.activeUnit = UNKNOWN;
+        for (auto &unit : state.textures)
+            for (GLuint &texture : unit)
+                texture = UNKNOWN;
+        state.readFramebuffer = state.drawFramebuffer = UNKNOWN;
+        for (GLuint &capability : state.capabilities)
+            capability = UNKNOWN;
+        state.polygonMode = UNKNOWN;
+    }
+
+    State &Current()
+    {
+        static State state = []()
+        {
+            State initial;
+            Forget(initial);
+            return initial;
+        }();
+        return state;
+    }
+
+    RenderStateStats stats;
+
+    // Updates 'cached' and returns true if the call has to reach the driver
+    bool Change(GLuint &cached, GLuint value)
+    {
+        if (cached == value)
+        {
+            stats.elided++;
+            return false;
+        }
+        cached = value;
+        stats.issued++;
+        return true;
+    }
+
+    int TargetSlot(GLenum target)
+    {
+        for (int i = 0; i < TRACKED_TARGET_COUNT; ++i)
+            if (TRACKED_TARGETS[i] == target)
+                return i;
+        return -1;
+    }
+
+    int CapabilitySlot(GLenum capability)
+    {
+        for (int i = 0; i < TRACKED_CAPABILITY_COUNT; ++i)
+            if (TRACKED_CAPABILITIES[i] == capability)
+                return i;
+        return -1;
+    }
+
+    void ActiveUnit(GLuint unit)
+    {
+        if (Change(Current().activeUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+void RenderState::UseProgram(GLuint program)
+{
+    if (Change(Current().program, program))
+        glUseProgram(program);
+}
+
+void RenderState::BindVertexArray(GLuint vao)
+{
+    if (Change(Current().vertexArray, vao))
+        glBindVertexArray(vao);
+}
+
+void RenderState::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    int slot = TargetSlot(target);
+    if (unit >= MAX_TRACKED_UNITS || slot < 0)
+    {
+        // Untracked: issue unconditionally and forget the unit selection it implies
+        Current().activeUnit = UNKNOWN;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        stats.issued += 2;
+        return;
+    }
+
+    GLuint &cached = Current().textures[unit][slot];
+    if (cached == texture)
+    {
+        stats.elided++;
+        return;
+    }
+    ActiveUnit(unit);
+    Change(cached, texture);
+    glBindTexture(target, texture);
+}
+
+void RenderState::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    State &state = Current();
+    if (target == GL_READ_FRAMEBUFFER)
+    {
+        if (Change(state.readFramebuffer, framebuffer))
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    }
+    else if (target == GL_DRAW_FRAMEBUFFER)
+    {
+        if (Change(state.drawFramebuffer, framebuffer))
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    }
+    else if (state.readFramebuffer != framebuffer || state.drawFramebuffer != framebuffer)
+    {
+        state.readFramebuffer = state.drawFramebuffer = framebuffer;
+        stats.issued++;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+    else
+    {
+        stats.elided++;
+    }
+}
+
+void RenderState::SetEnabled(GLenum capability, bool enabled)
+{
+    int slot = CapabilitySlot(capability);
+    if (slot >= 0 && !Change(Current().capabilities[slot], enabled ? GL_TRUE : GL_FALSE))
+        return;
+    if (slot < 0)
+        stats.issued++;
+
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+void RenderState::SetPolygonMode(GLenum mode)
+{
+    if (Change(Current().polygonMode, mode))
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void RenderState::OnDeleteVertexArray(GLuint vao)
+{
+    if (Current().vertexArray == vao)
+        Current().vertexArray = 0;
+}
+
+void RenderState::OnDeleteTexture(GLuint texture)
+{
+    for (auto &unit : Current().textures)
+        for (GLuint &bound : unit)
+            if (bound == texture)
+                bound = 0;
+}
+
+void RenderState::OnDeleteFramebuffer(GLuint framebuffer)
+{
+    State &state = Current();
+    if (state.readFramebuffer == framebuffer)
+        state.readFramebuffer = 0;
+    if (state.drawFramebuffer == framebuffer)
+        state.drawFramebuffer = 0;
+}
+
+void RenderState::Invalidate()
+{
+    Forget(Current());
+}
+
+RenderStateStats RenderState::EndFrameStats()
+{
+    RenderStateStats frame = stats;
+    stats = RenderStateStats();
+    return frame;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// Per-frame counters of state-changing GL calls routed through RenderState
+struct RenderStateStats
+{
+    unsigned int issued = 0; // Reached the driver
+    unsigned int elided = 0; // Skipped because the state was already current
+};
+
+// Thin cache of the GL binding and enable state the renderer changes most often: program, VAO,
+// textures per unit, framebuffers, polygon mode and a few capabilities. Every setter compares
+// against the last value it issued and skips the driver call when nothing changes, which keeps
+// per-object draw loops from paying for redundant binds.
+// Only calls made through here are tracked: code that changes the same state directly (e.g. a UI
+// backend) must call Invalidate afterwards. Single GL context, GL thread only.
+namespace RenderState
+{
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vao);
+    // Binds 'texture' to 'target' on texture unit 'unit' (0-based), selecting the unit only if needed
+    void BindTexture(GLuint unit, GLenum target, GLuint texture);
+    // GL_FRAMEBUFFER sets both the read and the draw binding
+    void BindFramebuffer(GLenum target, GLuint framebuffer);
+    void SetEnabled(GLenum capability, bool enabled);
+    void SetPolygonMode(GLenum mode); // GL_FRONT_AND_BACK
+
+    // Deleted objects are unbound by GL, so the cache has to forget them too
+    void OnDeleteVertexArray(GLuint vao);
+    void OnDeleteTexture(GLuint texture);
+    void OnDeleteFramebuffer(GLuint framebuffer);
+
+    // Forgets everything; the next call of each setter always reaches the driver
+    void Invalidate();
+
+    // Returns the counters collected since the previous call and resets them; call once per frame
+    RenderStateStats EndFrameStats();
+}
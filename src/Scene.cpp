@@ -1,13 +1,39 @@
 #include "Scene.h"
+#include "cubeGenerator.h"
+#include "RenderState.h"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstddef>
 #include <iostream>
+#include <limits>
+
+namespace
+{
+    // Uniforms set every frame, resolved once (see Shader::Uniform)
+    const UniformId UNIFORM_USE_OBJECT_COLOR = Shader::Uniform("useObjectColor");
+    const UniformId UNIFORM_OBJECT_COLOR = Shader::Uniform("objectColor");
+    const UniformId UNIFORM_DISPLAY_MODE = Shader::Uniform("displayMode");
+    const UniformId UNIFORM_ARENA_DRAW = Shader::Uniform("arenaDraw");
+    const UniformId UNIFORM_PACKED_VERTICES = Shader::Uniform("packedVertices");
+    const UniformId UNIFORM_CLUSTERED_LIGHTING = Shader::Uniform("clusteredLighting");
+    const UniformId UNIFORM_LIGHT_VOLUMES = Shader::Uniform("lightVolumes");
+    const UniformId UNIFORM_CLUSTER_SLICES = Shader::Uniform("clusterSlices");
+    const UniformId UNIFORM_RENDER_SCALE = Shader::Uniform("renderScale");
+}
 
 Scene::Scene(int width, int height)
-    : scrWidth(width), scrHeight(height), activeCamera(nullptr), quadVAO(0), gBufferShader(nullptr), lightingPassShader(nullptr)
+    : scrWidth(width), scrHeight(height), renderWidth(width), renderHeight(height), activeCamera(nullptr), quadVAO(0), gBufferShader(nullptr), lightingPassShader(nullptr)
 {
     InitGBuffer();
     InitQuad();
+    InitFrameData();
     // Create default camera
+
+    std::vector<Vertex> boxV;
+    std::vector<unsigned int> boxI;
+    generateCube(1.0f, boxV, boxI);
+    placeholderBox = new SceneObject(boxV, boxI);
 }
 
 Scene::~Scene()
@@ -20,10 +46,12 @@ Scene::~Scene()
     {
         delete light;
     }
-    for (auto &obj : objects)
+    for (SceneObject *shape : objects.shapes)
     {
-        delete obj.shape;
+        delete shape;
     }
+    delete placeholderBox;
+    glDeleteBuffers(1, &frameDataUBO);
 }
 
 void Scene::AddCamera(Camera *camera)
@@ -48,173 +76,991 @@ void Scene::AddLight(Light *light)
     lights.push_back(light);
 }
 
+bool Scene::RemoveLight(Light *light)
+{
+    auto it = std::find(lights.begin(), lights.end(), light);
+    if (it == lights.end())
+        return false;
+    lights.erase(it);
+    std::erase_if(lightAttachments, [&](const LightAttachment &attachment)
+    {
+        if (attachment.light != light)
+            return false;
+        transforms.Destroy(attachment.node);
+        return true;
+    });
+    delete light;
+    return true;
+}
+
 void Scene::AddShape(SceneObject *shape, Shader *shader)
 {
-    objects.push_back({shape, shader});
+    shader->bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    shader->use();
+    shader->setInt("drawData", ARENA_DRAW_DATA_UNIT);
+    objects.Create(shape, shader);
+}
+
+bool Scene::RemoveShape(SceneObject *shape)
+{
+    uint32_t index = IndexOf(shape);
+    if (index == ObjectStore::INVALID_INDEX)
+        return false;
+
+    // Attached lights and cameras stay where they are, detached
+    TransformHierarchy::NodeId node = objects.nodes[index];
+    auto attachedHere = [&](TransformHierarchy::NodeId attachment)
+    {
+        if (transforms.GetParent(attachment) != node)
+            return false;
+        transforms.Destroy(attachment);
+        return true;
+    };
+    std::erase_if(lightAttachments, [&](const LightAttachment &attachment) { return attachedHere(attachment.node); });
+    std::erase_if(cameraAttachments, [&](const CameraAttachment &attachment) { return attachedHere(attachment.node); });
+    std::erase_if(pendingUploads, [&](const PendingUpload &upload) { return upload.target == shape; });
+
+    if (objects.bvhProxies[index] != DynamicBvh::NULL_NODE)
+        bvh.Remove(objects.bvhProxies[index]);
+    objects.Destroy(objects.handles[index]);
+    delete shape;
+    return true;
+}
+
+uint32_t Scene::IndexOf(const SceneObject *shape) const
+{
+    if (!shape || shape->GetStore() != &objects)
+        return ObjectStore::INVALID_INDEX;
+    return objects.IndexOf(shape->GetStoreHandle());
+}
+
+void Scene::SetParent(SceneObject *child, SceneObject *parent)
+{
+    uint32_t childIndex = IndexOf(child);
+    uint32_t parentIndex = parent ? IndexOf(parent) : ObjectStore::INVALID_INDEX;
+    if (childIndex == ObjectStore::INVALID_INDEX || (parent && parentIndex == ObjectStore::INVALID_INDEX))
+    {
+        std::cerr << "Scene::SetParent: object not in the scene" << std::endl;
+        return;
+    }
+    TransformHierarchy::NodeId parentNode = parent ? objects.nodes[parentIndex] : TransformHierarchy::NULL_NODE;
+    if (!transforms.SetParent(objects.nodes[childIndex], parentNode))
+        std::cerr << "Scene::SetParent: parenting would create a cycle" << std::endl;
+}
+
+void Scene::AttachLight(Light *light, SceneObject *parent, const glm::vec3 &localPosition, const glm::vec3 &localDirection)
+{
+    uint32_t parentIndex = IndexOf(parent);
+    if (parentIndex == ObjectStore::INVALID_INDEX)
+    {
+        std::cerr << "Scene::AttachLight: parent not in the scene" << std::endl;
+        return;
+    }
+    TransformHierarchy::NodeId parentNode = objects.nodes[parentIndex];
+    auto it = std::find_if(lightAttachments.begin(), lightAttachments.end(),
+                           [&](const LightAttachment &attachment) { return attachment.light == light; });
+    if (it == lightAttachments.end())
+    {
+        lightAttachments.push_back({light, transforms.Create(parentNode), localDirection});
+        it = lightAttachments.end() - 1;
+    }
+    else if (transforms.GetParent(it->node) != parentNode)
+    {
+        transforms.SetParent(it->node, parentNode);
+    }
+    transforms.SetTranslation(it->node, localPosition);
+    it->direction = localDirection;
+}
+
+void Scene::AttachCamera(Camera *camera, SceneObject *parent, const glm::vec3 &localPosition, const glm::vec3 &localTarget)
+{
+    uint32_t parentIndex = IndexOf(parent);
+    if (parentIndex == ObjectStore::INVALID_INDEX)
+    {
+        std::cerr << "Scene::AttachCamera: parent not in the scene" << std::endl;
+        return;
+    }
+    TransformHierarchy::NodeId parentNode = objects.nodes[parentIndex];
+    auto it = std::find_if(cameraAttachments.begin(), cameraAttachments.end(),
+                           [&](const CameraAttachment &attachment) { return attachment.camera == camera; });
+    if (it == cameraAttachments.end())
+    {
+        cameraAttachments.push_back({camera, transforms.Create(parentNode), localTarget});
+        it = cameraAttachments.end() - 1;
+    }
+    else if (transforms.GetParent(it->node) != parentNode)
+    {
+        transforms.SetParent(it->node, parentNode);
+    }
+    transforms.SetTranslation(it->node, localPosition);
+    it->target = localTarget;
+}
+
+const glm::mat4 &Scene::GetWorldMatrix(const SceneObject *shape) const
+{
+    static const glm::mat4 identity(1.0f);
+    uint32_t index = IndexOf(shape);
+    return index != ObjectStore::INVALID_INDEX ? transforms.GetWorld(objects.nodes[index]) : identity;
+}
+
+void Scene::UpdateTransforms()
+{
+    // Object setters write their local transforms straight into the hierarchy (see ObjectStore)
+    transforms.Update();
+
+    // Attachments are few, so they are refreshed every frame; this also undoes free-look moves of attached cameras
+    for (const LightAttachment &attachment : lightAttachments)
+    {
+        const glm::mat4 &world = transforms.GetWorld(attachment.node);
+        glm::vec3 position(world[3]);
+        glm::vec3 direction = glm::normalize(glm::mat3(world) * attachment.direction);
+        switch (attachment.light->GetType())
+        {
+        case LightType::DIRECTIONAL:
+            static_cast<DirectionalLight *>(attachment.light)->direction = direction;
+            break;
+        case LightType::POINT:
+            static_cast<PointLight *>(attachment.light)->position = position;
+            break;
+        case LightType::SPOT:
+            static_cast<SpotLight *>(attachment.light)->position = position;
+            static_cast<SpotLight *>(attachment.light)->direction = direction;
+            break;
+        }
+    }
+    for (const CameraAttachment &attachment : cameraAttachments)
+    {
+        const glm::mat4 &world = transforms.GetWorld(attachment.node);
+        attachment.camera->Position = glm::vec3(world[3]);
+        // The target is in the parent's space, like the position
+        const glm::mat4 &parentWorld = transforms.GetWorld(transforms.GetParent(attachment.node));
+        attachment.camera->LookAt(glm::vec3(parentWorld * glm::vec4(attachment.target, 1.0f)));
+    }
+}
+
+SceneObject *Scene::AddShapeAsync(AsyncMesh mesh, Shader *shader)
+{
+    SceneObject *shape = new SceneObject();
+    AddShape(shape, shader);
+
+    PendingUpload upload;
+    upload.target = shape;
+    upload.bounds = std::move(mesh.bounds);
+    upload.future = std::move(mesh.mesh);
+    pendingUploads.push_back(std::move(upload));
+    return shape;
+}
+
+void Scene::InitFrameData()
+{
+    glGenBuffers(1, &frameDataUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameDataUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, frameDataUBO);
+}
+
+void Scene::UpdateFrameData(const glm::mat4 &view, const glm::mat4 &projection)
+{
+    FrameData data;
+    data.projection = projection;
+    data.view = view;
+    data.inverseProjection = glm::inverse(projection);
+    data.fogColor = glm::vec4(fogColor, 1.0f);
+    data.fogParams = glm::vec4(fogStart, fogEnd, fogEnabled ? 1.0f : 0.0f, 0.0f);
+
+    // With more lights than fit, keep the ones reaching closest to the camera: directional lights, then point
+    // and spot lights by how far the camera is outside their range. They are picked before grouping by type,
+    // so a crowd of one type cannot push out the others just by coming first.
+    std::vector<GpuLight> packed(lights.size());
+    std::vector<uint32_t> order(lights.size());
+    std::vector<float> reach(lights.size());
+    for (size_t i = 0; i < lights.size(); ++i)
+    {
+        lights[i]->WriteViewSpace(packed[i], view);
+        order[i] = (uint32_t)i;
+        reach[i] = lights[i]->GetType() == LightType::DIRECTIONAL
+                       ? -std::numeric_limits<float>::infinity()
+                       : glm::length(glm::vec3(packed[i].positionType)) - packed[i].attenuation.w;
+    }
+    int count = (int)std::min(lights.size(), (size_t)MAX_FRAME_LIGHTS);
+    if (lights.size() > (size_t)MAX_FRAME_LIGHTS)
+    {
+        std::partial_sort(order.begin(), order.begin() + count, order.end(), [&](uint32_t a, uint32_t b)
+                          { return reach[a] != reach[b] ? reach[a] < reach[b] : a < b; });
+    }
+
+    // Grouped by type (directional, point, spot) so specialized shaders can loop over each type separately
+    std::sort(order.begin(), order.begin() + count, [&](uint32_t a, uint32_t b)
+              { return lights[a]->GetType() != lights[b]->GetType() ? lights[a]->GetType() < lights[b]->GetType() : a < b; });
+    glm::ivec3 typeCounts(0);
+    for (int i = 0; i < count; ++i)
+    {
+        data.lights[i] = packed[order[i]];
+        typeCounts[(int)lights[order[i]]->GetType()]++;
+    }
+    data.lightCount = glm::ivec4(count, typeCounts);
+    frameLightTypeCounts = typeCounts;
+
+    // One update for everything the shaders need this frame; only the used part of the light array is sent
+    size_t size = offsetof(FrameData, lights) + count * sizeof(GpuLight);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameDataUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Scene::ProcessUploads()
+{
+    // Upload at most 'uploadBudgetBytes' per frame so streaming never blows the frame budget
+    size_t budget = uploadBudgetBytes;
+    auto it = pendingUploads.begin();
+    while (it != pendingUploads.end() && budget > 0)
+    {
+        PendingUpload &upload = *it;
+        // The bounds arrive before the mesh and let the placeholder show while it parses
+        if (upload.bounds.valid() && upload.bounds.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            try
+            {
+                MeshBounds bounds = upload.bounds.get();
+                upload.target->SetBounds(bounds.min, bounds.max, bounds.radius);
+            }
+            catch (const std::exception &)
+            {
+                // Loading failed; reported with the mesh below
+            }
+        }
+        if (!upload.mesh)
+        {
+            if (upload.future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++it;
+                continue;
+            }
+            try
+            {
+                upload.mesh = upload.future.get();
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Failed to load mesh: " << e.what() << std::endl;
+            }
+            if (!upload.mesh)
+            {
+                // The object stays in the scene, flagged and without bounds, so it is never drawn
+                uint32_t index = IndexOf(upload.target);
+                if (objects.bvhProxies[index] != DynamicBvh::NULL_NODE)
+                {
+                    bvh.Remove(objects.bvhProxies[index]);
+                    objects.bvhProxies[index] = DynamicBvh::NULL_NODE;
+                }
+                upload.target->MarkLoadFailed();
+                failedLoadCount++;
+                it = pendingUploads.erase(it);
+                continue;
+            }
+            upload.target->SetBounds(upload.mesh->boundsMin, upload.mesh->boundsMax, upload.mesh->boundsRadius);
+            upload.target->SetLods(upload.mesh->lods, upload.mesh->subMeshes);
+            if (!upload.mesh->packed.vertices.empty())
+                upload.target->SetPackedFormat(upload.mesh->packed);
+            upload.target->AllocateBuffers(upload.mesh->vertexCount, upload.mesh->indexCount);
+        }
+
+        const LoadedMesh &mesh = *upload.mesh;
+        bool packed = !mesh.packed.vertices.empty();
+        if (upload.verticesUploaded < mesh.vertexCount)
+        {
+            size_t stride = packed ? sizeof(PackedVertex) + (mesh.packed.colors.empty() ? 0 : sizeof(uint32_t)) : sizeof(Vertex);
+            size_t count = std::min(mesh.vertexCount - upload.verticesUploaded, std::max<size_t>(1, budget / stride));
+            if (packed)
+                upload.target->UploadVertices(mesh.packed, upload.verticesUploaded, count);
+            else
+                upload.target->UploadVertices(mesh.vertices, upload.verticesUploaded, count);
+            upload.verticesUploaded += count;
+            budget -= std::min(budget, count * stride);
+        }
+        if (upload.verticesUploaded == mesh.vertexCount && upload.indicesUploaded < mesh.indexCount && budget > 0)
+        {
+            size_t indexSize = upload.target->IndexSize();
+            size_t count = std::min(mesh.indexCount - upload.indicesUploaded, std::max<size_t>(1, budget / indexSize));
+            upload.target->UploadIndices(mesh.indices, upload.indicesUploaded, count);
+            upload.indicesUploaded += count;
+            budget -= std::min(budget, count * indexSize);
+        }
+
+        if (upload.verticesUploaded == mesh.vertexCount && upload.indicesUploaded == mesh.indexCount)
+        {
+            upload.target->MarkResident();
+            it = pendingUploads.erase(it); // Frees the CPU copy / unmaps the cache file
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void Scene::CullObjects(const glm::mat4 &projectionView)
+{
+    // World matrices come from the transform hierarchy and are reused by the LOD selection and every pass.
+    // The BVH follows every object; moves within a leaf's margin cost no tree update, and objects whose
+    // world matrix and bounds did not change skip even the bounds transform.
+    const size_t count = objects.Size();
+    size_t boundedCount = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        TransformHierarchy::NodeId node = objects.nodes[i];
+        uint8_t &flags = objects.flags[i];
+        flags |= ObjectStore::FLAG_VISIBLE;
+        objects.models[i] = transforms.GetWorld(node);
+        // Objects without bounds yet (still loading) are not in the BVH and are always submitted
+        if (!(flags & ObjectStore::FLAG_HAS_BOUNDS))
+            continue;
+        boundedCount++;
+        int32_t &proxy = objects.bvhProxies[i];
+        if (proxy != DynamicBvh::NULL_NODE && !(flags & ObjectStore::FLAG_BOUNDS_DIRTY) && !transforms.IsChanged(node))
+            continue;
+
+        flags &= ~ObjectStore::FLAG_BOUNDS_DIRTY;
+        objects.worldBounds[i] = objects.localBounds[i].Transformed(objects.models[i]);
+        if (proxy == DynamicBvh::NULL_NODE)
+            proxy = bvh.Insert(objects.worldBounds[i], objects.handles[i].value);
+        else
+            bvh.Update(proxy, objects.worldBounds[i]);
+    }
+
+    if (!frustumCulling)
+    {
+        culledCount = 0;
+        visibleCount = count;
+        return;
+    }
+
+    Frustum frustum = Frustum::FromMatrix(projectionView);
+    size_t visible = 0;
+    if (useBvhCulling)
+    {
+        // Conservative: leaves are tested with their fat boxes
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (objects.bvhProxies[i] != DynamicBvh::NULL_NODE)
+                objects.flags[i] &= ~ObjectStore::FLAG_VISIBLE;
+        }
+        bvh.QueryFrustum(frustum, [&](uint32_t handle)
+        {
+            objects.flags[objects.IndexOf(ObjectHandle(handle))] |= ObjectStore::FLAG_VISIBLE;
+            visible++;
+        });
+    }
+    else
+    {
+        cullingBounds.Clear();
+        cullingIndices.clear();
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (objects.bvhProxies[i] == DynamicBvh::NULL_NODE)
+                continue;
+            cullingBounds.Add(objects.models[i], objects.localBounds[i], objects.boundsRadii[i]);
+            cullingIndices.push_back((uint32_t)i);
+        }
+
+        cullingVisibility.resize(cullingIndices.size());
+        visible = Culling::Cull(frustum, cullingBounds, cullingVisibility.data());
+        for (size_t i = 0; i < cullingIndices.size(); ++i)
+        {
+            if (!cullingVisibility[i])
+                objects.flags[cullingIndices[i]] &= ~ObjectStore::FLAG_VISIBLE;
+        }
+    }
+
+    culledCount = boundedCount - visible;
+    visibleCount = count - culledCount;
+}
+
+void Scene::QueryObjects(const Aabb &bounds, std::vector<SceneObject *> &result) const
+{
+    bvh.QueryAabb(bounds, [&](uint32_t handle)
+    {
+        uint32_t index = objects.IndexOf(ObjectHandle(handle));
+        if (objects.worldBounds[index].Overlaps(bounds))
+            result.push_back(objects.shapes[index]);
+    });
+}
+
+void Scene::QueryObjects(const glm::vec3 &center, float radius, std::vector<SceneObject *> &result) const
+{
+    bvh.QuerySphere(center, radius, [&](uint32_t handle)
+    {
+        uint32_t index = objects.IndexOf(ObjectHandle(handle));
+        const Aabb &box = objects.worldBounds[index];
+        glm::vec3 offset = center - glm::clamp(center, box.min, box.max);
+        if (glm::dot(offset, offset) <= radius * radius)
+            result.push_back(objects.shapes[index]);
+    });
+}
+
+SceneObject *Scene::Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float *distance) const
+{
+    glm::vec3 inverseDirection = 1.0f / direction;
+    SceneObject *hit = nullptr;
+    float nearest = 0.0f;
+    bvh.Raycast(origin, direction, std::numeric_limits<float>::max(), [&](uint32_t handle, float &maxDistance)
+    {
+        uint32_t index = objects.IndexOf(ObjectHandle(handle));
+        float t = objects.worldBounds[index].Intersect(origin, inverseDirection, maxDistance);
+        if (t < 0.0f)
+            return;
+        hit = objects.shapes[index];
+        nearest = t;
+        maxDistance = t;
+    });
+    if (hit && distance)
+        *distance = nearest;
+    return hit;
+}
+
+void Scene::SelectLods(const glm::mat4 &view)
+{
+    // Pixels covered by one world unit at distance 1 (perspective) or anywhere (orthographic), at the
+    // resolution the geometry is rendered at
+    bool perspective = activeCamera->Type == ProjectionType::Perspective;
+    float pixelsPerUnit = perspective
+                              ? (float)renderHeight / (2.0f * std::tan(glm::radians(activeCamera->Zoom) * 0.5f))
+                              : (float)renderHeight / activeCamera->OrthoHeight;
+
+    for (size_t i = 0; i < objects.Size(); ++i)
+    {
+        int lodCount = objects.lodCounts[i];
+        uint8_t flags = objects.flags[i];
+        if (!lodEnabled || lodCount == 1 || !(flags & ObjectStore::FLAG_HAS_BOUNDS))
+        {
+            objects.lods[i] = 0;
+            continue;
+        }
+        if (!(flags & ObjectStore::FLAG_VISIBLE))
+            continue; // Keeps its last LOD
+
+        // Bounding sphere in view space; the error scales with the largest axis scale of the model matrix
+        const glm::mat4 &model = objects.models[i];
+        float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])),
+                                glm::length(glm::vec3(model[2]))});
+        glm::vec3 center = glm::vec3(view * model * glm::vec4(objects.localBounds[i].Center(), 1.0f));
+        float radius = objects.boundsRadii[i] * scale;
+
+        // Use the nearest point of the sphere so large objects keep detail when the camera is close
+        float distance = perspective ? std::max(-center.z - radius, 0.1f) : 1.0f;
+        float pixelsPerError = scale * pixelsPerUnit / distance;
+
+        // Only the error table lives on the object
+        const SceneObject *shape = objects.shapes[i];
+        int lod = std::clamp(objects.lods[i], 0, lodCount - 1);
+        while (lod > 0 && shape->GetLodError(lod) * pixelsPerError > lodPixelError)
+            --lod;
+        while (lod + 1 < lodCount && shape->GetLodError(lod + 1) * pixelsPerError <= lodPixelError * lodHysteresis)
+            ++lod;
+        objects.lods[i] = lod;
+    }
+}
+
+void Scene::DrawObject(uint32_t index, Shader &shader)
+{
+    uint8_t flags = objects.flags[index];
+    if (flags & ObjectStore::FLAG_RESIDENT)
+    {
+        objects.shapes[index]->Draw(shader, objects.models[index], objects.lods[index]);
+        return;
+    }
+
+    if (!drawLoadingPlaceholders || !(flags & ObjectStore::FLAG_HAS_BOUNDS))
+        return;
+
+    // Still streaming: outline the mesh bounds with the unit cube
+    const Aabb &bounds = objects.localBounds[index];
+    glm::vec3 extent = glm::max(bounds.max - bounds.min, glm::vec3(1e-3f));
+    glm::mat4 model = glm::scale(glm::translate(objects.models[index], bounds.Center()), extent);
+
+    RenderState::SetPolygonMode(GL_LINE);
+    placeholderBox->Draw(shader, model);
+    RenderState::SetPolygonMode(GL_FILL);
+}
+
+void Scene::BuildRenderQueue(const glm::mat4 &view, const Shader *vertexColorShader, const Shader *objectColorShader)
+{
+    renderQueue.Clear();
+    renderQueue.Reserve(objects.Size());
+    for (uint32_t i = 0; i < objects.Size(); ++i)
+    {
+        uint8_t flags = objects.flags[i];
+        if (!(flags & ObjectStore::FLAG_VISIBLE))
+            continue;
+        if (!sortDraws)
+        {
+            renderQueue.Push(i, i);
+            continue;
+        }
+
+        const Shader *shader = objects.shaders[i];
+        if (vertexColorShader)
+            shader = objects.colors[i].w != 0.0f ? objectColorShader : vertexColorShader;
+        glm::vec3 center = flags & ObjectStore::FLAG_HAS_BOUNDS ? objects.worldBounds[i].Center() : glm::vec3(objects.models[i][3]);
+        // Depth keys span the camera's depth range
+        float depth = -(view * glm::vec4(center, 1.0f)).z / FAR_PLANE;
+
+        if (flags & ObjectStore::FLAG_RESIDENT)
+            renderQueue.Push(RenderQueue::MakeKey(RenderQueue::PASS_OPAQUE, shader->ID, objects.meshes[i], depth), i);
+        else
+            renderQueue.Push(RenderQueue::MakeKey(RenderQueue::PASS_PLACEHOLDER, shader->ID, 0, depth), i);
+    }
+    renderQueue.Sort();
+}
+
+bool Scene::AddToArenaBatch(uint32_t index)
+{
+    MeshArena::BatchDraw draw;
+    if (!batchArenaObjects || !(objects.flags[index] & ObjectStore::FLAG_IN_ARENA) ||
+        !objects.shapes[index]->GetArenaRange(objects.lods[index], draw.firstIndex, draw.indexCount, draw.baseVertex))
+        return false;
+    draw.model = objects.models[index];
+    draw.color = objects.colors[index];
+    arenaBatch.push_back(draw);
+    return true;
+}
+
+void Scene::DrawArenaBatch(Shader &shader)
+{
+    if (arenaBatch.empty())
+        return;
+    shader.use();
+    shader.setBool(UNIFORM_ARENA_DRAW, true);
+    shader.setBool(UNIFORM_PACKED_VERTICES, false);
+    // Colors are resolved per draw in the vertex shader
+    shader.setBool(UNIFORM_USE_OBJECT_COLOR, false);
+    arenaDrawCalls += meshArena.DrawBatch(arenaBatch);
+    arenaBatchedCount += arenaBatch.size();
+    shader.setBool(UNIFORM_ARENA_DRAW, false);
+    arenaBatch.clear();
+}
+
+bool Scene::ReadFrameQueries(int timer)
+{
+    if (lightingTimers[timer] == 0)
+    {
+        glGenQueries(2, lightingTimers);
+        glGenQueries(6, &fragmentQueries[0][0]);
+        glGenQueries(4, &frameTimestamps[0][0]);
+    }
+    if (!lightingTimerIssued[timer])
+        return false;
+    // The end timestamp is the last query of the frame, so the others are complete with it
+    GLint available = 0;
+    glGetQueryObjectiv(frameTimestamps[timer][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(lightingTimers[timer], GL_QUERY_RESULT, &elapsed);
+    lightingPassMs = (float)(elapsed / 1.0e6);
+    for (int i = 0; i < 3; ++i)
+    {
+        GLuint samples = 0;
+        glGetQueryObjectuiv(fragmentQueries[timer][i], GL_QUERY_RESULT, &samples);
+        shadedFragments[i] = samples;
+    }
+    GLuint64 start = 0, end = 0;
+    glGetQueryObjectui64v(frameTimestamps[timer][0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(frameTimestamps[timer][1], GL_QUERY_RESULT, &end);
+    gpuFrameMs = (float)((end - start) / 1.0e6);
+    return true;
 }
 
 void Scene::Draw()
 {
+    ProcessUploads();
+    UpdateTransforms();
+
     if (!activeCamera)
         return;
 
+    glm::mat4 projection = activeCamera->GetProjectionMatrix((float)scrWidth, (float)scrHeight);
+    glm::mat4 view = activeCamera->GetViewMatrix();
+
+    CullObjects(projection * view);
+
+    // Render size of this frame, which the LOD selection depends on. Only the deferred passes render below
+    // window size; the controller adjusts the scale from the GPU time of an earlier frame.
+    bool deferred = gBufferShader && lightingPassShader;
+    int timer = 0;
+    bool upscale = false;
+    renderWidth = scrWidth;
+    renderHeight = scrHeight;
+    if (deferred)
+    {
+        // Read back the timer and fragment queries issued two frames ago, which are normally complete by now
+        timer = lightingTimerFrame++ & 1;
+        bool frameTimed = ReadFrameQueries(timer);
+
+        bool scaling = upscaleShader != nullptr;
+        if (scaling && dynamicResolution)
+        {
+            if (!controllerActive)
+                resolutionController.Reset(renderScale);
+            else if (frameTimed)
+                resolutionController.Update(gpuFrameMs);
+            renderScale = resolutionController.GetScale();
+        }
+        controllerActive = scaling && dynamicResolution;
+        float scale = scaling ? std::clamp(renderScale, DynamicResolution::MIN_SCALE, DynamicResolution::MAX_SCALE) : 1.0f;
+        renderWidth = std::max(1, (int)std::lround(scrWidth * scale));
+        renderHeight = std::max(1, (int)std::lround(scrHeight * scale));
+        upscale = scaling && (dynamicResolution || renderWidth != scrWidth || renderHeight != scrHeight);
+    }
+
+    SelectLods(view);
+    UpdateFrameData(view, projection);
+    arenaBatchedCount = 0;
+    arenaDrawCalls = 0;
+
     // --- Deferred Shading ---
-    if (gBufferShader && lightingPassShader)
+    if (deferred)
     {
         // Save current clear color
         GLfloat clearColor[4];
         glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
 
+        if (upscale && !sceneFBO)
+            InitSceneTarget();
+        glm::vec2 renderScaleUV((float)renderWidth / scrWidth, (float)renderHeight / scrHeight);
+        glQueryCounter(frameTimestamps[timer][0], GL_TIMESTAMP);
+
         // 1. Geometry Pass: Render all geometric/color data to g-buffer
         // Clear g-buffer to black (0,0,0) so we can detect background (empty) pixels
+        // Stencil 1 marks the pixels with geometry, so the lighting passes skip the background
         glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        RenderState::BindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        glViewport(0, 0, renderWidth, renderHeight);
+        glStencilMask(0xFF);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        RenderState::SetEnabled(GL_STENCIL_TEST, true);
+        glStencilFunc(GL_ALWAYS, 1, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 
-        glm::mat4 projection = activeCamera->GetProjectionMatrix((float)scrWidth, (float)scrHeight);
-        glm::mat4 view = activeCamera->GetViewMatrix();
+        LightingMode mode = lightingMode;
+        if (mode == LightingMode::Volumes && !lightVolumeShader)
+            mode = LightingMode::FullScreen;
 
-        gBufferShader->use();
-        gBufferShader->setMat4("projection", projection);
-        gBufferShader->setMat4("view", view);
-
-        for (auto &obj : objects)
+        // Pick the permutations for this frame; until they are ready (or if they fail) both passes branch at runtime
+        Shader *vertexColorShader = gBufferShader;
+        Shader *objectColorShader = gBufferShader;
+        Shader *lightingShader = lightingPassShader;
+        bool specialized = false;
+        if (useShaderVariants && shaderManager)
         {
-            if (obj.shape->useObjectColor)
+            ShaderDefines lightingDefines;
+            lightingDefines.Set("DISPLAY_MODE", gBufferDisplayMode);
+            // Debug views ignore lights and fog, so they share one variant per mode
+            // Clustered and light volume variants do not depend on the point and spot light counts
+            bool lit = gBufferDisplayMode == 0;
+            bool fullScreen = lit && mode == LightingMode::FullScreen;
+            lightingDefines.Set("FOG_ENABLED", lit && fogEnabled ? 1 : 0)
+                .Set("CLUSTERED", lit && mode == LightingMode::Clustered ? 1 : 0)
+                .Set("LIGHT_VOLUMES", lit && mode == LightingMode::Volumes ? 1 : 0);
+            // Past MAX_FRAME_LIGHTS the full-screen counts follow the lights nearest the camera, which would
+            // compile a new variant as it moves; the light loop then stays dynamic instead
+            if (!fullScreen || lights.size() <= (size_t)MAX_FRAME_LIGHTS)
             {
-                gBufferShader->setBool("useObjectColor", true);
-                gBufferShader->setVec3("objectColor", obj.shape->objectColor);
+                lightingDefines.Set("NUM_DIR_LIGHTS", lit ? frameLightTypeCounts.x : 0)
+                    .Set("NUM_POINT_LIGHTS", fullScreen ? frameLightTypeCounts.y : 0)
+                    .Set("NUM_SPOT_LIGHTS", fullScreen ? frameLightTypeCounts.z : 0);
             }
-            else
+
+            Shader *vertexColor = shaderManager->GetVariant(gBufferVariantName, ShaderDefines().Set("OBJECT_COLOR", 0));
+            Shader *objectColor = shaderManager->GetVariant(gBufferVariantName, ShaderDefines().Set("OBJECT_COLOR", 1));
+            Shader *lighting = shaderManager->GetVariant(lightingVariantName, lightingDefines);
+            if (VariantUsable(vertexColor) && VariantUsable(objectColor) && VariantUsable(lighting))
             {
-                gBufferShader->setBool("useObjectColor", false);
+                PrepareDeferredShader(*vertexColor, false);
+                PrepareDeferredShader(*objectColor, false);
+                PrepareDeferredShader(*lighting, true);
+                vertexColorShader = vertexColor;
+                objectColorShader = objectColor;
+                lightingShader = lighting;
+                specialized = true;
             }
-            obj.shape->Draw(*gBufferShader);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        // 2. Lighting Pass: Calculate lighting by iterating over screen filled quad
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]); // Restore clear color
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        lightingPassShader->use();
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gPosition);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gNormal);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-
-        // Lighting
-        lightingPassShader->setInt("numLights", (int)lights.size());
-        for (size_t i = 0; i < lights.size(); ++i)
+        // Arena objects go in one batch through the vertex color program, which then picks
+        // each object's color from its draw data
+        BuildRenderQueue(view, vertexColorShader, objectColorShader);
+        Shader *current = nullptr;
+        for (const RenderQueue::Item &item : renderQueue.Items())
         {
-            lights[i]->SetUniformsViewSpace(*lightingPassShader, (int)i, view);
+            uint32_t index = item.index;
+            if (AddToArenaBatch(index))
+                continue;
+            const glm::vec4 &color = objects.colors[index];
+            bool useObjectColor = color.w != 0.0f;
+            Shader *shader = useObjectColor ? objectColorShader : vertexColorShader;
+            if (shader != current)
+            {
+                shader->use();
+                current = shader;
+            }
+            if (!specialized)
+                shader->setBool(UNIFORM_USE_OBJECT_COLOR, useObjectColor);
+            if (useObjectColor)
+                shader->setVec3(UNIFORM_OBJECT_COLOR, glm::vec3(color));
+            DrawObject(index, *shader);
         }
+        DrawArenaBatch(*vertexColorShader);
+        RenderState::SetEnabled(GL_STENCIL_TEST, false);
+        RenderState::BindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        // Fog
-        lightingPassShader->setBool("fogEnabled", fogEnabled);
-        lightingPassShader->setVec3("fogColor", fogColor);
-        lightingPassShader->setFloat("fogStart", fogStart);
-        lightingPassShader->setFloat("fogEnd", fogEnd);
+        // 2. Lighting Pass: Calculate lighting by iterating over screen filled quad.
+        // The G-buffer depth and stencil are copied first: the stencil keeps both lighting steps off the
+        // background, and light volumes test against the depth.
+        // Below window size the pass writes to the scene target, which is upscaled onto the window afterwards.
+        bool lit = gBufferDisplayMode == 0;
+        unsigned int lightingTarget = upscale ? sceneFBO : 0;
+        RenderState::BindFramebuffer(GL_FRAMEBUFFER, lightingTarget);
+        glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]); // Restore clear color
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        RenderState::BindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+        RenderState::BindFramebuffer(GL_FRAMEBUFFER, lightingTarget);
+        lightingShader->use();
+        lightingShader->setVec2(UNIFORM_RENDER_SCALE, renderScaleUV);
+
+        RenderState::BindTexture(0, GL_TEXTURE_2D, gDepth);
+        RenderState::BindTexture(1, GL_TEXTURE_2D, gNormal);
+        RenderState::BindTexture(2, GL_TEXTURE_2D, gAlbedoSpec);
+
+        // Lights and fog come from the FrameData block, point and spot lights from the clusters when enabled
+        bool clustered = lit && mode == LightingMode::Clustered;
+        bool volumes = lit && mode == LightingMode::Volumes;
+        if (clustered)
+        {
+            auto assignStart = std::chrono::steady_clock::now();
+            lightClusters.Build(lights, view, projection, NEAR_PLANE, FAR_PLANE);
+            lightAssignMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - assignStart).count();
+            lightClusters.Upload();
+            lightingShader->setVec2(UNIFORM_CLUSTER_SLICES, lightClusters.GetSliceParams());
+        }
+        if (!specialized)
+        {
+            lightingShader->setInt(UNIFORM_DISPLAY_MODE, gBufferDisplayMode);
+            lightingShader->setBool(UNIFORM_CLUSTERED_LIGHTING, clustered);
+            lightingShader->setBool(UNIFORM_LIGHT_VOLUMES, volumes);
+        }
 
-        lightingPassShader->setInt("displayMode", gBufferDisplayMode);
+        // Time the pass and count its fragments
+        glBeginQuery(GL_TIME_ELAPSED, lightingTimers[timer]);
 
+        // The quad must not test against or overwrite the copied depth
+        RenderState::SetEnabled(GL_DEPTH_TEST, false);
+        RenderState::SetEnabled(GL_STENCIL_TEST, lit);
+        glStencilFunc(GL_EQUAL, 1, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        glBeginQuery(GL_SAMPLES_PASSED, fragmentQueries[timer][0]);
         RenderQuad();
+        glEndQuery(GL_SAMPLES_PASSED);
 
-        // 2.5. Copy depth buffer to default framebuffer
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-        glBlitFramebuffer(0, 0, scrWidth, scrHeight, 0, 0, scrWidth, scrHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // Light volumes, added on top: back faces pass where the G-buffer surface is in front of them,
+        // and depth clamping keeps volumes crossing the far plane whole
+        if (volumes)
+        {
+            lightVolumes.Update(lights, view, FAR_PLANE);
+            lightVolumeShader->use();
+            lightVolumeShader->setVec2(UNIFORM_RENDER_SCALE, renderScaleUV);
+            RenderState::SetEnabled(GL_DEPTH_TEST, true);
+            RenderState::SetEnabled(GL_BLEND, true);
+            RenderState::SetEnabled(GL_CULL_FACE, true);
+            RenderState::SetEnabled(GL_DEPTH_CLAMP, true);
+            glDepthMask(GL_FALSE);
+            glDepthFunc(GL_GEQUAL);
+            glBlendFunc(GL_ONE, GL_ONE);
+            glCullFace(GL_FRONT);
+        }
+        glBeginQuery(GL_SAMPLES_PASSED, fragmentQueries[timer][1]);
+        if (volumes)
+            lightVolumes.DrawPointLights(*lightVolumeShader);
+        glEndQuery(GL_SAMPLES_PASSED);
+        glBeginQuery(GL_SAMPLES_PASSED, fragmentQueries[timer][2]);
+        if (volumes)
+            lightVolumes.DrawSpotLights(*lightVolumeShader);
+        glEndQuery(GL_SAMPLES_PASSED);
+        if (volumes)
+        {
+            glCullFace(GL_BACK);
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+            RenderState::SetEnabled(GL_DEPTH_CLAMP, false);
+            RenderState::SetEnabled(GL_CULL_FACE, false);
+            RenderState::SetEnabled(GL_BLEND, false);
+        }
+
+        RenderState::SetEnabled(GL_STENCIL_TEST, false);
+        glEndQuery(GL_TIME_ELAPSED);
+        lightingTimerIssued[timer] = true;
+
+        // 3. Upscale Pass: filter the lighting output onto the whole window
+        glViewport(0, 0, scrWidth, scrHeight);
+        if (upscale)
+        {
+            RenderState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+            upscaleShader->use();
+            upscaleShader->setVec2(UNIFORM_RENDER_SCALE, renderScaleUV);
+            RenderState::BindTexture(0, GL_TEXTURE_2D, sceneColor);
+            RenderQuad();
+        }
+        RenderState::SetEnabled(GL_DEPTH_TEST, true);
+        glQueryCounter(frameTimestamps[timer][1], GL_TIMESTAMP);
 
         return;
     }
 
     // --- Forward Shading (Fallback) ---
-    glm::mat4 projection = activeCamera->GetProjectionMatrix((float)scrWidth, (float)scrHeight);
-    glm::mat4 view = activeCamera->GetViewMatrix();
-
-    for (auto &obj : objects)
+    // Camera, lights and fog come from the FrameData block; only per-object state is set here.
+    // Arena objects are batched per shader, one batch per run of objects sharing a program
+    // (a single run per program when the queue is sorted).
+    BuildRenderQueue(view);
+    Shader *batchShader = nullptr;
+    for (const RenderQueue::Item &item : renderQueue.Items())
     {
-        Shader *shader = obj.shader;
-        shader->use();
-
-        shader->setMat4("projection", projection);
-        shader->setMat4("view", view);
-        shader->setVec3("viewPos", activeCamera->Position);
-
-        // Lighting support
-        shader->setInt("numLights", (int)lights.size());
-        for (size_t i = 0; i < lights.size(); ++i)
+        uint32_t index = item.index;
+        Shader *shader = objects.shaders[index];
+        if (shader != batchShader)
         {
-            lights[i]->SetUniforms(*shader, (int)i);
+            if (batchShader)
+                DrawArenaBatch(*batchShader);
+            batchShader = shader;
         }
+        if (AddToArenaBatch(index))
+            continue;
+        shader->use();
 
-        // Fog
-        shader->setBool("fogEnabled", fogEnabled);
-        shader->setVec3("fogColor", fogColor);
-        shader->setFloat("fogStart", fogStart);
-        shader->setFloat("fogEnd", fogEnd);
-
-        if (obj.shape->useObjectColor)
+        const glm::vec4 &color = objects.colors[index];
+        if (color.w != 0.0f)
         {
-            shader->setBool("useObjectColor", true);
-            shader->setVec3("objectColor", obj.shape->objectColor);
+            shader->setBool(UNIFORM_USE_OBJECT_COLOR, true);
+            shader->setVec3(UNIFORM_OBJECT_COLOR, glm::vec3(color));
         }
         else
         {
-            shader->setBool("useObjectColor", false);
+            shader->setBool(UNIFORM_USE_OBJECT_COLOR, false);
         }
 
-        obj.shape->Draw(*shader);
+        DrawObject(index, *shader);
     }
+    if (batchShader)
+        DrawArenaBatch(*batchShader);
 }
 
 void Scene::InitGBuffer()
 {
     glGenFramebuffers(1, &gBuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    RenderState::BindFramebuffer(GL_FRAMEBUFFER, gBuffer);
 
-    // - Position color buffer
-    glGenTextures(1, &gPosition);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, scrWidth, scrHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
+    // Compact layout, 12 bytes per pixel: the position is rebuilt from depth and the normal is
+    // octahedral-encoded in two channels (see gbuffer.fs and lighting_pass.fs)
 
     // - Normal color buffer
     glGenTextures(1, &gNormal);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, scrWidth, scrHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+    RenderState::BindTexture(0, GL_TEXTURE_2D, gNormal);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, scrWidth, scrHeight, 0, GL_RG, GL_UNSIGNED_SHORT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gNormal, 0);
 
     // - Color + Specular color buffer
     glGenTextures(1, &gAlbedoSpec);
-    glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
+    RenderState::BindTexture(0, GL_TEXTURE_2D, gAlbedoSpec);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, scrWidth, scrHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedoSpec, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gAlbedoSpec, 0);
 
     // - Tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    unsigned int attachments[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
-    glDrawBuffers(3, attachments);
+    unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, attachments);
 
-    // - Create and attach depth buffer (renderbuffer)
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, scrWidth, scrHeight);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    // - Depth buffer as a texture the lighting passes sample, with the stencil they test
+    //   (same format as the default framebuffer's, so both can be blitted)
+    glGenTextures(1, &gDepth);
+    RenderState::BindTexture(0, GL_TEXTURE_2D, gDepth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, scrWidth, scrHeight, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
 
     // - Finally check if framebuffer is complete
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    RenderState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Scene::InitSceneTarget()
+{
+    glGenFramebuffers(1, &sceneFBO);
+    RenderState::BindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+
+    // - Color buffer, filtered by the upscale pass
+    glGenTextures(1, &sceneColor);
+    RenderState::BindTexture(0, GL_TEXTURE_2D, sceneColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, scrWidth, scrHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+
+    // - Depth and stencil, the G-buffer's format so they can be blitted
+    glGenRenderbuffers(1, &rboSceneDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, rboSceneDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, scrWidth, scrHeight);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rboSceneDepth);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Scene framebuffer not complete!" << std::endl;
+    RenderState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Scene::DeleteRenderTargets()
+{
+    for (unsigned int texture : {gNormal, gAlbedoSpec, gDepth})
+        RenderState::OnDeleteTexture(texture);
+    unsigned int gBufferTextures[3] = {gNormal, gAlbedoSpec, gDepth};
+    glDeleteTextures(3, gBufferTextures);
+    RenderState::OnDeleteFramebuffer(gBuffer);
+    glDeleteFramebuffers(1, &gBuffer);
+
+    if (sceneFBO)
+    {
+        RenderState::OnDeleteTexture(sceneColor);
+        glDeleteTextures(1, &sceneColor);
+        glDeleteRenderbuffers(1, &rboSceneDepth);
+        RenderState::OnDeleteFramebuffer(sceneFBO);
+        glDeleteFramebuffers(1, &sceneFBO);
+        sceneFBO = sceneColor = rboSceneDepth = 0;
+    }
+}
+
+void Scene::Resize(int width, int height)
+{
+    // Minimizing reports a zero size; keep the targets until the window comes back
+    if (width <= 0 || height <= 0 || (width == scrWidth && height == scrHeight))
+        return;
+    scrWidth = width;
+    scrHeight = height;
+    DeleteRenderTargets();
+    InitGBuffer();
+    // The scene target is recreated on its next use
+}
+
+void Scene::SetUpscaleShader(Shader *shader)
+{
+    upscaleShader = shader;
+    shader->use();
+    shader->setInt("sceneColor", 0);
 }
 
 void Scene::InitQuad()
@@ -245,7 +1091,7 @@ void Scene::InitQuad()
     // Setup plane VAO
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
+    RenderState::BindVertexArray(quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -258,19 +1104,66 @@ void Scene::RenderQuad()
 {
     if (quadVAO == 0)
         InitQuad();
-    glBindVertexArray(quadVAO);
+    RenderState::BindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }
 
 void Scene::SetDeferredShaders(Shader *gBuf, Shader *lightPass)
 {
     gBufferShader = gBuf;
     lightingPassShader = lightPass;
+    PrepareDeferredShader(*gBufferShader, false);
+    PrepareDeferredShader(*lightingPassShader, true);
+}
 
-    // Set samplers once
-    lightingPassShader->use();
-    lightingPassShader->setInt("gPosition", 0);
-    lightingPassShader->setInt("gNormal", 1);
-    lightingPassShader->setInt("gAlbedoSpec", 2);
+void Scene::SetLightVolumeShader(Shader *shader)
+{
+    lightVolumeShader = shader;
+    shader->bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    shader->use();
+    shader->setInt("gDepth", 0);
+    shader->setInt("gNormal", 1);
+    shader->setInt("gAlbedoSpec", 2);
+    shader->setInt("volumeLights", LIGHT_VOLUME_LIGHTS_UNIT);
+}
+
+void Scene::SetShaderVariants(ShaderManager *manager, const std::string &gBufferName, const std::string &lightingPassName)
+{
+    shaderManager = manager;
+    gBufferVariantName = gBufferName;
+    lightingVariantName = lightingPassName;
+}
+
+bool Scene::VariantUsable(const Shader *shader)
+{
+    if (!shader)
+        return false;
+    // Polled without blocking; without KHR_parallel_shader_compile it cannot be, and the link is finished here
+    if (GLEW_KHR_parallel_shader_compile && !shader->isReady())
+        return false;
+    return shader->isLinked();
+}
+
+void Scene::PrepareDeferredShader(Shader &shader, bool lightingPass)
+{
+    // Once per program: block binding and samplers are program state
+    if (!preparedShaders.insert(&shader).second)
+        return;
+
+    shader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    if (lightingPass)
+    {
+        shader.use();
+        shader.setInt("gDepth", 0);
+        shader.setInt("gNormal", 1);
+        shader.setInt("gAlbedoSpec", 2);
+        shader.setInt("clusterLights", CLUSTER_LIGHTS_UNIT);
+        shader.setInt("clusterRanges", CLUSTER_RANGES_UNIT);
+        shader.setInt("clusterIndices", CLUSTER_INDICES_UNIT);
+    }
+    else
+    {
+        shader.use();
+        shader.setInt("drawData", ARENA_DRAW_DATA_UNIT);
+    }
 }
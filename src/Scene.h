@@ -1,12 +1,26 @@
 #pragma once
 
 #include <vector>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_set>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "Camera.h"
 #include "Shape.h"
 #include "Shader.h"
+#include "ShaderManager.h"
 #include "Light.h"
+#include "ModelLoader.h"
+#include "Bvh.h"
+#include "MeshArena.h"
+#include "RenderQueue.h"
+#include "TransformHierarchy.h"
+#include "ObjectStore.h"
+#include "LightClusters.h"
+#include "LightVolumes.h"
+#include "DynamicResolution.h"
 
 class Scene
 {
@@ -15,19 +29,87 @@ public:
     ~Scene();
 
     void Draw();
+    // The window's framebuffer changed size: reallocates the render targets
+    void Resize(int width, int height);
     void AddShape(SceneObject *shape, Shader *shader);
+    // Adds an object whose mesh is still loading. The returned object can be positioned right away;
+    // it shows as a placeholder box once its bounds arrive, is uploaded in per-frame slices once the
+    // mesh is ready and drawn when resident. If loading fails it is marked (SceneObject::IsLoadFailed)
+    // and never drawn, but stays in the scene for the caller to remove.
+    SceneObject *AddShapeAsync(AsyncMesh mesh, Shader *shader);
+    // Deletes the object. Its children become roots; lights and cameras attached to it are detached.
+    bool RemoveShape(SceneObject *shape);
     void AddLight(Light *light);
+    // Deletes the light and detaches it if it follows an object
+    bool RemoveLight(Light *light);
     void AddCamera(Camera *camera);
     void SetActiveCamera(int index);
 
     void SetDeferredShaders(Shader *gBuf, Shader *lightPass);
+    // Lets the deferred passes use permutations of the named shaders specialized for the current
+    // display mode, fog state, light counts per type and object/vertex color (see ShaderManager::GetVariant)
+    void SetShaderVariants(ShaderManager *manager, const std::string &gBufferName, const std::string &lightingPassName);
 
     Camera *GetActiveCamera() { return activeCamera; }
 
+    // Transform hierarchy (see TransformHierarchy). Every object added gets a node, and its position,
+    // rotation and scale become relative to its parent. Passing a null parent makes it a root again.
+    void SetParent(SceneObject *child, SceneObject *parent);
+    // Lights and cameras following an object, given in the parent's local space. Calling again
+    // updates the attachment. Directional lights use only the direction, point lights only the position.
+    void AttachLight(Light *light, SceneObject *parent, const glm::vec3 &localPosition,
+                     const glm::vec3 &localDirection = glm::vec3(0.0f, 0.0f, -1.0f));
+    void AttachCamera(Camera *camera, SceneObject *parent, const glm::vec3 &localPosition, const glm::vec3 &localTarget);
+    // As of the last Draw
+    const glm::mat4 &GetWorldMatrix(const SceneObject *shape) const;
+    const TransformHierarchy &GetTransforms() const { return transforms; }
+    const ObjectStore &GetObjects() const { return objects; }
+
     const std::vector<Light *> &GetLights() const { return lights; }
 
     // Deferred Shading Display Mode
-    int gBufferDisplayMode = 0; // 0=Combined, 1=Pos, 2=Norm, 3=Alb, 4=Spec
+    int gBufferDisplayMode = 0; // 0=Combined, 1=Pos, 2=Norm, 3=Alb, 4=Spec, 5=Depth
+    bool useShaderVariants = true; // Specialized permutations instead of the runtime-branching shaders
+
+    // How deferred shading reaches point and spot lights; directional lights always take the full-screen
+    // pass, and forward shading keeps the MAX_FRAME_LIGHTS cap.
+    //   FullScreen: the MAX_FRAME_LIGHTS lights reaching closest to the camera, at every pixel
+    //   Clustered:  per-cluster light lists (see LightClusters)
+    //   Volumes:    one sphere or cone per light, shading only the pixels it covers (see LightVolumes)
+    enum class LightingMode
+    {
+        FullScreen,
+        Clustered,
+        Volumes
+    };
+    LightingMode lightingMode = LightingMode::Clustered;
+    float lightAssignMs = 0.0f; // Last frame, CPU time of the cluster assignment
+    const LightClusters &GetLightClusters() const { return lightClusters; }
+    // Program for LightingMode::Volumes; without it that mode falls back to FullScreen
+    void SetLightVolumeShader(Shader *shader);
+    // Fragments shaded by the full-screen pass, the point light volumes and the spot light volumes,
+    // read back from occlusion queries two frames late like 'lightingPassMs'
+    size_t shadedFragments[3] = {0, 0, 0};
+
+    // GPU time of the lighting pass (a full-screen quad, so a direct pixel throughput measure),
+    // read back from a timer query two frames late to avoid stalling
+    float lightingPassMs = 0.0f;
+
+    // Resolution scaling of the deferred passes: the G-buffer and the lighting render to 'renderScale' of
+    // the window size in each dimension, and an upscale pass filters the result onto the window. The
+    // targets keep the window size, so changing the scale reallocates nothing. With 'dynamicResolution'
+    // the scale follows the GPU frame time (see DynamicResolution); otherwise it stays as set. At full
+    // scale without the controller the lighting writes to the window directly.
+    bool dynamicResolution = false;
+    float renderScale = 1.0f;
+    DynamicResolution resolutionController;
+    // GPU time of the deferred passes including the upscale, read back like 'lightingPassMs'
+    float gpuFrameMs = 0.0f;
+    // Program for the upscale pass; without it the deferred passes always render at full size
+    void SetUpscaleShader(Shader *shader);
+    // As of the last Draw
+    int GetRenderWidth() const { return renderWidth; }
+    int GetRenderHeight() const { return renderHeight; }
 
     // Fog settings
     bool fogEnabled = false;
@@ -35,31 +117,156 @@ public:
     float fogStart = 2.0f;
     float fogEnd = 20.0f;
 
+    // Streaming
+    size_t uploadBudgetBytes = 4 * 1024 * 1024; // Max bytes uploaded per frame
+    bool drawLoadingPlaceholders = true;         // Wireframe bounding box until a mesh is resident
+    size_t PendingUploadCount() const { return pendingUploads.size(); }
+    size_t FailedLoadCount() const { return failedLoadCount; }
+
+    // Level of detail: each object draws the coarsest LOD whose simplification error projects to at most
+    // 'lodPixelError' pixels. Switching to a coarser LOD requires the error to drop below
+    // 'lodHysteresis' * 'lodPixelError', so objects near a threshold do not flicker between levels.
+    bool lodEnabled = true;
+    float lodPixelError = 1.0f;
+    float lodHysteresis = 0.5f;
+
+    // View-frustum culling, either by walking the BVH or by testing each object's world-space
+    // bounding sphere and box in a flat SIMD pass (see Culling)
+    bool frustumCulling = true;
+    bool useBvhCulling = true;
+    size_t culledCount = 0;  // Last frame
+    size_t visibleCount = 0; // Last frame, including objects without bounds
+
+    // Spatial queries against the world-space boxes of the objects as of the last Draw, through the BVH.
+    // Objects still waiting for their bounds are never reported.
+    void QueryObjects(const Aabb &bounds, std::vector<SceneObject *> &result) const;
+    void QueryObjects(const glm::vec3 &center, float radius, std::vector<SceneObject *> &result) const;
+    // Nearest object whose box the ray hits; 'distance' receives the entry distance along 'direction'
+    SceneObject *Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float *distance = nullptr) const;
+    const DynamicBvh &GetBvh() const { return bvh; }
+
+    // Submit draws sorted by program, mesh and depth (see RenderQueue) instead of in insertion order
+    bool sortDraws = true;
+
+    // Objects created in the arena (see MeshArena) are drawn in one batch per shader instead of
+    // one draw call each. The arena outlives every object added to the scene.
+    MeshArena &GetMeshArena() { return meshArena; }
+    bool batchArenaObjects = true;
+    size_t arenaBatchedCount = 0; // Last frame, objects drawn through batches
+    size_t arenaDrawCalls = 0;    // Last frame, GL draw calls those batches took
+
 private:
     Camera *activeCamera;
     std::vector<Camera *> cameras;
     std::vector<Light *> lights;
 
     int scrWidth, scrHeight;
+    int renderWidth, renderHeight; // The part of the G-buffer the deferred passes render to
+
+    // Declared before the store, which creates and destroys nodes in it
+    TransformHierarchy transforms;
+    ObjectStore objects{transforms};
 
-    struct RenderObject
+    struct PendingUpload
     {
-        SceneObject *shape;
-        Shader *shader;
+        SceneObject *target;
+        std::future<MeshBounds> bounds; // Invalid once taken
+        std::future<std::unique_ptr<LoadedMesh>> future;
+        std::unique_ptr<LoadedMesh> mesh; // Set once the future is ready
+        size_t verticesUploaded = 0;
+        size_t indicesUploaded = 0;
     };
-    std::vector<RenderObject> objects;
+    std::vector<PendingUpload> pendingUploads;
+    SceneObject *placeholderBox = nullptr;
+    size_t failedLoadCount = 0;
+
+    // Per-frame uniform block (see FrameData.h), shared by every program through FRAME_DATA_BINDING
+    unsigned int frameDataUBO = 0;
+    void InitFrameData();
+    void UpdateFrameData(const glm::mat4 &view, const glm::mat4 &projection);
+    glm::ivec3 frameLightTypeCounts = glm::ivec3(0); // Directional, point, spot lights in FrameData
+
+    // Shader permutations
+    ShaderManager *shaderManager = nullptr;
+    std::string gBufferVariantName, lightingVariantName;
+    std::unordered_set<const Shader *> preparedShaders;
+    void PrepareDeferredShader(Shader &shader, bool lightingPass);
+    // Whether a variant has finished compiling and linked successfully
+    static bool VariantUsable(const Shader *shader);
+
+    unsigned int lightingTimers[2] = {0, 0};
+    bool lightingTimerIssued[2] = {false, false};
+    unsigned int fragmentQueries[2][3] = {{0, 0, 0}, {0, 0, 0}}; // GL_SAMPLES_PASSED, per 'shadedFragments' entry
+    unsigned int frameTimestamps[2][2] = {{0, 0}, {0, 0}}; // GL_TIMESTAMP before and after the deferred passes
+    int lightingTimerFrame = 0;
+    bool controllerActive = false; // 'dynamicResolution' as of the last frame
+    // Collects the queries of frame parity 'timer' (creating them on first use); returns whether they were ready
+    bool ReadFrameQueries(int timer);
+
+    struct LightAttachment
+    {
+        Light *light;
+        TransformHierarchy::NodeId node;
+        glm::vec3 direction; // Parent space
+    };
+    struct CameraAttachment
+    {
+        Camera *camera;
+        TransformHierarchy::NodeId node;
+        glm::vec3 target; // Parent space
+    };
+    std::vector<LightAttachment> lightAttachments;
+    LightClusters lightClusters;
+    LightVolumes lightVolumes;
+    Shader *lightVolumeShader = nullptr;
+    std::vector<CameraAttachment> cameraAttachments;
+    // Dense index in 'objects', or ObjectStore::INVALID_INDEX
+    uint32_t IndexOf(const SceneObject *shape) const;
+    // Propagates transform changes through the hierarchy and moves attached lights and cameras
+    void UpdateTransforms();
+
+    void ProcessUploads();
+    void CullObjects(const glm::mat4 &projectionView);
+    void SelectLods(const glm::mat4 &view);
+
+    DynamicBvh bvh; // Leaves carry object handles, which survive removals
+
+    // Culling scratch, reused every frame
+    CullingBounds cullingBounds;
+    std::vector<uint32_t> cullingIndices; // Object index of each entry in 'cullingBounds'
+    std::vector<uint8_t> cullingVisibility;
+    void DrawObject(uint32_t index, Shader &shader);
+
+    // Visible objects of this frame in submission order
+    RenderQueue renderQueue;
+    // Forward rendering keys on each object's own program; the geometry pass passes the two programs
+    // it picks between by object color
+    void BuildRenderQueue(const glm::mat4 &view, const Shader *vertexColorShader = nullptr, const Shader *objectColorShader = nullptr);
+
+    MeshArena meshArena;
+    std::vector<MeshArena::BatchDraw> arenaBatch; // Scratch, reused every frame
+    // Appends the object to 'arenaBatch' if it can be batched this frame
+    bool AddToArenaBatch(uint32_t index);
+    void DrawArenaBatch(Shader &shader);
 
     // Deferred Shading
     unsigned int gBuffer;
-    unsigned int gPosition, gNormal, gAlbedoSpec;
-    unsigned int rboDepth;
+    unsigned int gNormal, gAlbedoSpec;
+    unsigned int gDepth; // Depth-stencil texture; view-space positions are reconstructed from it
     Shader *gBufferShader;
     Shader *lightingPassShader;
 
     unsigned int quadVAO = 0;
     unsigned int quadVBO;
 
+    // Lighting output when rendering below window size, filtered onto the window by the upscale pass
+    // (created on first use); its depth-stencil receives the G-buffer's like the window's does
+    unsigned int sceneFBO = 0, sceneColor = 0, rboSceneDepth = 0;
+    Shader *upscaleShader = nullptr;
+
     void InitGBuffer();
+    void InitSceneTarget();
+    void DeleteRenderTargets();
     void InitQuad();
     void RenderQuad();
 };
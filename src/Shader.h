@@ -8,6 +8,26 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderState.h"
+
+// Process-wide id of a uniform name (see Shader::Uniform). Resolve it once, e.g. into a static,
+// and the same id addresses that uniform in every Shader without any string work.
+struct UniformId
+{
+    int index = -1;
+};
+
+// Per-frame uniform counters. Every set below used to cost a glGetUniformLocation call.
+struct UniformStats
+{
+    unsigned int idSets = 0;      // Set through a UniformId: a plain array index
+    unsigned int nameLookups = 0; // Set by name: one hash lookup in the reflected table, no driver call
+    unsigned int DriverLookupsEliminated() const { return idSets + nameLookups; }
+};
 
 class Shader
 {
@@ -16,114 +36,308 @@ public:
 
     Shader(const char *vertexPath, const char *fragmentPath)
     {
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
+        issueCompile(readFile(vertexPath), readFile(fragmentPath), false);
+        finishLink();
+    }
 
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
+    // Adopts an already linked program, e.g. one restored by ProgramCache
+    explicit Shader(unsigned int program) : ID(program)
+    {
+        reflectUniforms();
+    }
 
-            std::stringstream vShaderStream, fShaderStream;
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
+    // Issues the compiles and the link without waiting for the driver. Status checks and uniform
+    // reflection are deferred to the first use (or an explicit finishLink), so several programs can
+    // compile in parallel. 'retrievable' asks the driver to keep a binary for glGetProgramBinary.
+    Shader(const std::string &vertexCode, const std::string &fragmentCode, bool retrievable)
+    {
+        issueCompile(vertexCode, fragmentCode, retrievable);
+    }
+
+    // Called once when a deferred program has finished linking, with whether it linked successfully
+    std::function<void(const Shader &, bool)> onLinked;
+
+    // True once the driver has finished compiling and linking. Only non-blocking with
+    // KHR_parallel_shader_compile; without it the driver may stall here.
+    bool isReady() const
+    {
+        if (!pending)
+            return true;
+        if (!GLEW_KHR_parallel_shader_compile)
+            return false;
+        GLint done = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
 
-            vShaderFile.close();
-            fShaderFile.close();
+    // Waits for a deferred program, logs compile/link errors and reflects its uniforms. Idempotent.
+    void finishLink() const
+    {
+        if (!pending)
+            return;
+        pending = false;
+
+        bool ok = checkCompileLinkErrors(vertexShader, "VERTEX");
+        ok &= checkCompileLinkErrors(fragmentShader, "FRAGMENT");
+        ok &= checkCompileLinkErrors(ID, "PROGRAM");
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        linked = ok;
+
+        reflectUniforms();
+        if (onLinked)
+            onLinked(*this, ok);
+    }
+
+    // Whether the program compiled and linked; finishes a deferred program first
+    bool isLinked() const
+    {
+        finishLink();
+        return linked;
+    }
 
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+    static std::string readFile(const char *path)
+    {
+        std::ifstream file;
+        file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            file.open(path);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            return stream.str();
         }
         catch (std::ifstream::failure &e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << " " << e.what() << std::endl;
+            return std::string();
         }
+    }
 
-        const char *vShaderCode = vertexCode.c_str();
-        const char *fShaderCode = fragmentCode.c_str();
-
-        unsigned int vertex, fragment;
-
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileLinkErrors(vertex, "VERTEX");
+    // Interns 'name' and returns its id; cheap to call once, not meant for per-frame use
+    static UniformId Uniform(const std::string &name)
+    {
+        std::unordered_map<std::string, int> &registry = uniformRegistry();
+        auto it = registry.try_emplace(name, (int)registry.size()).first;
+        return {it->second};
+    }
 
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileLinkErrors(fragment, "FRAGMENT");
+    // Location of the uniform in this program, or -1 if it is not active
+    int getLocation(UniformId id) const
+    {
+        finishLink();
+        return id.index >= 0 && id.index < (int)locations.size() ? locations[id.index] : -1;
+    }
 
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileLinkErrors(ID, "PROGRAM");
+    // Points the named uniform block at a binding point (GLSL 330 has no layout(binding) qualifier).
+    // Returns false if the program has no such active block.
+    bool bindUniformBlock(const char *blockName, unsigned int binding) const
+    {
+        finishLink();
+        unsigned int index = glGetUniformBlockIndex(ID, blockName);
+        if (index == GL_INVALID_INDEX)
+            return false;
+        glUniformBlockBinding(ID, index, binding);
+        return true;
+    }
 
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+    static UniformStats &FrameStats()
+    {
+        static UniformStats stats;
+        return stats;
+    }
+    // Returns the counters collected since the previous call and resets them; call once per frame
+    static UniformStats EndFrameStats()
+    {
+        UniformStats stats = FrameStats();
+        FrameStats() = UniformStats();
+        return stats;
     }
 
     void use() const
     {
-        glUseProgram(ID);
+        finishLink();
+        RenderState::UseProgram(ID);
     }
 
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(locate(name), (int)value);
     }
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(locate(name), value);
     }
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(locate(name), value);
     }
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(locate(name), 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(locate(name), x, y);
     }
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(locate(name), 1, &value[0]);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(locate(name), x, y, z);
     }
     void setVec4(const std::string &name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(locate(name), 1, &value[0]);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(locate(name), x, y, z, w);
     }
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(locate(name), 1, GL_FALSE, &mat[0][0]);
     }
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(locate(name), 1, GL_FALSE, &mat[0][0]);
     }
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(locate(name), 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // Pre-resolved setters for hot paths
+    void setBool(UniformId id, bool value) const
+    {
+        glUniform1i(locate(id), (int)value);
+    }
+    void setInt(UniformId id, int value) const
+    {
+        glUniform1i(locate(id), value);
+    }
+    void setFloat(UniformId id, float value) const
+    {
+        glUniform1f(locate(id), value);
+    }
+    void setVec2(UniformId id, const glm::vec2 &value) const
+    {
+        glUniform2fv(locate(id), 1, &value[0]);
+    }
+    void setVec3(UniformId id, const glm::vec3 &value) const
+    {
+        glUniform3fv(locate(id), 1, &value[0]);
+    }
+    void setVec4(UniformId id, const glm::vec4 &value) const
+    {
+        glUniform4fv(locate(id), 1, &value[0]);
+    }
+    void setMat3(UniformId id, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(locate(id), 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(UniformId id, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(locate(id), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
-    void checkCompileLinkErrors(unsigned int shader, std::string type)
+    // Deferred compilation state (see the retrievable-flag constructor)
+    mutable bool pending = false;
+    mutable bool linked = true;
+    unsigned int vertexShader = 0, fragmentShader = 0;
+
+    void issueCompile(const std::string &vertexCode, const std::string &fragmentCode, bool retrievable)
+    {
+        const char *vShaderCode = vertexCode.c_str();
+        const char *fShaderCode = fragmentCode.c_str();
+
+        vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertexShader, 1, &vShaderCode, NULL);
+        glCompileShader(vertexShader);
+
+        fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragmentShader, 1, &fShaderCode, NULL);
+        glCompileShader(fragmentShader);
+
+        ID = glCreateProgram();
+        glAttachShader(ID, vertexShader);
+        glAttachShader(ID, fragmentShader);
+        if (retrievable)
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(ID);
+        pending = true;
+    }
+
+    // Flat location table indexed by UniformId, filled from glGetActiveUniform at link time
+    mutable std::vector<int> locations;
+
+    static std::unordered_map<std::string, int> &uniformRegistry()
+    {
+        static std::unordered_map<std::string, int> registry;
+        return registry;
+    }
+
+    int locate(UniformId id) const
+    {
+        ++FrameStats().idSets;
+        return getLocation(id);
+    }
+    int locate(const std::string &name) const
+    {
+        ++FrameStats().nameLookups;
+        auto it = uniformRegistry().find(name);
+        return it != uniformRegistry().end() ? getLocation({it->second}) : -1;
+    }
+
+    void addLocation(const std::string &name, int location) const
+    {
+        UniformId id = Uniform(name);
+        if (id.index >= (int)locations.size())
+            locations.resize(id.index + 1, -1);
+        locations[id.index] = location;
+    }
+
+    void reflectUniforms() const
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+
+        for (GLint i = 0; i < count; ++i)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+
+            int location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0)
+                continue; // Uniform block member
+
+            // Arrays of basic types are reported once as "name[0]"; register every element and the bare name
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                addLocation(base, location);
+                for (GLint element = 0; element < size; ++element)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    addLocation(elementName, glGetUniformLocation(ID, elementName.c_str()));
+                }
+            }
+            else
+            {
+                addLocation(name, location);
+            }
+        }
+    }
+
+    static bool checkCompileLinkErrors(unsigned int shader, std::string type)
     {
         int success;
         char infoLog[1024];
@@ -147,5 +361,6 @@ private:
                           << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
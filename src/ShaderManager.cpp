@@ -1,6 +1,50 @@
 #include "ShaderManager.h"
+#include "ProgramCache.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double ElapsedMs(Clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    }
+
+    void EnableParallelCompile()
+    {
+        static bool compilerThreadsSet = false;
+        if (GLEW_KHR_parallel_shader_compile && !compilerThreadsSet)
+        {
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // Let the driver pick
+            compilerThreadsSet = true;
+        }
+    }
+
+    // Inserts 'defines' right after the '#version' line; '#line' keeps error messages pointing at the file
+    std::string InjectDefines(const std::string &code, const std::string &defines)
+    {
+        size_t version = code.find("#version");
+        size_t lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return defines + code;
+        return code.substr(0, lineEnd + 1) + defines + "#line 2\n" + code.substr(lineEnd + 1);
+    }
+}
+
+std::string ShaderDefines::Text() const
+{
+    std::vector<std::pair<std::string, int>> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    std::string text;
+    for (const auto &define : sorted)
+        text += "#define " + define.first + " " + std::to_string(define.second) + "\n";
+    return text;
+}
+
 ShaderManager::~ShaderManager()
 {
     for (auto &pair : shaders)
@@ -8,18 +52,123 @@ ShaderManager::~ShaderManager()
         delete pair.second;
     }
     shaders.clear();
+    for (auto &pair : variants)
+        delete pair.second;
+    variants.clear();
 }
 
 Shader *ShaderManager::LoadShader(const std::string &name, const std::string &vertexPath, const std::string &fragmentPath)
 {
-    if (shaders.find(name) != shaders.end())
+    return LoadShaders({{name, vertexPath, fragmentPath}})[0];
+}
+
+std::vector<Shader *> ShaderManager::LoadShaders(const std::vector<ShaderDesc> &descs)
+{
+    auto start = Clock::now();
+    EnableParallelCompile();
+
+    bool cacheEnabled = useProgramCache && ProgramCache::IsSupported();
+    std::string driverId = cacheEnabled ? ProgramCache::DriverId() : std::string();
+
+    // File reading and cache key hashing on worker threads
+    struct PreparedSource
     {
-        return shaders[name];
+        ShaderSource source;
+        uint64_t key = 0;
+    };
+    std::vector<std::future<PreparedSource>> prepared;
+    for (const ShaderDesc &desc : descs)
+    {
+        prepared.push_back(ThreadPool::Shared().Submit([desc, driverId, cacheEnabled]()
+        {
+            PreparedSource result;
+            result.source.vertexCode = Shader::readFile(desc.vertexPath.c_str());
+            result.source.fragmentCode = Shader::readFile(desc.fragmentPath.c_str());
+            if (cacheEnabled)
+                result.key = ProgramCache::Key(driverId, result.source.vertexCode, result.source.fragmentCode, "");
+            return result;
+        }));
     }
 
-    Shader *shader = new Shader(vertexPath.c_str(), fragmentPath.c_str());
-    shaders[name] = shader;
+    // Issue everything without waiting on the driver
+    std::vector<Shader *> result;
+    int submittedCount = 0;
+    for (size_t i = 0; i < descs.size(); ++i)
+    {
+        const std::string &name = descs[i].name;
+        PreparedSource ready = prepared[i].get();
+        auto existing = shaders.find(name);
+        if (existing != shaders.end())
+        {
+            result.push_back(existing->second);
+            continue;
+        }
+
+        bool submitted = false;
+        Shader *shader = CreateProgram(name, ready.source.vertexCode, ready.source.fragmentCode, ready.key,
+                                       cacheEnabled, submitted);
+        submittedCount += submitted ? 1 : 0;
+        shaders[name] = shader;
+        sources[name] = std::move(ready.source);
+        result.push_back(shader);
+    }
+
+    if (submittedCount > 0)
+        std::cout << "Submitted " << submittedCount << " shader programs in " << ElapsedMs(start) << " ms"
+                  << (GLEW_KHR_parallel_shader_compile ? " (parallel compile)" : "") << "." << std::endl;
+    return result;
+}
+
+Shader *ShaderManager::GetVariant(const std::string &name, const ShaderDefines &defines)
+{
+    std::string definesText = defines.Text();
+    std::string variantKey = name + "\n" + definesText;
+    auto existing = variants.find(variantKey);
+    if (existing != variants.end())
+        return existing->second;
+
+    auto source = sources.find(name);
+    if (source == sources.end())
+        return nullptr;
 
+    EnableParallelCompile();
+    bool cacheEnabled = useProgramCache && ProgramCache::IsSupported();
+    std::string vertexCode = InjectDefines(source->second.vertexCode, definesText);
+    std::string fragmentCode = InjectDefines(source->second.fragmentCode, definesText);
+    uint64_t key = cacheEnabled ? ProgramCache::Key(ProgramCache::DriverId(), vertexCode, fragmentCode, definesText) : 0;
+
+    std::string label = name;
+    for (const auto &define : defines.values)
+        label += " " + define.first + "=" + std::to_string(define.second);
+
+    bool submitted = false;
+    Shader *shader = CreateProgram(label, vertexCode, fragmentCode, key, cacheEnabled, submitted);
+    variants[variantKey] = shader;
+    return shader;
+}
+
+Shader *ShaderManager::CreateProgram(const std::string &label, const std::string &vertexCode,
+                                     const std::string &fragmentCode, uint64_t key, bool cacheEnabled, bool &submitted)
+{
+    auto programStart = Clock::now();
+    unsigned int program = cacheEnabled ? ProgramCache::Load(key) : 0;
+    if (program)
+    {
+        submitted = false;
+        std::cout << "Shader '" << label << "': program cache hit, loaded in " << ElapsedMs(programStart) << " ms." << std::endl;
+        return new Shader(program);
+    }
+
+    Shader *shader = new Shader(vertexCode, fragmentCode, cacheEnabled);
+    shader->onLinked = [label, key, cacheEnabled, programStart](const Shader &linked, bool ok)
+    {
+        if (ok && cacheEnabled)
+            ProgramCache::Store(key, linked.ID);
+        std::cout << "Shader '" << label << "': " << (cacheEnabled ? "program cache miss, " : "")
+                  << (ok ? "compiled" : "failed") << ", ready " << ElapsedMs(programStart)
+                  << " ms after submission." << std::endl;
+    };
+    submitted = true;
     return shader;
 }
 
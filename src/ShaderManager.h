@@ -1,9 +1,34 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include "Shader.h"
 
+struct ShaderDesc
+{
+    std::string name;
+    std::string vertexPath;
+    std::string fragmentPath;
+};
+
+// Compile-time feature switches of a shader variant, injected as '#define NAME VALUE' after '#version'
+struct ShaderDefines
+{
+    std::vector<std::pair<std::string, int>> values;
+
+    ShaderDefines &Set(const std::string &name, int value)
+    {
+        values.emplace_back(name, value);
+        return *this;
+    }
+
+    // The '#define' lines, sorted by name; identifies the variant and is part of its program cache key
+    std::string Text() const;
+};
+
 class ShaderManager
 {
 public:
@@ -13,9 +38,36 @@ public:
     // If a shader with 'name' already exists, it returns the existing one without reloading.
     Shader *LoadShader(const std::string &name, const std::string &vertexPath, const std::string &fragmentPath);
 
+    // Loads a batch of shaders, returned in the order of 'descs'. Source files are read and hashed on
+    // worker threads, then every compile and link is issued before any status is checked; each program
+    // finishes on first use (see Shader::finishLink). With KHR_parallel_shader_compile the driver compiles
+    // them concurrently, so the batch costs about as much as its slowest program.
+    std::vector<Shader *> LoadShaders(const std::vector<ShaderDesc> &descs);
+
     // Retrieves a stored shader by name. Returns nullptr if not found.
     Shader *GetShader(const std::string &name);
 
+    // Returns the permutation of shader 'name' compiled with 'defines', compiling it on the first request
+    // and caching it by name and defines afterwards. Like LoadShaders the program finishes on first use, so
+    // poll Shader::isReady before using it to avoid a stall; Shader::isLinked reports a failed compile.
+    // Returns nullptr if no shader called 'name' was loaded.
+    Shader *GetVariant(const std::string &name, const ShaderDefines &defines);
+
+    // Restore linked programs from the binary cache (see ProgramCache) instead of compiling them
+    bool useProgramCache = true;
+
 private:
+    struct ShaderSource
+    {
+        std::string vertexCode;
+        std::string fragmentCode;
+    };
+
     std::unordered_map<std::string, Shader *> shaders;
+    std::unordered_map<std::string, ShaderSource> sources;  // Kept to build variants
+    std::unordered_map<std::string, Shader *> variants;     // Keyed by name + defines text
+
+    // Restores 'key' from the program cache or issues a deferred compile; 'submitted' is set for the latter
+    Shader *CreateProgram(const std::string &label, const std::string &vertexCode, const std::string &fragmentCode,
+                          uint64_t key, bool cacheEnabled, bool &submitted);
 };
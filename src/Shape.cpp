@@ -1,22 +1,80 @@
 #include "Shape.h"
+#include "RenderState.h"
+#include "MeshArena.h"
 #include <cstddef> // for offsetof
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Uniforms set every frame, resolved once (see Shader::Uniform)
+    const UniformId UNIFORM_MODEL = Shader::Uniform("model");
+    const UniformId UNIFORM_PACKED_VERTICES = Shader::Uniform("packedVertices");
+    const UniformId UNIFORM_POSITION_SCALE = Shader::Uniform("positionScale");
+    const UniformId UNIFORM_POSITION_OFFSET = Shader::Uniform("positionOffset");
+}
 
 SceneObject::SceneObject(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices)
+    : SceneObject(vertices.data(), vertices.size(), indices.data(), indices.size())
+{
+}
+
+SceneObject::SceneObject(const Vertex *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount)
     : position(0.0f), rotationAngle(0.0f), rotationAxis(0.0f, 1.0f, 0.0f), scale(1.0f)
 {
-    indexCount = static_cast<unsigned int>(indices.size());
+    CreateBuffers();
+    AllocateBuffers(vertexCount, indexCount);
+    UploadVertices(vertices, 0, vertexCount);
+    UploadIndices(indices, 0, indexCount);
 
+    glm::vec3 min, max;
+    ComputeBounds(vertices, vertexCount, min, max);
+    SetBounds(min, max, ComputeBoundingRadius(vertices, vertexCount, (min + max) * 0.5f));
+    resident = true;
+}
+
+SceneObject::SceneObject(const PackedVertexData &vertices, const unsigned int *indices, size_t indexCount)
+    : position(0.0f), rotationAngle(0.0f), rotationAxis(0.0f, 1.0f, 0.0f), scale(1.0f)
+{
+    CreateBuffers();
+    SetPackedFormat(vertices);
+    AllocateBuffers(vertices.vertices.size(), indexCount);
+    UploadVertices(vertices, 0, vertices.vertices.size());
+    UploadIndices(indices, 0, indexCount);
+
+    SetBounds(vertices.boundsMin, vertices.boundsMax, vertices.boundsRadius);
+    resident = true;
+}
+
+SceneObject::SceneObject(MeshArena &arena, const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices)
+    : position(0.0f), rotationAngle(0.0f), rotationAxis(0.0f, 1.0f, 0.0f), scale(1.0f),
+      VAO(0), VBO(0), EBO(0), arena(&arena)
+{
+    allocation = arena.Add(vertices.data(), (uint32_t)vertices.size(), indices.data(), (uint32_t)indices.size());
+    indexCount = allocation.indexCount;
+
+    glm::vec3 min, max;
+    ComputeBounds(vertices.data(), vertices.size(), min, max);
+    SetBounds(min, max, ComputeBoundingRadius(vertices.data(), vertices.size(), (min + max) * 0.5f));
+    resident = true;
+}
+
+SceneObject::SceneObject()
+    : position(0.0f), rotationAngle(0.0f), rotationAxis(0.0f, 1.0f, 0.0f), scale(1.0f)
+{
+    CreateBuffers();
+}
+
+void SceneObject::CreateBuffers()
+{
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
+    RenderState::BindVertexArray(VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Position));
@@ -30,23 +88,231 @@ SceneObject::SceneObject(const std::vector<Vertex> &vertices, const std::vector<
     glEnableVertexAttribArray(3);
     glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, TexCoords));
 
-    glBindVertexArray(0);
+    RenderState::BindVertexArray(0);
+}
+
+void SceneObject::SetPackedFormat(const PackedVertexData &format)
+{
+    packed = true;
+    quantization = format.quantization;
+    constantColor = format.constantColor;
+
+    RenderState::BindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+    // Position: unorm16, dequantized in the vertex shader with positionScale/positionOffset
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, Position));
+    // Normal: octahedral snorm16, decoded in the vertex shader
+    glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, Normal));
+    glVertexAttribPointer(3, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void *)offsetof(PackedVertex, TexCoords));
+
+    if (!format.colors.empty())
+    {
+        glGenBuffers(1, &colorVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(uint32_t), (void *)0);
+    }
+    else
+    {
+        // Without a stream the shader reads the current generic value set in Draw
+        glDisableVertexAttribArray(1);
+    }
+
+    RenderState::BindVertexArray(0);
+}
+
+void SceneObject::AllocateBuffers(size_t vertexCount, size_t indexCount)
+{
+    this->indexCount = static_cast<unsigned int>(indexCount);
+    indexType = vertexCount <= MAX_SHORT_INDEX_VERTICES || !subMeshes.empty() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+    RenderState::BindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * (packed ? sizeof(PackedVertex) : sizeof(Vertex)), NULL, GL_STATIC_DRAW);
+    if (colorVBO)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(uint32_t), NULL, GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * IndexSize(), NULL, GL_STATIC_DRAW);
+    RenderState::BindVertexArray(0);
+}
+
+void SceneObject::UploadVertices(const Vertex *vertices, size_t first, size_t count)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Vertex), count * sizeof(Vertex), vertices + first);
+}
+
+void SceneObject::UploadVertices(const PackedVertexData &vertices, size_t first, size_t count)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(PackedVertex), count * sizeof(PackedVertex), vertices.vertices.data() + first);
+    if (colorVBO && !vertices.colors.empty())
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(uint32_t), count * sizeof(uint32_t), vertices.colors.data() + first);
+    }
+}
+
+void SceneObject::UploadIndices(const unsigned int *indices, size_t first, size_t count)
+{
+    // The element buffer binding is VAO state, so go through our own VAO
+    RenderState::BindVertexArray(VAO);
+    if (indexType == GL_UNSIGNED_SHORT)
+    {
+        std::vector<uint16_t> shortIndices(indices + first, indices + first + count);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * sizeof(uint16_t), count * sizeof(uint16_t), shortIndices.data());
+    }
+    else
+    {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * sizeof(unsigned int), count * sizeof(unsigned int), indices + first);
+    }
+    RenderState::BindVertexArray(0);
+}
+
+void SceneObject::SetBounds(const glm::vec3 &min, const glm::vec3 &max, float radius)
+{
+    boundsMin = min;
+    boundsMax = max;
+    boundsRadius = radius >= 0.0f ? radius : glm::length(max - min) * 0.5f;
+    hasBounds = true;
+    RefreshStore();
+}
+
+void ComputeBounds(const Vertex *vertices, size_t count, glm::vec3 &min, glm::vec3 &max)
+{
+    if (count == 0)
+    {
+        min = max = glm::vec3(0.0f);
+        return;
+    }
+    min = max = vertices[0].Position;
+    for (size_t i = 1; i < count; ++i)
+    {
+        min = glm::min(min, vertices[i].Position);
+        max = glm::max(max, vertices[i].Position);
+    }
+}
+
+float ComputeBoundingRadius(const Vertex *vertices, size_t count, const glm::vec3 &center)
+{
+    float radiusSquared = 0.0f;
+    for (size_t i = 0; i < count; ++i)
+    {
+        glm::vec3 offset = vertices[i].Position - center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    return std::sqrt(radiusSquared);
 }
 
 SceneObject::~SceneObject()
 {
+    if (arena)
+    {
+        arena->Remove(allocation);
+        return;
+    }
+    RenderState::OnDeleteVertexArray(VAO);
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    if (colorVBO)
+        glDeleteBuffers(1, &colorVBO);
 }
 
 void SceneObject::Draw(const Shader &shader)
 {
-    shader.setMat4("model", GetModelMatrix());
+    Draw(shader, GetModelMatrix());
+}
 
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+void SceneObject::Draw(const Shader &shader, const glm::mat4 &model, int lod)
+{
+    SetDrawState(shader, model);
+    DrawElements(lod, 1);
+    // The VAO stays bound: consecutive draws of the same mesh skip the rebind (see RenderState)
+}
+
+void SceneObject::SetDrawState(const Shader &shader, const glm::mat4 &model)
+{
+    shader.setMat4(UNIFORM_MODEL, model);
+    shader.setBool(UNIFORM_PACKED_VERTICES, packed);
+    if (packed)
+    {
+        shader.setVec3(UNIFORM_POSITION_SCALE, quantization.scale);
+        shader.setVec3(UNIFORM_POSITION_OFFSET, quantization.offset);
+        if (!colorVBO)
+            glVertexAttrib3f(1, constantColor.r, constantColor.g, constantColor.b);
+    }
+    if (arena)
+        arena->Bind();
+    else
+        RenderState::BindVertexArray(VAO);
+}
+
+void SceneObject::DrawElements(int lod, GLsizei instanceCount)
+{
+    // Non-instanced entry points for single draws, which is every object but InstancedObject.
+    // Arena objects offset everything by where their mesh sits in the shared buffers.
+    auto draw = [&](unsigned int count, size_t firstIndex, GLint baseVertex)
+    {
+        firstIndex += allocation.firstIndex;
+        baseVertex += (GLint)allocation.firstVertex;
+        void *offset = (void *)(firstIndex * IndexSize());
+        if (instanceCount == 1 && baseVertex == 0)
+            glDrawElements(GL_TRIANGLES, count, indexType, offset);
+        else if (instanceCount == 1)
+            glDrawElementsBaseVertex(GL_TRIANGLES, count, indexType, offset, baseVertex);
+        else if (baseVertex == 0)
+            glDrawElementsInstanced(GL_TRIANGLES, count, indexType, offset, instanceCount);
+        else
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, count, indexType, offset, instanceCount, baseVertex);
+    };
+
+    if (lods.empty())
+    {
+        draw(indexCount, 0, 0);
+        return;
+    }
+
+    const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+    if (level.subMeshCount == 0)
+        draw(level.indexCount, level.indexOffset, 0);
+    for (unsigned int i = 0; i < level.subMeshCount; ++i)
+    {
+        const SubMesh &subMesh = subMeshes[level.firstSubMesh + i];
+        draw(subMesh.indexCount, subMesh.indexOffset, subMesh.baseVertex);
+    }
+}
+
+unsigned int SceneObject::GetVertexArray() const
+{
+    return arena ? arena->GetVertexArray() : VAO;
+}
+
+bool SceneObject::GetArenaRange(int lod, uint32_t &firstIndex, uint32_t &count, int32_t &baseVertex) const
+{
+    baseVertex = (int32_t)allocation.firstVertex;
+    if (lods.empty())
+    {
+        firstIndex = allocation.firstIndex;
+        count = indexCount;
+        return true;
+    }
+    const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+    if (level.subMeshCount != 0)
+        return false;
+    firstIndex = allocation.firstIndex + level.indexOffset;
+    count = level.indexCount;
+    return true;
+}
+
+void SceneObject::SetLods(const std::vector<MeshLod> &levels, const std::vector<SubMesh> &subMeshes)
+{
+    lods = levels;
+    this->subMeshes = subMeshes;
+    RefreshStore();
 }
 
 glm::mat4 SceneObject::GetModelMatrix() const
@@ -61,21 +327,61 @@ glm::mat4 SceneObject::GetModelMatrix() const
 void SceneObject::SetPosition(const glm::vec3 &pos)
 {
     position = pos;
+    PushTransform();
 }
 
 void SceneObject::SetRotation(float angle, const glm::vec3 &axis)
 {
     rotationAngle = angle;
     rotationAxis = axis;
+    PushTransform();
 }
 
 void SceneObject::SetScale(const glm::vec3 &scl)
 {
     scale = scl;
+    PushTransform();
 }
 
 void SceneObject::SetObjectColor(const glm::vec3 &color, bool useColor)
 {
     objectColor = color;
     useObjectColor = useColor;
+    RefreshStore();
+}
+
+void SceneObject::MarkResident()
+{
+    resident = true;
+    RefreshStore();
+}
+
+void SceneObject::MarkLoadFailed()
+{
+    loadFailed = true;
+    hasBounds = false;
+    RefreshStore();
+}
+
+void SceneObject::LinkStore(ObjectStore *store, ObjectHandle handle)
+{
+    this->store = store;
+    storeHandle = handle;
+    PushTransform();
+}
+
+void SceneObject::PushTransform()
+{
+    if (!store)
+        return;
+    // Same as glm::rotate(angle, axis), which also normalizes the axis
+    glm::quat rotation = rotationAngle != 0.0f ? glm::angleAxis(rotationAngle, glm::normalize(rotationAxis))
+                                               : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    store->SetLocalTransform(storeHandle, position, rotation, scale);
+}
+
+void SceneObject::RefreshStore()
+{
+    if (store)
+        store->Refresh(storeHandle);
 }
@@ -3,8 +3,10 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <cstdint>
 #include <vector>
 #include "Shader.h"
+#include "ObjectStore.h"
 
 struct Vertex
 {
@@ -14,14 +16,127 @@ struct Vertex
     glm::vec2 TexCoords;
 };
 
+// Compact 16-byte vertex (see VertexPacking). Positions are quantized to the mesh bounds,
+// normals are octahedral-encoded, texcoords are half floats. Colors live in an optional
+// separate RGBA8 stream, since most objects draw with 'useObjectColor'.
+struct PackedVertex
+{
+    uint16_t Position[4];  // unorm16 within the mesh bounds; w is padding
+    int16_t Normal[2];     // Octahedral snorm16
+    uint16_t TexCoords[2]; // Half floats
+};
+
+// Maps unorm16 positions back to object space: position = offset + quantized * scale
+struct VertexQuantization
+{
+    glm::vec3 offset = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// A packed vertex buffer plus what the shaders need to decode it
+struct PackedVertexData
+{
+    std::vector<PackedVertex> vertices;
+    std::vector<uint32_t> colors; // RGBA8 per vertex; empty when every vertex has 'constantColor'
+    glm::vec3 constantColor = glm::vec3(1.0f);
+    VertexQuantization quantization;
+    // Of the source positions; unlike the quantization grid, zero-sized on flat axes
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    float boundsRadius = -1.0f; // Around the center of the box
+};
+
+// A range of the index buffer whose indices are relative to 'baseVertex' and all fit in 16 bits
+struct SubMesh
+{
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    unsigned int baseVertex;
+};
+
+// One level of detail: a range of the shared index buffer.
+// 'error' is the object-space deviation from the full-resolution mesh.
+// When the mesh is partitioned (see MeshOptimizer::PartitionSubMeshes) the level is drawn as
+// 'subMeshCount' sub-meshes starting at 'firstSubMesh'.
+struct MeshLod
+{
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;
+    unsigned int firstSubMesh = 0;
+    unsigned int subMeshCount = 0;
+};
+
+// Where a mesh lives inside a MeshArena's shared buffers
+struct MeshAllocation
+{
+    uint32_t firstVertex = 0;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+};
+
+class MeshArena;
+
+// Largest vertex count addressable with GL_UNSIGNED_SHORT indices (0xFFFF is kept free for primitive restart)
+const size_t MAX_SHORT_INDEX_VERTICES = 65535;
+
 class SceneObject
 {
 public:
     SceneObject(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices);
+    // Uploads directly from caller-owned memory (e.g. a mapped mesh cache file)
+    SceneObject(const Vertex *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount);
+    // Packed vertex format (see VertexPacking)
+    SceneObject(const PackedVertexData &vertices, const unsigned int *indices, size_t indexCount);
+    // Stores the mesh in a shared arena instead of buffers of its own, which lets Scene batch it
+    // with every other arena object (see MeshArena). The arena must outlive the object.
+    SceneObject(MeshArena &arena, const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices);
+    // Creates an empty, non-resident object whose mesh is streamed in later (see Scene::AddShapeAsync)
+    SceneObject();
     virtual ~SceneObject();
 
     void Draw(const Shader &shader);
+    virtual void Draw(const Shader &shader, const glm::mat4 &model, int lod = 0);
+
+    // LOD chain over the index buffer; without one the whole buffer is LOD 0
+    void SetLods(const std::vector<MeshLod> &levels, const std::vector<SubMesh> &subMeshes = {});
+    int GetLodCount() const { return lods.empty() ? 1 : (int)lods.size(); }
+    float GetLodError(int lod) const { return lods.empty() ? 0.0f : lods[lod].error; }
 
+    // Streaming upload: allocate the buffers once, then fill them in slices across frames.
+    // The object is only drawn after MarkResident().
+    // Indices are stored as GL_UNSIGNED_SHORT whenever every index fits: the mesh has at most
+    // MAX_SHORT_INDEX_VERTICES vertices or is partitioned into sub-meshes (set by SetLods first).
+    // SetPackedFormat switches the object to PackedVertex before the buffers are allocated.
+    void SetPackedFormat(const PackedVertexData &format);
+    void AllocateBuffers(size_t vertexCount, size_t indexCount);
+    void UploadVertices(const Vertex *vertices, size_t first, size_t count);
+    void UploadVertices(const PackedVertexData &vertices, size_t first, size_t count);
+    void UploadIndices(const unsigned int *indices, size_t first, size_t count);
+    void MarkResident();
+    // Streaming failed: the object drops its bounds and stays non-resident
+    void MarkLoadFailed();
+    bool IsLoadFailed() const { return loadFailed; }
+    size_t IndexSize() const { return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int); }
+    bool IsResident() const { return resident; }
+    bool IsInArena() const { return arena != nullptr; }
+    // The VAO Draw binds, shared by every object of an arena
+    unsigned int GetVertexArray() const;
+    // Absolute index range and base vertex of one LOD inside the arena buffers.
+    // Returns false when the level is split into sub-meshes, which batches do not handle.
+    bool GetArenaRange(int lod, uint32_t &firstIndex, uint32_t &count, int32_t &baseVertex) const;
+
+    // Object-space bounds of the mesh: an axis-aligned box and a bounding sphere centered on it.
+    // A negative 'radius' uses the half diagonal of the box; ComputeBoundingRadius gives a tighter one.
+    void SetBounds(const glm::vec3 &min, const glm::vec3 &max, float radius = -1.0f);
+    bool HasBounds() const { return hasBounds; }
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 GetBoundsCenter() const { return (boundsMin + boundsMax) * 0.5f; }
+    float GetBoundsRadius() const { return boundsRadius; }
+
+    // Local transform, relative to the parent in the scene's transform hierarchy (see Scene::SetParent)
     glm::mat4 GetModelMatrix() const;
     void SetPosition(const glm::vec3 &pos);
     void SetRotation(float angle, const glm::vec3 &axis);
@@ -33,10 +148,49 @@ public:
     glm::vec3 rotationAxis;
     glm::vec3 scale;
 
+    // Read-only outside the setters, which also keep the scene's ObjectStore row current
     bool useObjectColor = false;
     glm::vec3 objectColor = glm::vec4(1.0f);
 
-private:
+    // Called by the ObjectStore that holds this object (null when removed)
+    void LinkStore(ObjectStore *store, ObjectHandle handle);
+    ObjectHandle GetStoreHandle() const { return storeHandle; }
+    const ObjectStore *GetStore() const { return store; }
+
+protected:
     unsigned int VAO, VBO, EBO;
-    unsigned int indexCount;
+
+    // Draw building blocks: per-object uniforms and VAO, then the index ranges of one LOD
+    void SetDrawState(const Shader &shader, const glm::mat4 &model);
+    void DrawElements(int lod, GLsizei instanceCount);
+
+private:
+    unsigned int colorVBO = 0; // Packed format only
+    unsigned int indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    bool resident = false;
+    bool loadFailed = false;
+    bool hasBounds = false;
+    float boundsRadius = 0.0f;
+    std::vector<MeshLod> lods;
+    std::vector<SubMesh> subMeshes;
+
+    ObjectStore *store = nullptr;
+    ObjectHandle storeHandle;
+    void PushTransform();
+    void RefreshStore();
+
+    MeshArena *arena = nullptr;
+    MeshAllocation allocation;
+
+    bool packed = false;
+    VertexQuantization quantization;
+    glm::vec3 constantColor = glm::vec3(1.0f);
+
+    void CreateBuffers();
 };
+
+// Computes the axis-aligned bounds of a vertex range
+void ComputeBounds(const Vertex *vertices, size_t count, glm::vec3 &min, glm::vec3 &max);
+// Radius of the smallest sphere around 'center' that contains every vertex of the range
+float ComputeBoundingRadius(const Vertex *vertices, size_t count, const glm::vec3 &center);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed-size pool of worker threads used for CPU-side loading and preprocessing.
+class ThreadPool
+{
+public:
+    // threadCount == 0 uses one worker per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Queues 'task' on a worker and returns a future for its result.
+    template <class F>
+    auto Submit(F &&task) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> future = packaged->get_future();
+        Enqueue([packaged]()
+                { (*packaged)(); });
+        return future;
+    }
+
+    // Runs body(i) for every i in [0, count) using up to 'maxThreads' threads (0 = all workers).
+    // The calling thread takes part and the call returns once every index is done,
+    // so it is safe to call from inside a pool task.
+    void ParallelFor(size_t count, const std::function<void(size_t)> &body, unsigned int maxThreads = 0);
+
+    unsigned int Size() const { return (unsigned int)workers.size(); }
+
+    // Process-wide pool shared by the loaders
+    static ThreadPool &Shared();
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    void Enqueue(std::function<void()> task);
+    void WorkerLoop();
+};
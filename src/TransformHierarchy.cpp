@@ -0,0 +1,227 @@
+#include "TransformHierarchy.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <type_traits>
+
+namespace
+{
+    // Levels smaller than this are swept on the calling thread
+    const uint32_t PARALLEL_LEVEL_SIZE = 8192;
+    const uint32_t PARALLEL_CHUNK_SIZE = 2048;
+
+    glm::mat4 ComposeTrs(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+    {
+        glm::mat3 r = glm::mat3_cast(rotation);
+        return glm::mat4(glm::vec4(r[0] * scale.x, 0.0f), glm::vec4(r[1] * scale.y, 0.0f), glm::vec4(r[2] * scale.z, 0.0f),
+                         glm::vec4(translation, 1.0f));
+    }
+}
+
+TransformHierarchy::NodeId TransformHierarchy::Create(NodeId parent)
+{
+    NodeId node;
+    if (!freeIds.empty())
+    {
+        node = freeIds.back();
+        freeIds.pop_back();
+    }
+    else
+    {
+        node = (NodeId)parents.size();
+        parents.push_back(NULL_NODE);
+        firstChildren.push_back(NULL_NODE);
+        nextSiblings.push_back(NULL_NODE);
+        slots.push_back(-1);
+    }
+    parents[node] = NULL_NODE;
+    firstChildren[node] = NULL_NODE;
+    nextSiblings[node] = NULL_NODE;
+
+    // Appending keeps parents ahead of children; the level ranges are rebuilt on the next Update
+    slots[node] = (int32_t)nodeIds.size();
+    nodeIds.push_back(node);
+    parentSlots.push_back(parent == NULL_NODE ? -1 : slots[parent]);
+    translations.push_back(glm::vec3(0.0f));
+    rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    scales.push_back(glm::vec3(1.0f));
+    worlds.push_back(glm::mat4(1.0f));
+    dirty.push_back(1);
+    changed.push_back(0);
+
+    if (parent != NULL_NODE)
+        Link(node, parent);
+    orderDirty = true;
+    return node;
+}
+
+void TransformHierarchy::Destroy(NodeId node)
+{
+    Unlink(node);
+    std::vector<NodeId> stack = {node};
+    while (!stack.empty())
+    {
+        NodeId current = stack.back();
+        stack.pop_back();
+        for (NodeId child = firstChildren[current]; child != NULL_NODE; child = nextSiblings[child])
+            stack.push_back(child);
+        // The slot stays until RebuildOrder compacts the arrays
+        nodeIds[slots[current]] = NULL_NODE;
+        slots[current] = -1;
+        parents[current] = NULL_NODE;
+        freeIds.push_back(current);
+    }
+    orderDirty = true;
+}
+
+bool TransformHierarchy::SetParent(NodeId node, NodeId parent)
+{
+    for (NodeId ancestor = parent; ancestor != NULL_NODE; ancestor = parents[ancestor])
+    {
+        if (ancestor == node)
+            return false;
+    }
+    Unlink(node);
+    if (parent != NULL_NODE)
+        Link(node, parent);
+    dirty[slots[node]] = 1;
+    orderDirty = true;
+    return true;
+}
+
+void TransformHierarchy::Link(NodeId node, NodeId parent)
+{
+    parents[node] = parent;
+    nextSiblings[node] = firstChildren[parent];
+    firstChildren[parent] = node;
+}
+
+void TransformHierarchy::Unlink(NodeId node)
+{
+    NodeId parent = parents[node];
+    if (parent == NULL_NODE)
+        return;
+    NodeId *link = &firstChildren[parent];
+    while (*link != node)
+        link = &nextSiblings[*link];
+    *link = nextSiblings[node];
+    nextSiblings[node] = NULL_NODE;
+    parents[node] = NULL_NODE;
+}
+
+void TransformHierarchy::SetLocal(NodeId node, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    int32_t slot = slots[node];
+    translations[slot] = translation;
+    rotations[slot] = rotation;
+    scales[slot] = scale;
+    dirty[slot] = 1;
+}
+
+void TransformHierarchy::SetTranslation(NodeId node, const glm::vec3 &translation)
+{
+    translations[slots[node]] = translation;
+    dirty[slots[node]] = 1;
+}
+
+void TransformHierarchy::SetRotation(NodeId node, const glm::quat &rotation)
+{
+    rotations[slots[node]] = rotation;
+    dirty[slots[node]] = 1;
+}
+
+void TransformHierarchy::SetScale(NodeId node, const glm::vec3 &scale)
+{
+    scales[slots[node]] = scale;
+    dirty[slots[node]] = 1;
+}
+
+void TransformHierarchy::RebuildOrder()
+{
+    // Breadth-first from the roots, in id order so the layout does not depend on edit history
+    std::vector<NodeId> order;
+    order.reserve(nodeIds.size());
+    levelStarts.clear();
+    for (NodeId node = 0; node < (NodeId)parents.size(); ++node)
+    {
+        if (slots[node] >= 0 && parents[node] == NULL_NODE)
+            order.push_back(node);
+    }
+    size_t levelBegin = 0;
+    while (levelBegin < order.size())
+    {
+        levelStarts.push_back((uint32_t)levelBegin);
+        size_t levelEnd = order.size();
+        for (size_t i = levelBegin; i < levelEnd; ++i)
+        {
+            for (NodeId child = firstChildren[order[i]]; child != NULL_NODE; child = nextSiblings[child])
+                order.push_back(child);
+        }
+        levelBegin = levelEnd;
+    }
+    levelStarts.push_back((uint32_t)order.size());
+
+    auto permute = [&](auto &values)
+    {
+        std::remove_reference_t<decltype(values)> sorted(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            sorted[i] = values[slots[order[i]]];
+        values.swap(sorted);
+    };
+    permute(translations);
+    permute(rotations);
+    permute(scales);
+    permute(worlds);
+    permute(dirty);
+    permute(changed);
+
+    nodeIds = order;
+    for (size_t i = 0; i < order.size(); ++i)
+        slots[order[i]] = (int32_t)i;
+    parentSlots.resize(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        NodeId parent = parents[order[i]];
+        parentSlots[i] = parent == NULL_NODE ? -1 : slots[parent];
+    }
+    orderDirty = false;
+}
+
+void TransformHierarchy::UpdateRange(uint32_t begin, uint32_t end)
+{
+    for (uint32_t slot = begin; slot < end; ++slot)
+    {
+        int32_t parent = parentSlots[slot];
+        bool update = dirty[slot] || (parent >= 0 && changed[parent]);
+        changed[slot] = update ? 1 : 0;
+        if (!update)
+            continue;
+        glm::mat4 local = ComposeTrs(translations[slot], rotations[slot], scales[slot]);
+        worlds[slot] = parent >= 0 ? worlds[parent] * local : local;
+        dirty[slot] = 0;
+    }
+}
+
+void TransformHierarchy::Update()
+{
+    if (orderDirty)
+        RebuildOrder();
+
+    // A level only reads world matrices of the level above, which is complete by then
+    for (size_t level = 0; level + 1 < levelStarts.size(); ++level)
+    {
+        uint32_t begin = levelStarts[level], end = levelStarts[level + 1];
+        if (end - begin < PARALLEL_LEVEL_SIZE)
+        {
+            UpdateRange(begin, end);
+            continue;
+        }
+        size_t chunks = (end - begin + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+        ThreadPool::Shared().ParallelFor(chunks, [&](size_t chunk)
+        {
+            uint32_t chunkBegin = begin + (uint32_t)chunk * PARALLEL_CHUNK_SIZE;
+            UpdateRange(chunkBegin, std::min(end, chunkBegin + PARALLEL_CHUNK_SIZE));
+        });
+    }
+
+    lastUpdatedCount = (size_t)std::count(changed.begin(), changed.end(), (uint8_t)1);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Parent/child transforms with cached world matrices.
+//
+// Nodes are addressed by stable ids, but their data lives in structure-of-arrays storage sorted
+// breadth-first: every parent precedes its children and each depth level is a contiguous range.
+// Update() is then one linear sweep per level that recomputes only the world matrices whose local
+// transform, or whose parent's world matrix, changed since the last Update. The nodes of a level
+// are independent, so large levels are split across the shared thread pool.
+class TransformHierarchy
+{
+public:
+    using NodeId = int32_t;
+    static const NodeId NULL_NODE = -1;
+
+    NodeId Create(NodeId parent = NULL_NODE);
+    // Destroys the node and its whole subtree
+    void Destroy(NodeId node);
+    // Returns false (and changes nothing) if 'parent' is 'node' or one of its descendants
+    bool SetParent(NodeId node, NodeId parent);
+    NodeId GetParent(NodeId node) const { return parents[node]; }
+    NodeId GetFirstChild(NodeId node) const { return firstChildren[node]; }
+    NodeId GetNextSibling(NodeId node) const { return nextSiblings[node]; }
+
+    // Local transform relative to the parent: translate * rotate * scale
+    void SetLocal(NodeId node, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale);
+    void SetTranslation(NodeId node, const glm::vec3 &translation);
+    void SetRotation(NodeId node, const glm::quat &rotation);
+    void SetScale(NodeId node, const glm::vec3 &scale);
+    const glm::vec3 &GetTranslation(NodeId node) const { return translations[slots[node]]; }
+    const glm::quat &GetRotation(NodeId node) const { return rotations[slots[node]]; }
+    const glm::vec3 &GetScale(NodeId node) const { return scales[slots[node]]; }
+
+    // Propagates pending changes to the world matrices
+    void Update();
+
+    // As of the last Update
+    const glm::mat4 &GetWorld(NodeId node) const { return worlds[slots[node]]; }
+    // Whether the last Update changed the node's world matrix
+    bool IsChanged(NodeId node) const { return changed[slots[node]] != 0; }
+
+    size_t Size() const { return nodeIds.size(); }
+    size_t LevelCount() const { return levelStarts.empty() ? 0 : levelStarts.size() - 1; }
+    size_t LastUpdatedCount() const { return lastUpdatedCount; }
+
+private:
+    // Structure, indexed by node id
+    std::vector<NodeId> parents;
+    std::vector<NodeId> firstChildren;
+    std::vector<NodeId> nextSiblings;
+    std::vector<int32_t> slots; // Position in the arrays below; -1 when the id is free
+    std::vector<NodeId> freeIds;
+
+    // Transform data in breadth-first order, indexed by slot
+    std::vector<NodeId> nodeIds;
+    std::vector<int32_t> parentSlots;
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> worlds;
+    std::vector<uint8_t> dirty;   // Local transform set since the last Update
+    std::vector<uint8_t> changed; // World matrix recomputed by the last Update
+
+    std::vector<uint32_t> levelStarts; // Slot range of each depth level, plus the end
+    bool orderDirty = false;
+    size_t lastUpdatedCount = 0;
+
+    void Link(NodeId node, NodeId parent);
+    void Unlink(NodeId node);
+    void RebuildOrder();
+    void UpdateRange(uint32_t begin, uint32_t end);
+};
@@ -0,0 +1,99 @@
+#include "VertexPacking.h"
+
+#include <glm/gtc/packing.hpp>
+#include <cmath>
+
+namespace
+{
+    // Sign that maps zero to +1, so both octahedron halves fold consistently
+    glm::vec2 SignNotZero(const glm::vec2 &v)
+    {
+        return glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    uint32_t PackColor(const glm::vec3 &color)
+    {
+        glm::vec3 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+        return (uint32_t)c.r | ((uint32_t)c.g << 8) | ((uint32_t)c.b << 16) | (255u << 24);
+    }
+}
+
+glm::vec2 VertexPacking::OctEncode(const glm::vec3 &normal)
+{
+    float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (l1 == 0.0f)
+        return glm::vec2(0.0f);
+
+    glm::vec2 p = glm::vec2(normal) / l1;
+    if (normal.z < 0.0f)
+        p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * SignNotZero(p);
+    return p;
+}
+
+glm::vec3 VertexPacking::OctDecode(const glm::vec2 &encoded)
+{
+    glm::vec3 n(encoded, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+    if (n.z < 0.0f)
+    {
+        glm::vec2 folded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * SignNotZero(glm::vec2(n));
+        n.x = folded.x;
+        n.y = folded.y;
+    }
+    return glm::normalize(n);
+}
+
+void VertexPacking::Pack(const Vertex *vertices, size_t vertexCount, PackedVertexData &out)
+{
+    glm::vec3 min, max;
+    ComputeBounds(vertices, vertexCount, min, max);
+
+    // Flat axes get a unit scale so the dequantization never divides by zero
+    glm::vec3 extent = max - min;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (extent[axis] <= 0.0f)
+            extent[axis] = 1.0f;
+    }
+    out.quantization.offset = min;
+    out.quantization.scale = extent;
+    out.boundsMin = min;
+    out.boundsMax = max;
+    out.boundsRadius = ComputeBoundingRadius(vertices, vertexCount, (min + max) * 0.5f);
+
+    out.vertices.resize(vertexCount);
+    bool uniformColor = true;
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const Vertex &v = vertices[i];
+        PackedVertex &p = out.vertices[i];
+
+        glm::vec3 q = glm::clamp((v.Position - min) / extent, 0.0f, 1.0f);
+        p.Position[0] = glm::packUnorm1x16(q.x);
+        p.Position[1] = glm::packUnorm1x16(q.y);
+        p.Position[2] = glm::packUnorm1x16(q.z);
+        p.Position[3] = 0;
+
+        glm::vec2 n = OctEncode(v.Normal);
+        p.Normal[0] = (int16_t)glm::packSnorm1x16(n.x);
+        p.Normal[1] = (int16_t)glm::packSnorm1x16(n.y);
+
+        p.TexCoords[0] = glm::packHalf1x16(v.TexCoords.x);
+        p.TexCoords[1] = glm::packHalf1x16(v.TexCoords.y);
+
+        uniformColor &= v.Color == vertices[0].Color;
+    }
+
+    out.colors.clear();
+    out.constantColor = vertexCount > 0 ? vertices[0].Color : glm::vec3(1.0f);
+    if (!uniformColor)
+    {
+        out.colors.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i)
+            out.colors[i] = PackColor(vertices[i].Color);
+    }
+}
+
+size_t VertexPacking::ByteSize(const PackedVertexData &data)
+{
+    return data.vertices.size() * sizeof(PackedVertex) + data.colors.size() * sizeof(uint32_t);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include "Shape.h"
+
+// Conversion of full-float vertices to the 16-byte PackedVertex layout (plus an optional color stream).
+namespace VertexPacking
+{
+    // Quantizes positions to the bounds of 'vertices', octahedral-encodes normals and converts texcoords
+    // to half floats. The color stream is dropped when every vertex has the same color.
+    void Pack(const Vertex *vertices, size_t vertexCount, PackedVertexData &out);
+
+    // Unit vector <-> octahedral encoding in [-1, 1]^2 (matches OctDecode in the vertex shaders)
+    glm::vec2 OctEncode(const glm::vec3 &normal);
+    glm::vec3 OctDecode(const glm::vec2 &encoded);
+
+    // GPU bytes of the packed streams
+    size_t ByteSize(const PackedVertexData &data);
+}
@@ -1,8 +1,9 @@
+#pragma once
 #include <vector>
 #include "Shape.h"
 
 // Helper to generate a cube
-void generateCube(float size, std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+inline void generateCube(float size, std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
 {
     float s = size / 2.0f;
     // 24 vertices for hard edges
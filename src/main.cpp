@@ -15,16 +15,26 @@
 #include "sphereGenerator.h"
 #include "ModelLoader.h"
 #include "cubeGenerator.h"
+#include "InstancedObject.h"
+#include <glm/gtc/constants.hpp>
+#include "Benchmark.h"
+#include "RenderState.h"
 
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
 
-int main()
+int main(int argc, char **argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "--bench")
+        return RunBenchmarks(argc - 2, argv + 2);
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Must match the G-buffer's depth/stencil format, which Scene copies into the window
+    glfwWindowHint(GLFW_DEPTH_BITS, 24);
+    glfwWindowHint(GLFW_STENCIL_BITS, 8);
 
     GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "gk OpenGL Project", NULL, NULL);
     if (window == NULL)
@@ -38,7 +48,7 @@ int main()
     if (glewInit() != GLEW_OK)
         return -1;
 
-    glEnable(GL_DEPTH_TEST);
+    RenderState::SetEnabled(GL_DEPTH_TEST, true);
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -46,7 +56,11 @@ int main()
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
 
-    Scene scene(SCR_WIDTH, SCR_HEIGHT);
+    // The framebuffer can be larger than the window on high-DPI displays
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    glViewport(0, 0, framebufferWidth, framebufferHeight);
+    Scene scene(framebufferWidth, framebufferHeight);
     InputHandler inputHandler(window, &scene);
     glfwSetWindowUserPointer(window, &inputHandler);
 
@@ -55,19 +69,31 @@ int main()
     glfwSetFramebufferSizeCallback(window, InputHandler::FramebufferSizeCallback);
 
     ShaderManager shaderManager;
-    Shader *phongShader = shaderManager.LoadShader("phong", "shaders/phong.vs.glsl", "shaders/phong.fs.glsl");
+    // Submitted as one batch so the driver can compile them in parallel
+    std::vector<Shader *> loadedShaders = shaderManager.LoadShaders({
+        {"phong", "shaders/phong.vs.glsl", "shaders/phong.fs.glsl"},
+        {"gbuffer", "shaders/gbuffer.vs.glsl", "shaders/gbuffer.fs.glsl"},
+        {"lighting_pass", "shaders/lighting_pass.vs.glsl", "shaders/lighting_pass.fs.glsl"},
+        {"light_volume", "shaders/light_volume.vs.glsl", "shaders/light_volume.fs.glsl"},
+        // Full-screen quad like the lighting pass
+        {"upscale", "shaders/lighting_pass.vs.glsl", "shaders/upscale.fs.glsl"},
+    });
+    Shader *phongShader = loadedShaders[0];
 
     // Deferred Shading Setup
-    Shader *gbufferShader = shaderManager.LoadShader("gbuffer", "shaders/gbuffer.vs.glsl", "shaders/gbuffer.fs.glsl");
-    Shader *lightingPassShader = shaderManager.LoadShader("lighting_pass", "shaders/lighting_pass.vs.glsl", "shaders/lighting_pass.fs.glsl");
+    Shader *gbufferShader = loadedShaders[1];
+    Shader *lightingPassShader = loadedShaders[2];
 
     // Configure samplers for lighting pass (texture unit indices)
     lightingPassShader->use();
-    lightingPassShader->setInt("gPosition", 0);
+    lightingPassShader->setInt("gDepth", 0);
     lightingPassShader->setInt("gNormal", 1);
     lightingPassShader->setInt("gAlbedoSpec", 2);
 
     scene.SetDeferredShaders(gbufferShader, lightingPassShader);
+    scene.SetShaderVariants(&shaderManager, "gbuffer", "lighting_pass");
+    scene.SetLightVolumeShader(loadedShaders[3]);
+    scene.SetUpscaleShader(loadedShaders[4]);
 
     // --- Cameras ---
     Camera *camStatic = new Camera(glm::vec3(0.0f, 15.0f, 25.0f));
@@ -101,11 +127,18 @@ int main()
     PointLight *pointLight = new PointLight(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.8f, 0.8f, 1.0f));
     scene.AddLight(pointLight);
 
+    // Street lamps: a grid of short-range point lights over the floor, added from the UI to load the
+    // clustered and light volume paths. In full-screen mode only the MAX_FRAME_LIGHTS lights nearest the
+    // camera are shaded.
+    std::vector<PointLight *> streetLamps;
+    int streetLampCount = 0;
+
     std::vector<Vertex> sphereV;
     std::vector<unsigned int> sphereI;
     generateSphere(1.0f, 36, sphereV, sphereI);
 
-    SceneObject *sphere = new SceneObject(sphereV, sphereI);
+    // Static scenery shares the scene's mesh arena, so it is drawn in one batch (see MeshArena)
+    SceneObject *sphere = new SceneObject(scene.GetMeshArena(), sphereV, sphereI);
     sphere->SetPosition(glm::vec3(0.0f, 3.0f, 0.0f));
     sphere->SetScale(glm::vec3(2.0f));
     // sphere->SetObjectColor(glm::vec3(0.2f, 0.2f, 0.7f), true); // Red
@@ -116,23 +149,58 @@ int main()
     std::vector<unsigned int> cubeI;
     generateCube(1.0f, cubeV, cubeI);
 
-    SceneObject *floor = new SceneObject(cubeV, cubeI);
+    SceneObject *floor = new SceneObject(scene.GetMeshArena(), cubeV, cubeI);
     floor->SetPosition(glm::vec3(0.0f, -0.1f, 0.0f)); // Just below 0
     floor->SetScale(glm::vec3(40.0f, 0.1f, 40.0f));
     floor->SetObjectColor(glm::vec3(0.5f, 0.9f, 0.5f), true); // Greenish
     scene.AddShape(floor, phongShader);
 
-    SceneObject *carModel = ModelLoader::LoadObj("models/Porsche_911_GT2.obj");
-    if (!carModel)
+    // Bollards along the inside of the track; each is its own object and mesh in the arena
+    const int bollardCount = 64;
+    for (int i = 0; i < bollardCount; ++i)
     {
-        // Fallback or exit
-        std::cout << "Failed to load car model!" << std::endl;
-        return -1;
+        float angle = i * glm::two_pi<float>() / bollardCount;
+        SceneObject *bollard = new SceneObject(scene.GetMeshArena(), cubeV, cubeI);
+        bollard->SetPosition(glm::vec3(sin(angle) * 16.0f, 0.4f, cos(angle) * 16.0f));
+        bollard->SetScale(glm::vec3(0.2f, 0.8f, 0.2f));
+        bollard->SetObjectColor(i % 2 ? glm::vec3(0.9f) : glm::vec3(0.9f, 0.2f, 0.1f), true);
+        scene.AddShape(bollard, phongShader);
+    }
+
+    // A ring of small spheres around the track: one mesh, one instanced draw
+    std::vector<Vertex> smallSphereV;
+    std::vector<unsigned int> smallSphereI;
+    generateSphere(0.15f, 12, smallSphereV, smallSphereI);
+    InstancedObject *sphereRing = new InstancedObject(smallSphereV, smallSphereI);
+    const int ringInstances = 10000;
+    const int ringRows = 10;
+    auto ringTransform = [&](int i, float height)
+    {
+        float angle = (i / ringRows) * glm::two_pi<float>() / (ringInstances / ringRows);
+        float ringRadius = 18.0f + (i % ringRows) * 0.35f;
+        return glm::translate(glm::mat4(1.0f), glm::vec3(sin(angle) * ringRadius, 0.15f + height, cos(angle) * ringRadius));
+    };
+    for (int i = 0; i < ringInstances; ++i)
+    {
+        float hue = (float)(i / ringRows) / (ringInstances / ringRows);
+        glm::vec4 color(0.5f + 0.5f * sin(hue * 6.28f), 0.5f + 0.5f * sin(hue * 6.28f + 2.09f), 0.5f + 0.5f * sin(hue * 6.28f + 4.19f), 1.0f);
+        sphereRing->AddInstance(ringTransform(i, 0.0f), color);
     }
+    scene.AddShape(sphereRing, phongShader);
+
+    // Streams in the background; drawn as a bounding box until resident
+    LoadOptions carOptions;
+    carOptions.optimize = true;
+    carOptions.lodLevels = 4;
+    carOptions.packVertices = true;
+    carOptions.partitionSubMeshes = true;
+    SceneObject *carModel = scene.AddShapeAsync(ModelLoader::LoadObjAsync("models/Porsche_911_GT2.obj", carOptions), phongShader);
     carModel->SetPosition(glm::vec3(0.0f, 0.0f, 0.0f));
     carModel->SetScale(glm::vec3(1.0f));                         // Adjust if needed
     carModel->SetObjectColor(glm::vec3(1.0f, 0.2f, 0.2f), true); // Red
-    scene.AddShape(carModel, phongShader);
+
+    // Attached Cam: 8 units behind the car (the model faces -Z), up a bit, looking slightly above center
+    scene.AttachCamera(camAttached, carModel, glm::vec3(0.0f, 3.0f, 8.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
     float timeOfDay = 0.5f;
 
@@ -172,9 +240,18 @@ int main()
         carModel->SetPosition(carPos);
         carModel->SetRotation(carRotAngle, glm::vec3(0.0f, 1.0f, 0.0f));
 
+        // A wave runs around the sphere ring; only the instances it covers are re-uploaded
+        const int waveLength = 500;
+        int waveStart = ((int)(time * 2000.0f) % ringInstances) / ringRows * ringRows;
+        for (int i = 0; i < waveLength; ++i)
+        {
+            int index = (waveStart + i) % ringInstances;
+            sphereRing->SetInstanceTransform(index, ringTransform(index, 0.4f * sin(glm::pi<float>() * i / waveLength)));
+        }
+
         // --- Update Headlights ---
-        // Construct rotation matrix for the car
-        glm::mat4 carMat = glm::rotate(glm::mat4(1.0f), carModel->rotationAngle, carModel->rotationAxis);
+        // The headlights are children of the car (see Scene::AttachLight); only their local
+        // placement is set here, from the calibration values, and the scene carries them along.
 
         // Base forward vector (-Z)
         glm::vec4 baseForward(0.0f, 0.0f, -1.0f, 0.0f);
@@ -192,31 +269,13 @@ int main()
         glm::vec3 dirLeftLocal = glm::vec3(toeLeftRot * pitchRot * baseForward);
         glm::vec3 dirRightLocal = glm::vec3(toeRightRot * pitchRot * baseForward);
 
-        // Transform to World Space
-        glm::vec3 worldDirLeft = glm::normalize(glm::vec3(carMat * glm::vec4(dirLeftLocal, 0.0f)));
-        glm::vec3 worldDirRight = glm::normalize(glm::vec3(carMat * glm::vec4(dirRightLocal, 0.0f)));
-
-        // Calculate World Positions of headlights
-        glm::vec3 leftPos = carPos + glm::vec3(carMat * glm::vec4(hlOffsetLeft, 1.0f));
-        glm::vec3 rightPos = carPos + glm::vec3(carMat * glm::vec4(hlOffsetRight, 1.0f));
-
-        leftHeadlight->position = leftPos;
-        leftHeadlight->direction = worldDirLeft;
-
-        rightHeadlight->position = rightPos;
-        rightHeadlight->direction = worldDirRight;
+        scene.AttachLight(leftHeadlight, carModel, hlOffsetLeft, dirLeftLocal);
+        scene.AttachLight(rightHeadlight, carModel, hlOffsetRight, dirRightLocal);
 
         // Cameras
         // Tracking Cam: Looks at car
         camTracking->LookAt(carPos);
 
-        // Attached Cam: Behind the car
-        // Offset backward from carFront.
-        // If carFront is the tangent, normalize(carFront) is forward direction.
-        glm::vec3 camOffset = glm::normalize(carFront) * 8.0f;                    // 8 units behind
-        camAttached->Position = carPos - camOffset + glm::vec3(0.0f, 3.0f, 0.0f); // Up a bit
-        camAttached->LookAt(carPos + glm::vec3(0.0f, 1.0f, 0.0f));                // Look slightly above center
-
         scene.SetActiveCamera(currentCamIdx);
 
         // Env
@@ -225,6 +284,23 @@ int main()
         glm::vec3 clearCol = glm::mix(nightColor, dayColor, sin(timeOfDay * 3.14159f));
         sunLight->color = glm::vec3(sin(timeOfDay * 3.14159f));
 
+        while ((int)streetLamps.size() > streetLampCount)
+        {
+            scene.RemoveLight(streetLamps.back());
+            streetLamps.pop_back();
+        }
+        while ((int)streetLamps.size() < streetLampCount)
+        {
+            int index = (int)streetLamps.size();
+            glm::vec3 position(-19.0f + (index % 64) * 0.6f, 0.3f, -19.0f + (index / 64) * 0.6f);
+            glm::vec3 color = glm::abs(glm::sin((float)index * glm::vec3(1.3f, 2.1f, 3.7f))) * 0.5f + 0.1f;
+            PointLight *lamp = new PointLight(position, color);
+            lamp->linear = 0.7f;
+            lamp->quadratic = 50.0f; // Fades out within about 1.6 units
+            scene.AddLight(lamp);
+            streetLamps.push_back(lamp);
+        }
+
         // Sync fog color with environment
         scene.fogColor = clearCol;
 
@@ -244,6 +320,8 @@ int main()
         ImGui::NewFrame();
 
         scene.Draw();
+        UniformStats uniformStats = Shader::EndFrameStats();
+        RenderStateStats renderStateStats = RenderState::EndFrameStats();
 
         ImGui::Begin("Controls");
         if (ImGui::CollapsingHeader("Cameras", ImGuiTreeNodeFlags_DefaultOpen))
@@ -265,8 +343,50 @@ int main()
         }
         if (ImGui::CollapsingHeader("Deferred Shading"))
         {
-            const char *modes[] = {"Combined Lighting", "Position (View Space)", "Normal (View Space)", "Albedo", "Specular"};
-            ImGui::Combo("Display Mode", &scene.gBufferDisplayMode, modes, 5);
+            const char *modes[] = {"Combined Lighting", "Position (View Space)", "Normal (View Space)", "Albedo", "Specular", "Depth (Linear)"};
+            ImGui::Combo("Display Mode", &scene.gBufferDisplayMode, modes, 6);
+            ImGui::Checkbox("Specialized Shader Variants", &scene.useShaderVariants);
+            const char *lightingModes[] = {"Full-screen", "Clustered", "Light Volumes"};
+            int lightingMode = (int)scene.lightingMode;
+            if (ImGui::Combo("Point/Spot Lighting", &lightingMode, lightingModes, 3))
+                scene.lightingMode = (Scene::LightingMode)lightingMode;
+            ImGui::SliderInt("Street Lamps", &streetLampCount, 0, LightClusters::MAX_LIGHTS);
+            const LightClusters &clusters = scene.GetLightClusters();
+            ImGui::Text("Clusters: %zu lights, %zu list entries, max %u per cluster", clusters.LightCount(),
+                        clusters.IndexCount(), clusters.MaxClusterLights());
+            ImGui::Text("Light assignment: %.3f ms", scene.lightAssignMs);
+            ImGui::Text("Shaded fragments: %zu full-screen, %zu point volumes, %zu spot volumes", scene.shadedFragments[0],
+                        scene.shadedFragments[1], scene.shadedFragments[2]);
+            ImGui::Checkbox("Dynamic Resolution", &scene.dynamicResolution);
+            if (scene.dynamicResolution)
+                ImGui::SliderFloat("Frame Budget (ms)", &scene.resolutionController.targetMs, 2.0f, 50.0f);
+            else
+                ImGui::SliderFloat("Render Scale", &scene.renderScale, DynamicResolution::MIN_SCALE, DynamicResolution::MAX_SCALE);
+            ImGui::Text("Render size: %d x %d (%.0f%%), GPU frame: %.2f ms", scene.GetRenderWidth(), scene.GetRenderHeight(),
+                        scene.renderScale * 100.0f, scene.gpuFrameMs);
+        }
+        if (ImGui::CollapsingHeader("Statistics"))
+        {
+            ImGui::Text("Uniform lookups eliminated: %u / frame", uniformStats.DriverLookupsEliminated());
+            ImGui::Text("  by id: %u, by name: %u", uniformStats.idSets, uniformStats.nameLookups);
+            ImGui::Text("State changes: %u issued, %u elided / frame", renderStateStats.issued, renderStateStats.elided);
+            ImGui::Checkbox("Sort Draws", &scene.sortDraws);
+            ImGui::Checkbox("Frustum Culling", &scene.frustumCulling);
+            ImGui::SameLine();
+            ImGui::Checkbox("Use BVH", &scene.useBvhCulling);
+            ImGui::Text("Objects: %zu visible, %zu culled", scene.visibleCount, scene.culledCount);
+            ImGui::Text("BVH: %zu leaves, height %d", scene.GetBvh().Size(), scene.GetBvh().GetHeight());
+            ImGui::Text("Transforms: %zu nodes, %zu levels, %zu updated", scene.GetTransforms().Size(),
+                        scene.GetTransforms().LevelCount(), scene.GetTransforms().LastUpdatedCount());
+            ImGui::Text("Instances uploaded: %zu / %zu", sphereRing->GetLastUploadCount(), sphereRing->GetInstanceCount());
+            ImGui::Text("Streaming: %zu pending, %zu failed", scene.PendingUploadCount(), scene.FailedLoadCount());
+            ImGui::Checkbox("Batch Arena Objects", &scene.batchArenaObjects);
+            ImGui::Text("Arena: %zu objects in %zu draw calls", scene.arenaBatchedCount, scene.arenaDrawCalls);
+            // Compare with and without shader variants; under a software driver (LIBGL_ALWAYS_SOFTWARE=1)
+            // the lighting pass is fragment bound, so this is a direct pixel throughput figure
+            float lightingPixels = (float)scene.GetRenderWidth() * scene.GetRenderHeight(); // The rendered part of the G-buffer
+            ImGui::Text("Lighting pass: %.3f ms (%.1f Mpixels/s)", scene.lightingPassMs,
+                        scene.lightingPassMs > 0.0f ? lightingPixels / (scene.lightingPassMs * 1000.0f) : 0.0f);
         }
         if (ImGui::CollapsingHeader("Environment"))
         {
@@ -313,6 +433,8 @@ int main()
 
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        // ImGui binds its own program, VAO and texture behind RenderState's back
+        RenderState::Invalidate();
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
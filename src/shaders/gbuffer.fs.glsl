@@ -1,25 +1,43 @@
 #version 330 core
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec4 gAlbedoSpec;
+// Compact G-buffer: the position is rebuilt from the depth buffer in the lighting pass, and the
+// view-space normal is octahedral-encoded into two unorm16 channels
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gAlbedoSpec;
 
-in vec3 FragPos;
 in vec3 Normal;
 in vec3 Albedo;
 
-uniform bool useObjectColor;
 uniform vec3 objectColor;
 
+// Compile-time specialization (see ShaderManager::GetVariant): OBJECT_COLOR 1 writes 'objectColor',
+// 0 the interpolated vertex color. Undefined, the choice is made at runtime by 'useObjectColor'.
+#ifndef OBJECT_COLOR
+uniform bool useObjectColor;
+#endif
+
+// Unit vector to the octahedron unfolded onto [-1, 1]^2, then to [0, 1] for the unorm target
+vec2 OctEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
 void main()
 {
-    // Store the fragment position vector in the first gbuffer texture
-    gPosition = FragPos;
-    
-    // Also store the per-fragment normals into the gbuffer
-    gNormal = normalize(Normal);
+    // Store the per-fragment normals into the gbuffer
+    gNormal = OctEncode(normalize(Normal));
     
     // And the color per object
+#ifdef OBJECT_COLOR
+  #if OBJECT_COLOR
+    gAlbedoSpec.rgb = objectColor;
+  #else
+    gAlbedoSpec.rgb = Albedo;
+  #endif
+#else
     gAlbedoSpec.rgb = useObjectColor ? objectColor : Albedo;
+#endif
     
     // Store specular intensity in gAlbedoSpec's alpha component
     gAlbedoSpec.a = 1.0; 
@@ -2,24 +2,74 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
 layout (location = 2) in vec3 aNormal;
+// Instancing (see InstancedObject): per-instance transform (4-7) and color, used when 'instanced' is set
+layout (location = 4) in mat4 aInstanceTransform;
+layout (location = 8) in vec4 aInstanceColor;
+// Mesh arena batches (see MeshArena): the model matrix and object color come from 'drawData',
+// five texels per draw, indexed by the draw id. Used when 'arenaDraw' is set.
+layout (location = 9) in uint aDrawId;
 
-out vec3 FragPos;
 out vec3 Normal;
 out vec3 Albedo;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform bool instanced;
+uniform bool arenaDraw;
+uniform samplerBuffer drawData;
+
+// Per-frame data shared by every program (see FrameData.h); lights are in view space
+#define MAX_LIGHTS 8
+struct PackedLight {
+    vec4 positionType;     // xyz position, w type (0=Dir, 1=Point, 2=Spot)
+    vec4 directionCutOff;  // xyz direction, w cutOff
+    vec4 colorOuterCutOff; // rgb color, w outerCutOff
+    vec4 attenuation;      // x constant, y linear, z quadratic, w range (see AttenuationRange)
+};
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseProjection; // Reconstructs view-space positions from depth
+    vec4 fogColor;  // rgb
+    vec4 fogParams; // x start, y end, z enabled
+    ivec4 lightCount;
+    PackedLight lights[MAX_LIGHTS];
+};
+
+// Packed vertex format (see VertexPacking): unorm16 positions within the mesh bounds,
+// octahedral normals in 'aNormal.xy'
+uniform bool packedVertices;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+vec3 OctDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
 
 void main()
 {
-    vec4 viewPos4 = view * model * vec4(aPos, 1.0);
-    FragPos = viewPos4.xyz; 
+    vec3 position = packedVertices ? positionOffset + aPos * positionScale : aPos;
+    vec3 normal = packedVertices ? OctDecode(aNormal.xy) : aNormal;
+    mat4 world = instanced ? model * aInstanceTransform : model;
+    vec3 color = instanced ? aInstanceColor.rgb : aColor;
+    if (arenaDraw)
+    {
+        int texel = int(aDrawId) * 5;
+        world = mat4(texelFetch(drawData, texel), texelFetch(drawData, texel + 1),
+                     texelFetch(drawData, texel + 2), texelFetch(drawData, texel + 3));
+        vec4 drawColor = texelFetch(drawData, texel + 4);
+        color = drawColor.a > 0.5 ? drawColor.rgb : aColor;
+    }
+
+    vec4 viewPos4 = view * world * vec4(position, 1.0);
     
-    Albedo = aColor; // Or sample from texture if enabled
+    Albedo = color; // Or sample from texture if enabled
     
     // Normal Matrix for View Space
-    Normal = mat3(view * model) * aNormal; 
+    Normal = mat3(view * world) * normal; 
     
     gl_Position = projection * viewPos4;
 }
@@ -0,0 +1,153 @@
+#version 330 core
+// Shades the G-buffer pixels covered by one point or spot light volume (see LightVolumes);
+// the results are blended additively over the directional lighting pass
+out vec4 FragColor;
+
+flat in int LightIndex;
+
+uniform sampler2D gDepth;  // Geometry pass depth; positions are rebuilt from it
+uniform sampler2D gNormal; // Octahedral-encoded view-space normal (see gbuffer.fs)
+uniform sampler2D gAlbedoSpec;
+uniform samplerBuffer volumeLights;
+uniform vec2 renderScale; // Rendered part of the G-buffer (lower left), over its size
+
+struct Light {
+    int type; // 1=Point, 2=Spot
+    vec3 position;  // VIEW SPACE
+    vec3 direction; // VIEW SPACE
+    vec3 color;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    float cutOff;
+    float outerCutOff;
+};
+
+// Per-frame data shared by every program (see FrameData.h); lights are in view space
+#define MAX_LIGHTS 8
+struct PackedLight {
+    vec4 positionType;     // xyz position, w type (0=Dir, 1=Point, 2=Spot)
+    vec4 directionCutOff;  // xyz direction, w cutOff
+    vec4 colorOuterCutOff; // rgb color, w outerCutOff
+    vec4 attenuation;      // x constant, y linear, z quadratic, w range (see AttenuationRange)
+};
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseProjection; // Reconstructs view-space positions from depth
+    vec4 fogColor;  // rgb
+    vec4 fogParams; // x start, y end, z enabled
+    ivec4 lightCount;
+    PackedLight lights[MAX_LIGHTS];
+};
+
+Light GetVolumeLight(int i)
+{
+    vec4 positionType = texelFetch(volumeLights, i * 4);
+    vec4 directionCutOff = texelFetch(volumeLights, i * 4 + 1);
+    vec4 colorOuterCutOff = texelFetch(volumeLights, i * 4 + 2);
+    vec4 attenuation = texelFetch(volumeLights, i * 4 + 3);
+    Light light;
+    light.type = int(positionType.w);
+    light.position = positionType.xyz;
+    light.direction = directionCutOff.xyz;
+    light.color = colorOuterCutOff.rgb;
+    light.constant = attenuation.x;
+    light.linear = attenuation.y;
+    light.quadratic = attenuation.z;
+    light.cutOff = directionCutOff.w;
+    light.outerCutOff = colorOuterCutOff.w;
+    return light;
+}
+
+// View-space position of the surface at 'uv' with window depth 'depth'
+vec3 ViewPosition(vec2 uv, float depth)
+{
+    vec4 position = inverseProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+vec3 OctDecode(vec2 encoded)
+{
+    vec2 e = encoded * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
+
+void main()
+{
+    // The volume is drawn over the rendered part of the G-buffer, so the pixel addresses it directly
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec2 uv = (vec2(pixel) + 0.5) / (vec2(textureSize(gDepth, 0)) * renderScale);
+    vec3 FragPos = ViewPosition(uv, texelFetch(gDepth, pixel, 0).r);
+    vec3 Normal = OctDecode(texelFetch(gNormal, pixel, 0).rg);
+    vec3 Diffuse = texelFetch(gAlbedoSpec, pixel, 0).rgb;
+
+    vec3 viewDir = normalize(-FragPos);
+    vec3 norm = normalize(Normal);
+    Light light = GetVolumeLight(LightIndex);
+    vec3 result = light.type == 1 ? CalcPointLight(light, norm, FragPos, viewDir) : CalcSpotLight(light, norm, FragPos, viewDir);
+
+    // The lighting pass fades lighting towards the fog color; the fogged share of this light is zero
+    float fogFactor = 1.0;
+    if (fogParams.z != 0.0)
+        fogFactor = clamp((fogParams.y - length(FragPos)) / (fogParams.y - fogParams.x), 0.0, 1.0);
+    FragColor = vec4(result * Diffuse * fogFactor, 1.0);
+}
+
+vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    // attenuation
+    float distance    = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + 
+  			     light.quadratic * (distance * distance));    
+    
+    vec3 ambient  = light.color * 0.1;
+    vec3 diffuse  = light.color * diff * 0.8;
+    vec3 specular = light.color * spec * 1.0;
+    ambient  *= attenuation;
+    diffuse  *= attenuation;
+    specular *= attenuation;
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction)); 
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    
+    vec3 ambient = light.color * 0.1;
+    vec3 diffuse = light.color * diff * 0.8;
+    vec3 specular = light.color * spec * 1.0;
+    
+    ambient *= attenuation * intensity;
+    diffuse *= attenuation * intensity;
+    specular *= attenuation * intensity;
+    
+    return (ambient + diffuse + specular);
+}
@@ -0,0 +1,53 @@
+#version 330 core
+// Unit sphere (point lights) or unit cone along +z with its apex at the origin (spot lights),
+// placed per instance from the light's packed data (see LightVolumes)
+layout (location = 0) in vec3 aPos;
+
+flat out int LightIndex;
+
+// Per-frame data shared by every program (see FrameData.h); lights are in view space
+#define MAX_LIGHTS 8
+struct PackedLight {
+    vec4 positionType;     // xyz position, w type (0=Dir, 1=Point, 2=Spot)
+    vec4 directionCutOff;  // xyz direction, w cutOff
+    vec4 colorOuterCutOff; // rgb color, w outerCutOff
+    vec4 attenuation;      // x constant, y linear, z quadratic, w range (see AttenuationRange)
+};
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseProjection; // Reconstructs view-space positions from depth
+    vec4 fogColor;  // rgb
+    vec4 fogParams; // x start, y end, z enabled
+    ivec4 lightCount;
+    PackedLight lights[MAX_LIGHTS];
+};
+
+uniform samplerBuffer volumeLights; // Four texels per light, the PackedLight layout
+uniform int firstLight;
+uniform bool spotVolumes;
+uniform float maxRange; // MaxLightRange of the far plane, as in the cluster bounds
+
+void main()
+{
+    LightIndex = firstLight + gl_InstanceID;
+    vec3 position = texelFetch(volumeLights, LightIndex * 4).xyz;
+    // Unbounded lights still end somewhere past the far plane
+    float range = min(texelFetch(volumeLights, LightIndex * 4 + 3).w, maxRange);
+
+    vec3 viewPos;
+    if (spotVolumes)
+    {
+        vec3 axis = normalize(texelFetch(volumeLights, LightIndex * 4 + 1).xyz);
+        float cosOuter = max(texelFetch(volumeLights, LightIndex * 4 + 2).w, 0.1);
+        float baseRadius = range * sqrt(1.0 - cosOuter * cosOuter) / cosOuter;
+        vec3 side = normalize(cross(abs(axis.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0), axis));
+        vec3 up = cross(axis, side);
+        viewPos = position + (side * aPos.x + up * aPos.y) * baseRadius + axis * (aPos.z * range);
+    }
+    else
+    {
+        viewPos = position + aPos * range;
+    }
+    gl_Position = projection * vec4(viewPos, 1.0);
+}
@@ -3,9 +3,10 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
+uniform sampler2D gDepth;  // Geometry pass depth; positions are rebuilt from it
+uniform sampler2D gNormal; // Octahedral-encoded view-space normal (see gbuffer.fs)
 uniform sampler2D gAlbedoSpec;
+uniform vec2 renderScale; // Rendered part of the G-buffer (lower left), over its size
 
 struct Light {
     int type; // 0=Dir, 1=Point, 2=Spot
@@ -21,16 +22,109 @@ struct Light {
     float outerCutOff;
 };
 
+// Per-frame data shared by every program (see FrameData.h); lights are in view space
 #define MAX_LIGHTS 8
-uniform Light lights[MAX_LIGHTS];
-uniform int numLights;
+struct PackedLight {
+    vec4 positionType;     // xyz position, w type (0=Dir, 1=Point, 2=Spot)
+    vec4 directionCutOff;  // xyz direction, w cutOff
+    vec4 colorOuterCutOff; // rgb color, w outerCutOff
+    vec4 attenuation;      // x constant, y linear, z quadratic, w range (see AttenuationRange)
+};
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseProjection; // Reconstructs view-space positions from depth
+    vec4 fogColor;  // rgb
+    vec4 fogParams; // x start, y end, z enabled
+    ivec4 lightCount;
+    PackedLight lights[MAX_LIGHTS];
+};
+
+Light UnpackLight(vec4 positionType, vec4 directionCutOff, vec4 colorOuterCutOff, vec4 attenuation)
+{
+    Light light;
+    light.type = int(positionType.w);
+    light.position = positionType.xyz;
+    light.direction = directionCutOff.xyz;
+    light.color = colorOuterCutOff.rgb;
+    light.constant = attenuation.x;
+    light.linear = attenuation.y;
+    light.quadratic = attenuation.z;
+    light.cutOff = directionCutOff.w;
+    light.outerCutOff = colorOuterCutOff.w;
+    return light;
+}
+
+Light GetLight(int i)
+{
+    return UnpackLight(lights[i].positionType, lights[i].directionCutOff, lights[i].colorOuterCutOff, lights[i].attenuation);
+}
 
-uniform bool fogEnabled;
-uniform vec3 fogColor;
-uniform float fogStart;
-uniform float fogEnd;
+// View-space position of the surface at 'uv' with window depth 'depth'
+vec3 ViewPosition(vec2 uv, float depth)
+{
+    vec4 position = inverseProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
 
-uniform int displayMode; // 0=Light, 1=Pos, 2=Norm, 3=Alb, 4=Spec
+vec3 OctDecode(vec2 encoded)
+{
+    vec2 e = encoded * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// Clustered point and spot lights (see LightClusters.h); the grid must match the C++ constants.
+// Directional lights always come from FrameData.
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+uniform samplerBuffer clusterLights;   // Four texels per light, the PackedLight layout
+uniform usamplerBuffer clusterRanges;  // Per cluster: first index, count
+uniform usamplerBuffer clusterIndices; // Light indices of all clusters
+uniform vec2 clusterSlices;            // slice = log(view depth) * x - y
+
+Light GetClusterLight(int i)
+{
+    return UnpackLight(texelFetch(clusterLights, i * 4), texelFetch(clusterLights, i * 4 + 1),
+                       texelFetch(clusterLights, i * 4 + 2), texelFetch(clusterLights, i * 4 + 3));
+}
+
+// Compile-time specialization (see ShaderManager::GetVariant). Without these defines the shader
+// branches at runtime; a variant fixes them so the common path has no dynamic branches:
+//   DISPLAY_MODE                                      0=Light, 1=Pos, 2=Norm, 3=Alb, 4=Spec, 5=Depth
+//   FOG_ENABLED                                       0/1
+//   NUM_DIR_LIGHTS, NUM_POINT_LIGHTS, NUM_SPOT_LIGHTS  set together; FrameData groups lights by type
+//   CLUSTERED                                         0/1, point and spot lights from the clusters
+//   LIGHT_VOLUMES                                     0/1, point and spot lights drawn as volumes (see LightVolumes)
+#ifdef DISPLAY_MODE
+#define DISPLAY DISPLAY_MODE
+#else
+uniform int displayMode; // 0=Light, 1=Pos, 2=Norm, 3=Alb, 4=Spec, 5=Depth
+#define DISPLAY displayMode
+#endif
+
+#ifdef CLUSTERED
+#define CLUSTERED_ON (CLUSTERED != 0)
+#else
+uniform bool clusteredLighting;
+#define CLUSTERED_ON clusteredLighting
+#endif
+
+#ifdef LIGHT_VOLUMES
+#define LIGHT_VOLUMES_ON (LIGHT_VOLUMES != 0)
+#else
+uniform bool lightVolumes;
+#define LIGHT_VOLUMES_ON lightVolumes
+#endif
+
+#ifdef FOG_ENABLED
+#define FOG_ON (FOG_ENABLED != 0)
+#else
+#define FOG_ON (fogParams.z != 0.0)
+#endif
 
 vec3 CalcDirLight(Light light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
@@ -39,16 +133,21 @@ vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
 void main()
 {
     // Retrieve data from gbuffer
-    vec3 FragPos = texture(gPosition, TexCoords).rgb;
-    vec3 Normal = texture(gNormal, TexCoords).rgb;
-    vec3 Diffuse = texture(gAlbedoSpec, TexCoords).rgb;
-    float Specular = texture(gAlbedoSpec, TexCoords).a;
+    vec2 gBufferCoords = TexCoords * renderScale;
+    float Depth = texture(gDepth, gBufferCoords).r;
+    vec3 FragPos = ViewPosition(TexCoords, Depth);
+    vec3 Normal = OctDecode(texture(gNormal, gBufferCoords).rg);
+    vec3 Diffuse = texture(gAlbedoSpec, gBufferCoords).rgb;
+    float Specular = texture(gAlbedoSpec, gBufferCoords).a;
     
-    // Optimization: Discard if normal is zero (background)
-    if(length(Normal) == 0.0) {
-       if (displayMode == 0) // Only discard in lighting mode to reveal skybox
+    // Background: nothing was drawn, so the depth is still the cleared 1.0
+    // (in lighting mode the stencil test already skips these pixels)
+    if(Depth == 1.0) {
+       if (DISPLAY == 0) // Only discard in lighting mode to reveal skybox
            discard;
-       // For debug modes, fall through to display the raw G-Buffer value (typically black/zero)
+       // For debug modes, fall through to display zeros as the old position/normal targets held
+       FragPos = vec3(0.0);
+       Normal = vec3(0.0);
     }
 
     // In View Space, the viewer is at (0,0,0)
@@ -58,15 +157,43 @@ void main()
     
     vec3 result = vec3(0.0);
 
-    for(int i = 0; i < numLights; i++)
+#ifdef NUM_DIR_LIGHTS
+    // Constant trip counts, one light type per loop
+    for(int i = 0; i < NUM_DIR_LIGHTS; i++)
+        result += CalcDirLight(GetLight(i), norm, viewDir);
+    for(int i = 0; i < NUM_POINT_LIGHTS; i++)
+        result += CalcPointLight(GetLight(NUM_DIR_LIGHTS + i), norm, FragPos, viewDir);
+    for(int i = 0; i < NUM_SPOT_LIGHTS; i++)
+        result += CalcSpotLight(GetLight(NUM_DIR_LIGHTS + NUM_POINT_LIGHTS + i), norm, FragPos, viewDir);
+#else
+    // With clustering or light volumes only the directional lights (the first lightCount.y) are taken from here
+    int frameLights = CLUSTERED_ON || LIGHT_VOLUMES_ON ? lightCount.y : lightCount.x;
+    for(int i = 0; i < frameLights; i++)
     {
         // Light positions/directions must be in View Space!
-        if(lights[i].type == 0) // Directional
-            result += CalcDirLight(lights[i], norm, viewDir);
-        else if(lights[i].type == 1) // Point
-            result += CalcPointLight(lights[i], norm, FragPos, viewDir);
-        else if(lights[i].type == 2) // Spot
-            result += CalcSpotLight(lights[i], norm, FragPos, viewDir);
+        Light light = GetLight(i);
+        if(light.type == 0) // Directional
+            result += CalcDirLight(light, norm, viewDir);
+        else if(light.type == 1) // Point
+            result += CalcPointLight(light, norm, FragPos, viewDir);
+        else if(light.type == 2) // Spot
+            result += CalcSpotLight(light, norm, FragPos, viewDir);
+    }
+#endif
+
+    if (CLUSTERED_ON && DISPLAY == 0)
+    {
+        ivec2 tile = min(ivec2(TexCoords * vec2(CLUSTER_TILES_X, CLUSTER_TILES_Y)), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+        int slice = clamp(int(floor(log(max(-FragPos.z, 1e-4)) * clusterSlices.x - clusterSlices.y)), 0, CLUSTER_SLICES - 1);
+        uvec2 range = texelFetch(clusterRanges, (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x).xy;
+        for(uint i = 0u; i < range.y; i++)
+        {
+            Light light = GetClusterLight(int(texelFetch(clusterIndices, int(range.x + i)).x));
+            if(light.type == 1)
+                result += CalcPointLight(light, norm, FragPos, viewDir);
+            else
+                result += CalcSpotLight(light, norm, FragPos, viewDir);
+        }
     }
 
     vec3 lighting = result * Diffuse; 
@@ -79,17 +206,18 @@ void main()
     // So yes, specular color IS multiplied by Albedo. That's fine.
 
     // Apply Fog
-    if (fogEnabled) {
+    if (FOG_ON) {
         float distance = length(FragPos); // In View Space, distance is length of position vector (camera at 0,0,0)
-        float fogFactor = (fogEnd - distance) / (fogEnd - fogStart);
+        float fogFactor = (fogParams.y - distance) / (fogParams.y - fogParams.x);
         fogFactor = clamp(fogFactor, 0.0, 1.0);
-        lighting = mix(fogColor, lighting, fogFactor);
+        lighting = mix(fogColor.rgb, lighting, fogFactor);
     }
     
-    if (displayMode == 1)      FragColor = vec4(FragPos, 1.0);
-    else if (displayMode == 2) FragColor = vec4(Normal, 1.0);
-    else if (displayMode == 3) FragColor = vec4(Diffuse, 1.0);
-    else if (displayMode == 4) FragColor = vec4(vec3(Specular), 1.0);
+    if (DISPLAY == 1)      FragColor = vec4(FragPos, 1.0);
+    else if (DISPLAY == 2) FragColor = vec4(Normal, 1.0);
+    else if (DISPLAY == 3) FragColor = vec4(Diffuse, 1.0);
+    else if (DISPLAY == 4) FragColor = vec4(vec3(Specular), 1.0);
+    else if (DISPLAY == 5) FragColor = vec4(vec3(-FragPos.z / -ViewPosition(TexCoords, 1.0).z), 1.0); // Linear, 1 at the far plane
     else                       FragColor = vec4(lighting, 1.0);
 }
 
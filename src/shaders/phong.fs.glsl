@@ -19,20 +19,42 @@ struct Light {
     float outerCutOff;
 };
 
+// Per-frame data shared by every program (see FrameData.h); lights are in view space
 #define MAX_LIGHTS 8
-uniform Light lights[MAX_LIGHTS];
-uniform int numLights;
+struct PackedLight {
+    vec4 positionType;     // xyz position, w type (0=Dir, 1=Point, 2=Spot)
+    vec4 directionCutOff;  // xyz direction, w cutOff
+    vec4 colorOuterCutOff; // rgb color, w outerCutOff
+    vec4 attenuation;      // x constant, y linear, z quadratic, w range (see AttenuationRange)
+};
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseProjection; // Reconstructs view-space positions from depth
+    vec4 fogColor;  // rgb
+    vec4 fogParams; // x start, y end, z enabled
+    ivec4 lightCount;
+    PackedLight lights[MAX_LIGHTS];
+};
+
+Light GetLight(int i)
+{
+    Light light;
+    light.type = int(lights[i].positionType.w);
+    light.position = lights[i].positionType.xyz;
+    light.direction = lights[i].directionCutOff.xyz;
+    light.color = lights[i].colorOuterCutOff.rgb;
+    light.constant = lights[i].attenuation.x;
+    light.linear = lights[i].attenuation.y;
+    light.quadratic = lights[i].attenuation.z;
+    light.cutOff = lights[i].directionCutOff.w;
+    light.outerCutOff = lights[i].colorOuterCutOff.w;
+    return light;
+}
 
-uniform vec3 viewPos; 
 uniform bool useObjectColor;
 uniform vec3 objectColor;
 
-// Fog
-uniform bool fogEnabled;
-uniform vec3 fogColor;
-uniform float fogStart;
-uniform float fogEnd;
-
 vec3 CalcDirLight(Light light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
@@ -40,28 +62,30 @@ vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
 void main()
 {
     vec3 norm = normalize(Normal);
-    vec3 viewDir = normalize(viewPos - FragPos);
+    // In View Space, the viewer is at (0,0,0)
+    vec3 viewDir = normalize(-FragPos);
     
     vec3 result = vec3(0.0);
     
-    for(int i = 0; i < numLights; i++)
+    for(int i = 0; i < lightCount.x; i++)
     {
-        if(lights[i].type == 0) // Directional
-            result += CalcDirLight(lights[i], norm, viewDir);
-        else if(lights[i].type == 1) // Point
-            result += CalcPointLight(lights[i], norm, FragPos, viewDir);
-        else if(lights[i].type == 2) // Spot
-            result += CalcSpotLight(lights[i], norm, FragPos, viewDir);
+        Light light = GetLight(i);
+        if(light.type == 0) // Directional
+            result += CalcDirLight(light, norm, viewDir);
+        else if(light.type == 1) // Point
+            result += CalcPointLight(light, norm, FragPos, viewDir);
+        else if(light.type == 2) // Spot
+            result += CalcSpotLight(light, norm, FragPos, viewDir);
     }
     
     vec3 finalColor = result * (useObjectColor ? objectColor : FragColor);
 
     // Apply Fog
-    if (fogEnabled) {
-        float distance = length(viewPos - FragPos);
-        float fogFactor = (fogEnd - distance) / (fogEnd - fogStart);
+    if (fogParams.z != 0.0) {
+        float distance = length(FragPos);
+        float fogFactor = (fogParams.y - distance) / (fogParams.y - fogParams.x);
         fogFactor = clamp(fogFactor, 0.0, 1.0);
-        finalColor = mix(fogColor, finalColor, fogFactor);
+        finalColor = mix(fogColor.rgb, finalColor, fogFactor);
     }
 
     out_FragColor = vec4(finalColor, 1.0);
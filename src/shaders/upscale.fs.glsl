@@ -0,0 +1,53 @@
+#version 330 core
+// Stretches the lighting pass output, rendered to the lower-left 'renderScale' of 'sceneColor', over the
+// whole window. Catmull-Rom bicubic filter (sharper than bilinear), evaluated with nine bilinear fetches.
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D sceneColor;
+uniform vec2 renderScale; // Rendered part of 'sceneColor' (lower left), over its size
+
+void main()
+{
+    vec2 sceneSize = vec2(textureSize(sceneColor, 0));
+    vec2 renderSize = sceneSize * renderScale;
+
+    // Position in rendered texels, and the texel center at or before it
+    vec2 samplePos = TexCoords * renderSize;
+    vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+    vec2 f = samplePos - texPos1;
+
+    // Weights of the texels at texPos1 - 1 .. texPos1 + 2
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+    // The two middle texels are both positive, so one bilinear fetch between them covers both
+    vec2 w12 = w1 + w2;
+    vec2 offset12 = w2 / w12;
+
+    // Clamped to the rendered area: texels beyond it are stale
+    vec2 lo = vec2(0.5);
+    vec2 hi = renderSize - 0.5;
+    vec2 pos0 = clamp(texPos1 - 1.0, lo, hi) / sceneSize;
+    vec2 pos12 = clamp(texPos1 + offset12, lo, hi) / sceneSize;
+    vec2 pos3 = clamp(texPos1 + 2.0, lo, hi) / sceneSize;
+
+    vec3 result = vec3(0.0);
+    result += texture(sceneColor, vec2(pos0.x, pos0.y)).rgb * w0.x * w0.y;
+    result += texture(sceneColor, vec2(pos12.x, pos0.y)).rgb * w12.x * w0.y;
+    result += texture(sceneColor, vec2(pos3.x, pos0.y)).rgb * w3.x * w0.y;
+
+    result += texture(sceneColor, vec2(pos0.x, pos12.y)).rgb * w0.x * w12.y;
+    result += texture(sceneColor, vec2(pos12.x, pos12.y)).rgb * w12.x * w12.y;
+    result += texture(sceneColor, vec2(pos3.x, pos12.y)).rgb * w3.x * w12.y;
+
+    result += texture(sceneColor, vec2(pos0.x, pos3.y)).rgb * w0.x * w3.y;
+    result += texture(sceneColor, vec2(pos12.x, pos3.y)).rgb * w12.x * w3.y;
+    result += texture(sceneColor, vec2(pos3.x, pos3.y)).rgb * w3.x * w3.y;
+
+    // The negative lobes can overshoot around hard edges
+    FragColor = vec4(max(result, vec3(0.0)), 1.0);
+}